@@ -15,7 +15,8 @@
 
 /// --------------------------------   Definitions   ------------------------------------
 
-#include <ctime>
+#include <sys/time.h>
+#include <sys/stat.h>
 
 #include <iostream>
 #include <sstream>
@@ -27,16 +28,30 @@ using std::cerr;
 
 #include "errHandle.h"
 
+/// Wall-clock time (clock() adds up the time of all threads)
+/// @return current time in seconds
+static double wallTime(void) {
+
+	struct timeval t;
+	gettimeofday(&t, 0);
+	return t.tv_sec + t.tv_usec / 1000000.0;
+
+}
+
 /// ----------------------------------   appVol   ------------------------------------
 
 /// Volume Application
 
 /// Constructor
-appVol::appVol( bool _d ) : volume(), debug(_d) {
+appVol::appVol( bool _d ) : volume(), debug(_d), reorder(true), useViewOrders(false) {
 
 	offExt = string(".off");
+	bofExt = string(".bof");
 	tfExt = string(".tf");
 	lmtExt = string(".lmt");
+	cacheExt = string(".cache");
+	vocExt = string(".voc");
+	cacheOptions = CACHE_NORMALIZED;
 	searchDir = string("../tet_offs/");
 
 }
@@ -54,57 +69,139 @@ bool appVol::setup(int& argc, char** argv) {
 
 	try {
 
-		clock_t ctBegin = 0;
+		double ctBegin = 0.0;
 		double stepTime = 0.0, totalTime = 0.0;
 
 		stringstream ssUsage;
 
 		if ( !argv ) throw errHandle();
 
-		ssUsage << "Usage: " << argv[0] << " 'file'" << endl << endl
+		ssUsage << "Usage: " << argv[0] << " [-v] 'file'" << endl << endl
 			<< "  Where the following files will be readed: " << endl
 			<< "  |_ (x) 'file'" << offExt << " : vertex position and tetrahedra vertex ids" << endl
+			<< "  |_ (-) 'file'" << bofExt << " : binary (memory-mapped) volume converted from " << offExt << endl
 			<< "  |_ (-) 'file'" << tfExt << " : transfer function with 256 colors" << endl
 			<< "  |_ (-) 'file'" << lmtExt << " : volume limits with maxEdgeLength, maxZ and minZ " << endl
+			<< "  |_ (-) 'file'" << cacheExt << " : connectivity and external faces bundle" << endl
+			<< "  |_ (v) 'file'" << vocExt << " : view orders for the cached sort (only with -v)" << endl
 			<< "  Reading from the directory: " << searchDir << endl
 			<< "  Files marked by (x) need to exist." << endl
 			<< "  If the files marked by (-) does not exist, it will be computed and created." << endl << endl;
 
-		if ( argc != 2 ) throw errHandle(usageErr, ssUsage.str().c_str());
+		if ( argc == 3 && string(argv[1]) == "-v" ) useViewOrders = true;
+		else if ( argc != 2 ) throw errHandle(usageErr, ssUsage.str().c_str());
 
 		stringstream ioss;
-		string fnOff, fnTF, fnLmt;
+		string fnOff, fnBof, fnTF, fnLmt, fnCache, fnVoc;
 
-		ioss << searchDir << argv[1];
+		ioss << searchDir << argv[argc - 1];
 		ioss >> volName;
 
 		fnOff = volName + offExt;
+		fnBof = volName + bofExt;
 		fnTF = volName + tfExt;
 		fnLmt = volName + lmtExt;
+		fnCache = volName + cacheExt;
+		fnVoc = volName + vocExt;
 
 		if (debug) cout << endl << "::: Time :::" << endl << endl;
 
-		/// Reading Volume
-		if (debug) cout << "Reading volume : " << flush;
-		ctBegin = clock();
+		/// The binary volume is used only if it is newer than the OFF file
+		struct stat stOff, stBof;
+		bool offExists = ( stat(fnOff.c_str(), &stOff) == 0 );
+		bool bofExists = ( stat(fnBof.c_str(), &stBof) == 0 );
+		bool bofUpToDate = bofExists && ( !offExists || stBof.st_mtime >= stOff.st_mtime );
 
-		if ( !volume.readOff(fnOff.c_str()) ) throw errHandle(readErr, fnOff.c_str());
+		/// Mapping Binary Volume
+		bool bofMapped = false;
 
-		stepTime = ( clock() - ctBegin ) / (double)CLOCKS_PER_SEC;
-		totalTime += stepTime;
+		if (bofUpToDate) {
+
+			if (debug) cout << "Mapping binary volume : " << flush;
+			ctBegin = wallTime();
 
-		if (debug) cout << stepTime << " s" << endl;
+			bofMapped = volume.readBin(fnBof.c_str());
 
-		/// Normalizing Vertices
-		if (debug) cout << "Normalizing vertices : " << flush;
-		ctBegin = clock();
+			stepTime = wallTime() - ctBegin;
+			totalTime += stepTime;
 
-		volume.normalizeVertices();
+			if (debug) cout << stepTime << " s" << ( (bofMapped) ? "" : " (invalid)" ) << endl;
 
-		stepTime = ( clock() - ctBegin ) / (double)CLOCKS_PER_SEC;
-		totalTime += stepTime;
+		}
+
+		if (!bofMapped) {
+
+			/// Reading Volume
+			if (debug) cout << "Reading volume : " << flush;
+			ctBegin = wallTime();
+
+			if ( !volume.readOff(fnOff.c_str()) ) throw errHandle(readErr, fnOff.c_str());
+
+			stepTime = wallTime() - ctBegin;
+			totalTime += stepTime;
+
+			if (debug) cout << stepTime << " s ( "
+					<< (stOff.st_size / 1000000.0) / stepTime << " MB/s )" << endl;
+
+		}
+
+		/// Normalizing Vertices (and finding limits in the same pass
+		/// if the limits file is missing)
+		struct stat stLmt;
+		bool limitsFound = false, lmtExists = ( stat(fnLmt.c_str(), &stLmt) == 0 );
+
+		if (!volume.normalized) {
+
+			if (debug) cout << "Normalizing vertices" << ( (lmtExists) ? "" : " and finding limits" ) << " : " << flush;
+			ctBegin = wallTime();
+
+			volume.normalizeVertices( !lmtExists );
+
+			limitsFound = !lmtExists;
+
+			stepTime = wallTime() - ctBegin;
+			totalTime += stepTime;
+
+			if (debug) cout << stepTime << " s" << endl;
+
+		}
+
+		/// Reordering Vertices and Tetrahedra (Morton curve)
+		bool bofChanged = !bofMapped;
+
+		if (reorder && !volume.reordered) {
+
+			if (debug) cout << "Reordering volume : " << flush;
+			ctBegin = wallTime();
+
+			double strideBefore = volume.fetchStride();
+
+			if ( !volume.reorderMorton() ) throw errHandle(memoryErr);
+
+			stepTime = wallTime() - ctBegin;
+			totalTime += stepTime;
+
+			if (debug) cout << stepTime << " s ( mean vertex fetch stride "
+					<< strideBefore << " -> " << volume.fetchStride() << " )" << endl;
+
+			bofChanged = true;
+
+		}
+
+		/// Writing Binary Volume (conversion from OFF)
+		if (bofChanged) {
+
+			if (debug) cout << "Writing binary volume : " << flush;
+			ctBegin = wallTime();
+
+			if ( !volume.writeBin(fnBof.c_str()) ) throw errHandle(writeErr, fnBof.c_str());
+
+			stepTime = wallTime() - ctBegin;
+			totalTime += stepTime;
+
+			if (debug) cout << stepTime << " s" << endl;
 
-		if (debug) cout << stepTime << " s" << endl;
+		}
 
 		/// Reading Transfer Function
 		ifstream fileTF( fnTF.c_str() );
@@ -112,13 +209,13 @@ bool appVol::setup(int& argc, char** argv) {
 		if (fileTF.fail()) {
 
 			if (debug) cout << "Building and writing transfer function : " << flush;
-			ctBegin = clock();
+			ctBegin = wallTime();
 
 			if ( !volume.buildTF() ) throw errHandle(memoryErr);
 
 			if ( !volume.writeTF(fnTF.c_str()) ) throw errHandle(writeErr, fnTF.c_str());
 
-			stepTime = ( clock() - ctBegin ) / (double)CLOCKS_PER_SEC;
+			stepTime = wallTime() - ctBegin;
 			totalTime += stepTime;
 
 			if (debug) cout << stepTime << " s" << endl;
@@ -126,11 +223,11 @@ bool appVol::setup(int& argc, char** argv) {
 		} else {
 
 			if (debug) cout << "Reading transfer function : " << flush;
-			ctBegin = clock();
+			ctBegin = wallTime();
 
 			if ( !volume.readTF(fileTF) ) throw errHandle(readErr, fnTF.c_str());
 
-			stepTime = ( clock() - ctBegin ) / (double)CLOCKS_PER_SEC;
+			stepTime = wallTime() - ctBegin;
 			totalTime += stepTime;
 
 			if (debug) cout << stepTime << " s" << endl;
@@ -143,14 +240,13 @@ bool appVol::setup(int& argc, char** argv) {
 		if (fileLmt.fail()) {
 
 			if (debug) cout << "Building and writing volume limits : " << flush;
-			ctBegin = clock();
+			ctBegin = wallTime();
 
-			volume.findMaxEdgeLength();
-			volume.findMaxMinZ();
+			if (!limitsFound) volume.findLimits();
 
 			if ( !volume.writeLmt(fnLmt.c_str()) ) throw errHandle(writeErr, fnLmt.c_str());
 
-			stepTime = ( clock() - ctBegin ) / (double)CLOCKS_PER_SEC;
+			stepTime = wallTime() - ctBegin;
 			totalTime += stepTime;
 
 			if (debug) cout << stepTime << " s" << endl;
@@ -158,17 +254,102 @@ bool appVol::setup(int& argc, char** argv) {
 		} else {
 
 			if (debug) cout << "Reading volume limits : " << flush;
-			ctBegin = clock();
+			ctBegin = wallTime();
 
 			if ( !volume.readLmt(fileLmt) ) throw errHandle(readErr, fnLmt.c_str());
 
-			stepTime = ( clock() - ctBegin ) / (double)CLOCKS_PER_SEC;
+			stepTime = wallTime() - ctBegin;
 			totalTime += stepTime;
 
 			if (debug) cout << stepTime << " s" << endl;
 
 		}
 
+		/// Reading Cache Bundle (connectivity and external faces)
+		if (debug) cout << "Reading cache bundle : " << flush;
+		ctBegin = wallTime();
+
+		unsigned long long meshHash = volume.hashMesh();
+
+		cacheOptions = CACHE_NORMALIZED | ( (volume.reordered) ? CACHE_MORTON : 0 );
+
+		bool cacheRead = volume.readCache(fnCache.c_str(), meshHash, cacheOptions);
+
+		stepTime = wallTime() - ctBegin;
+		totalTime += stepTime;
+
+		if (debug) cout << stepTime << " s" << ( (cacheRead) ? "" : " (missing or stale)" ) << endl;
+
+		if (!cacheRead) {
+
+			if (debug) cout << "Building connectivity and external faces : " << flush;
+			ctBegin = wallTime();
+
+			if ( !volume.buildCon() ) throw errHandle(memoryErr);
+
+			stepTime = wallTime() - ctBegin;
+			totalTime += stepTime;
+
+			if (debug) cout << stepTime << " s" << endl;
+
+			if (debug) cout << "Writing cache bundle : " << flush;
+			ctBegin = wallTime();
+
+			if ( !volume.writeCache(fnCache.c_str(), meshHash, cacheOptions) ) throw errHandle(writeErr, fnCache.c_str());
+
+			stepTime = wallTime() - ctBegin;
+			totalTime += stepTime;
+
+			if (debug) cout << stepTime << " s" << endl;
+
+		}
+
+		/// View orders (view-direction permutations for the cached sort)
+		if (useViewOrders) {
+
+			if (debug) cout << "Reading view orders : " << flush;
+			ctBegin = wallTime();
+
+			bool vocRead = viewOrders.read(fnVoc.c_str(), meshHash, volume.numTets);
+
+			stepTime = wallTime() - ctBegin;
+			totalTime += stepTime;
+
+			if (debug) cout << stepTime << " s" << ( (vocRead) ? "" : " (missing or stale)" ) << endl;
+
+			if (!vocRead) {
+
+				if (debug) cout << "Building view orders : " << flush;
+				ctBegin = wallTime();
+
+				bool vocBuilt = viewOrders.build(volume);
+
+				stepTime = wallTime() - ctBegin;
+				totalTime += stepTime;
+
+				if (debug) cout << stepTime << " s" << ( (vocBuilt) ? "" : " (over the memory budget)" ) << endl;
+
+				if (vocBuilt) {
+
+					if (debug) cout << "Writing view orders : " << flush;
+					ctBegin = wallTime();
+
+					if ( !viewOrders.write(fnVoc.c_str(), meshHash) ) throw errHandle(writeErr, fnVoc.c_str());
+
+					stepTime = wallTime() - ctBegin;
+					totalTime += stepTime;
+
+					if (debug) cout << stepTime << " s" << endl;
+
+				}
+
+			}
+
+			if (debug) cout << "View orders : " << viewOrders.directions() << " directions ( "
+					<< viewOrders.sizeOf() / 1000000.0 << " MB )" << endl;
+
+		}
+
 		/// Concluding
 		if (debug) cout << endl
 				<< "Total pre-computation : " << totalTime << " s" << endl
@@ -28,6 +28,8 @@ using std::string;
 
 #include "offVol.h"
 
+#include "viewOrder.h"
+
 /// ----------------------------------   appVol   ------------------------------------
 
 /// Volume Application
@@ -48,7 +50,19 @@ public:
 	string volName;
 
 	/// File extensions
-	string offExt, tfExt, lmtExt;
+	string offExt, bofExt, tfExt, lmtExt, cacheExt, vocExt;
+
+	/// Reorder vertices and tetrahedra along the Morton curve
+	bool reorder;
+
+	/// Preprocessing options (key of the cache bundle)
+	unsigned int cacheOptions;
+
+	/// Precompute (or read) the view orders (option -v)
+	bool useViewOrders;
+
+	/// View orders for the cached sort
+	viewOrder< GLfloat, GLuint > viewOrders;
 
 	/// Searching directory for files
 	string searchDir;
@@ -0,0 +1,95 @@
+/**
+ *   Centroid Keys
+ *
+ */
+
+/**
+ *   centroidKeys : defines a class to compute the centroid eye Z of
+ *                  the tetrahedra in CPU from precomputed centroids
+ *
+ * C++ header (with implementation).
+ *
+ */
+
+/// --------------------------------   Definitions   ------------------------------------
+
+#ifndef _CENTROIDKEYS_H_
+#define _CENTROIDKEYS_H_
+
+#include <vector>
+
+#include "offVol.h"
+
+/// -------------------------------   centroidKeys   ----------------------------------
+
+/// Centroid Keys Class
+///   The centroids are stored as three separate arrays (x, y and z),
+///   so the eye Z of all tetrahedra is one unit-stride multiply-add
+///   loop, vectorized by the compiler and split among the threads.
+///   It gives the same keys as the first step shader (the eye Z mean
+///   of the four vertices) without waiting for the GPU readback
+class centroidKeys {
+
+public:
+
+	/// Constructor
+	centroidKeys() { }
+
+	/// Size of the centroid arrays
+	/// @return size in Bytes
+	size_t sizeOf(void) const { return ( cx.size() + cy.size() + cz.size() ) * sizeof(float); }
+
+	/// Number of tetrahedra (0 if not built)
+	unsigned size(void) const { return cx.size(); }
+
+	/// Build the centroids
+	/// @arg vol volume
+	template< class real, class natural >
+	void build(const offVol< real, natural >& vol) {
+
+		natural nT = vol.numTets;
+
+		cx.resize(nT); cy.resize(nT); cz.resize(nT);
+
+		long i;
+
+#pragma omp parallel for
+		for (i = 0; i < (long)nT; ++i) {
+
+			float c[3] = { 0.0, 0.0, 0.0 };
+
+			for (unsigned k = 0; k < 4; ++k)
+				for (unsigned j = 0; j < 3; ++j)
+					c[j] += vol.vertList[ vol.tetList[i][k] ][j];
+
+			cx[i] = 0.25 * c[0];
+			cy[i] = 0.25 * c[1];
+			cz[i] = 0.25 * c[2];
+
+		}
+
+	}
+
+	/// Compute the centroid eye Z of every tetrahedron
+	/// @arg mv modelview matrix (OpenGL column-major)
+	/// @arg keys returns the centroid eye Z (size() floats)
+	void compute(const float* mv, float* keys) const {
+
+		const float a = mv[2], b = mv[6], c = mv[10], d = mv[14];
+		const float *x = &cx[0], *y = &cy[0], *z = &cz[0];
+
+		long i, n = cx.size();
+
+#pragma omp parallel for
+		for (i = 0; i < n; ++i)
+			keys[i] = a * x[i] + b * y[i] + c * z[i] + d;
+
+	}
+
+private:
+
+	std::vector< float > cx, cy, cz; ///< Centroid coordinates
+
+};
+
+#endif
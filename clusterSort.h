@@ -0,0 +1,181 @@
+/**
+ *   Cluster Sort
+ *
+ */
+
+/**
+ *   clusterSort : defines a class to sort tetrahedra ids in two
+ *                 levels, clusters of consecutive tetrahedra by depth
+ *                 and the tetrahedra inside each cluster
+ *
+ * C++ header (with implementation).
+ *
+ */
+
+/// --------------------------------   Definitions   ------------------------------------
+
+#ifndef _CLUSTERSORT_H_
+#define _CLUSTERSORT_H_
+
+#include <algorithm>
+#include <vector>
+
+#include "depthSort.h"
+
+#define CLUSTER_SIZE 256 ///< Tetrahedra per cluster (local ids fit 8 bits)
+#define CLUSTER_MAX_SWAPS 4 ///< Cluster std::sort above 4 swaps per tetrahedron
+
+/// --------------------------------   clusterSort   -----------------------------------
+
+/// Cluster Sort Class
+///   A cluster is a range of CLUSTER_SIZE consecutive tetrahedra, which
+///   is spatially compact once the mesh is in Morton order (offVol::
+///   reorderMorton).  Each frame the clusters are radix sorted by their
+///   mean centroid depth and, in parallel, each cluster sorts its own
+///   tetrahedra starting from its order of the last frame (insertion
+///   sort, or std::sort when too disordered), writing them to its range
+///   of the output.  Overlapping clusters are not interleaved, so the
+///   result is approximate across cluster boundaries
+class clusterSort {
+
+public:
+
+	/// Constructor
+	clusterSort() : numClusters(0), numResorted(0) { }
+
+	/// Size of the sort buffers
+	/// @return size in Bytes
+	size_t sizeOf(void) const {
+		return local.size() + ( clusterKeys.size() + clusterIds.size() + clusterPos.size() ) * sizeof(unsigned) +
+			sorter.sizeOf();
+	}
+
+	/// Sort ids by cluster depth, then by depth inside the clusters
+	/// @arg keys depth keys (n floats)
+	/// @arg ids returns the ids ( 0 .. n-1 ) sorted by cluster and key
+	/// @arg n number of keys
+	/// @return true if it succeed
+	bool sort(const float* keys, unsigned* ids, unsigned n) {
+
+		if (n == 0) return true;
+
+		numClusters = (n + CLUSTER_SIZE - 1) / CLUSTER_SIZE;
+
+		/// Local orders start as identity (or again if n changed)
+		if (local.size() != n) {
+			local.resize(n);
+			for (unsigned i = 0; i < n; ++i)
+				local[i] = (unsigned char)(i % CLUSTER_SIZE);
+		}
+
+		clusterKeys.resize(numClusters);
+		clusterIds.resize(numClusters);
+		clusterPos.resize(numClusters);
+
+		long c;
+
+		/// Cluster depth: mean of the centroid depths
+#pragma omp parallel for
+		for (c = 0; c < (long)numClusters; ++c) {
+			unsigned begin = c * CLUSTER_SIZE, end = std::min(begin + CLUSTER_SIZE, n);
+			float z = 0.0;
+			for (unsigned i = begin; i < end; ++i)
+				z += keys[i];
+			clusterKeys[c] = z / (end - begin);
+		}
+
+		if ( !sorter.sort(&clusterKeys[0], &clusterIds[0], numClusters) ) return false;
+
+		/// Output range of each cluster (only the last one may be smaller)
+		unsigned pos = 0;
+
+		for (unsigned k = 0; k < numClusters; ++k) {
+			unsigned cl = clusterIds[k];
+			clusterPos[cl] = pos;
+			pos += std::min((unsigned)CLUSTER_SIZE, n - cl * CLUSTER_SIZE);
+		}
+
+		long resorted = 0;
+
+		/// Sort inside each cluster on (key, local id) pairs
+#pragma omp parallel for reduction(+:resorted)
+		for (c = 0; c < (long)numClusters; ++c) {
+
+			unsigned begin = c * CLUSTER_SIZE, size = std::min((unsigned)CLUSTER_SIZE, n - begin);
+			unsigned char *l = &local[begin];
+			unsigned long long e[CLUSTER_SIZE];
+
+			for (unsigned j = 0; j < size; ++j)
+				e[j] = ( (unsigned long long)depthSort::floatKey(keys[ begin + l[j] ]) << 8 ) | l[j];
+
+			if ( !insertionSort(e, size) ) {
+				std::sort(e, e + size);
+				++resorted;
+			}
+
+			unsigned *out = ids + clusterPos[c];
+
+			for (unsigned j = 0; j < size; ++j) {
+				l[j] = (unsigned char)(e[j] & 0xff);
+				out[j] = begin + l[j];
+			}
+
+		}
+
+		numResorted = resorted;
+
+		return true;
+
+	}
+
+	/// Clusters of the last sort
+	unsigned clusters(void) const { return numClusters; }
+
+	/// Clusters fully sorted (std::sort) in the last sort
+	unsigned resorted(void) const { return numResorted; }
+
+private:
+
+	/// Insertion sort bounded by CLUSTER_MAX_SWAPS swaps per element
+	/// @arg e elements
+	/// @arg size number of elements
+	/// @return false if the bound was reached (e is left a permutation)
+	static bool insertionSort(unsigned long long* e, unsigned size) {
+
+		unsigned maxSwaps = size * CLUSTER_MAX_SWAPS, swaps = 0;
+
+		for (unsigned j = 1; j < size; ++j) {
+
+			if (e[j-1] <= e[j]) continue;
+
+			unsigned long long x = e[j];
+			unsigned k = j;
+
+			while (k > 0 && e[k-1] > x) {
+				e[k] = e[k-1];
+				--k;
+			}
+
+			e[k] = x;
+
+			swaps += j - k;
+			if (swaps > maxSwaps) return false;
+
+		}
+
+		return true;
+
+	}
+
+	unsigned numClusters; ///< Number of clusters
+	unsigned numResorted; ///< Clusters fully sorted in the last sort
+
+	std::vector< unsigned char > local; ///< Last local order of each cluster
+	std::vector< float > clusterKeys; ///< Cluster depths
+	std::vector< unsigned > clusterIds, clusterPos; ///< Sorted clusters and their output ranges
+
+	depthSort sorter; ///< Cluster radix sorter
+
+};
+
+#endif
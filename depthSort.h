@@ -0,0 +1,589 @@
+/**
+ *   Depth Sort
+ *
+ */
+
+/**
+ *   depthSort : defines a class to sort tetrahedra ids by float
+ *               depth keys using a parallel LSD radix sort
+ *
+ * C++ header (with implementation).
+ *
+ */
+
+/// --------------------------------   Definitions   ------------------------------------
+
+#ifndef _DEPTHSORT_H_
+#define _DEPTHSORT_H_
+
+#include <cstring>
+
+#include <vector>
+#include <algorithm>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#define RADIX_BITS 8 ///< Bits per radix digit
+#define RADIX_SIZE (1 << RADIX_BITS) ///< Number of digit values
+#define RADIX_PASSES (32 / RADIX_BITS) ///< Passes for 32-bit keys
+
+#define BUCKET_LOAD 4 ///< Average keys per bucket of the bucket sort
+#define BUCKET_MAX (1 << 16) ///< Maximum number of buckets
+
+#define QUANT_BITS 16 ///< Bits of the quantized keys
+#define QUANT_SIZE (1 << QUANT_BITS) ///< Number of quantized key values
+#define QUANT_REFINE_RUN 32 ///< Refine runs of equal quantized keys above 32 ids
+#define QUANT_INSERTION_RUN 64 ///< Refine by insertion sort up to 64 ids
+
+#define RESORT_WINDOW 16 ///< Displacement probed by the disorder estimate
+#define RESORT_PROBE_STEP 8 ///< Probe one of every 8 positions
+#define RESORT_MAX_DISORDER 32 ///< Full sort above 1 / 32 of the probes displaced
+#define RESORT_MAX_SWAPS 8 ///< Full sort above 8 n swaps
+
+/// ---------------------------------   depthSort   ------------------------------------
+
+/// Depth Sort Class
+///   Keys and ids are kept in separate arrays (ping-pong buffers), each
+///   pass builds per-thread digit histograms over contiguous blocks and
+///   scatters in block order, so the sort is stable
+class depthSort {
+
+public:
+
+	/// Constructor
+	depthSort() : capacity(0), k0(NULL), k1(NULL), i0(NULL), i1(NULL),
+		numBuckets(0), lastRefined(0), lastSwaps(0), lastFull(true) { }
+
+	/// Destructor
+	~depthSort() { release(); }
+
+	/// Size of the sort buffers
+	/// @return size in Bytes
+	size_t sizeOf(void) const {
+		return capacity * 4 * sizeof(unsigned) + ( hist.size() + runs.size() ) * sizeof(unsigned) +
+			quant.size() * sizeof(unsigned short);
+	}
+
+	/// Sort ids by increasing depth
+	/// @arg keys depth keys (n floats)
+	/// @arg ids returns the ids ( 0 .. n-1 ) sorted by key
+	/// @arg n number of keys
+	/// @return true if it succeed
+	bool sort(const float* keys, unsigned* ids, unsigned n) {
+
+		if (!reserve(n)) return false;
+
+		long i;
+
+		/// Float keys to order-preserving unsigned keys
+#pragma omp parallel for
+		for (i = 0; i < (long)n; ++i) {
+			k0[i] = floatKey(keys[i]);
+			i0[i] = i;
+		}
+
+		hist.resize( maxThreads() * RADIX_SIZE );
+
+		for (unsigned pass = 0; pass < RADIX_PASSES; ++pass)
+			if (radixPass(n, pass * RADIX_BITS)) {
+				std::swap(k0, k1);
+				std::swap(i0, i1);
+			}
+
+		memcpy(ids, i0, n * sizeof(unsigned));
+
+		return true;
+
+	}
+
+	/// Sort ids by depth buckets (flat counting sort)
+	///   The depth range is divided in n / BUCKET_LOAD buckets (at most
+	///   BUCKET_MAX, one if the range is empty), then per-thread
+	///   histograms, prefix sum and scatter into ids.  Inside a bucket
+	///   the ids remain in increasing order (unsorted by depth)
+	/// @arg keys depth keys (n floats)
+	/// @arg ids returns the ids ( 0 .. n-1 ) sorted by bucket
+	/// @arg n number of keys
+	/// @return true if it succeed
+	bool bucketSort(const float* keys, unsigned* ids, unsigned n) {
+
+		if (!reserve(n)) return false;
+
+		if (n == 0) return true;
+
+		long i;
+
+		float zMin = keys[0], zMax = keys[0];
+
+#pragma omp parallel for reduction(min:zMin) reduction(max:zMax)
+		for (i = 1; i < (long)n; ++i) {
+			if (keys[i] < zMin) zMin = keys[i];
+			if (keys[i] > zMax) zMax = keys[i];
+		}
+
+		numBuckets = n / BUCKET_LOAD;
+
+		if (numBuckets > BUCKET_MAX) numBuckets = BUCKET_MAX;
+		if (numBuckets < 1 || !(zMax > zMin)) numBuckets = 1;
+
+		const float scale = numBuckets / (zMax - zMin);
+		const unsigned nb = numBuckets;
+
+		hist.resize( maxThreads() * nb );
+
+#pragma omp parallel
+		{
+
+			unsigned t = threadId(), nt = numThreads();
+			unsigned begin = (unsigned)( ( (unsigned long long)n * t ) / nt );
+			unsigned end = (unsigned)( ( (unsigned long long)n * (t + 1) ) / nt );
+
+			unsigned *h = &hist[t * nb];
+
+			/// Per-thread histogram of its block (bucket of each key in k0)
+			memset(h, 0, nb * sizeof(unsigned));
+
+			for (unsigned j = begin; j < end; ++j) {
+				unsigned b = (nb > 1) ? (unsigned)( (keys[j] - zMin) * scale ) : 0;
+				if (b >= nb) b = nb - 1;
+				k0[j] = b;
+				++h[b];
+			}
+
+#pragma omp barrier
+
+#pragma omp single
+			{
+
+				/// Exclusive prefix sum by bucket, then by thread
+				unsigned sum = 0;
+
+				for (unsigned b = 0; b < nb; ++b)
+					for (unsigned p = 0; p < nt; ++p) {
+						unsigned c = hist[p * nb + b];
+						hist[p * nb + b] = sum;
+						sum += c;
+					}
+
+			}
+
+			/// Scatter of the block
+			for (unsigned j = begin; j < end; ++j)
+				ids[ h[ k0[j] ]++ ] = j;
+
+		}
+
+		return true;
+
+	}
+
+	/// Buckets of the last bucket sort
+	unsigned buckets(void) const { return numBuckets; }
+
+	/// Sort ids by quantized depth (one 16-bit counting pass)
+	///   The keys are quantized to QUANT_BITS relative to the depth
+	///   range of the frame and scattered in one pass (per-thread
+	///   histograms of 2-byte keys, as in bucketSort).  Only runs of
+	///   equal quantized keys longer than refineRun are sorted again
+	///   by the full precision keys, shorter runs keep increasing ids
+	/// @arg keys depth keys (n floats)
+	/// @arg ids returns the ids ( 0 .. n-1 ) sorted by quantized key
+	/// @arg n number of keys
+	/// @arg refineRun longest run left unrefined
+	/// @return true if it succeed
+	bool quantSort(const float* keys, unsigned* ids, unsigned n, unsigned refineRun = QUANT_REFINE_RUN) {
+
+		lastRefined = 0;
+
+		if (n == 0) return true;
+
+		long i;
+
+		float zMin = keys[0], zMax = keys[0];
+
+#pragma omp parallel for reduction(min:zMin) reduction(max:zMax)
+		for (i = 1; i < (long)n; ++i) {
+			if (keys[i] < zMin) zMin = keys[i];
+			if (keys[i] > zMax) zMax = keys[i];
+		}
+
+		const float scale = (zMax > zMin) ? (QUANT_SIZE - 1) / (zMax - zMin) : 0.0f;
+
+		quant.resize(n);
+		runs.resize(QUANT_SIZE + 1);
+		hist.resize( maxThreads() * QUANT_SIZE );
+
+#pragma omp parallel
+		{
+
+			unsigned t = threadId(), nt = numThreads();
+			unsigned begin = (unsigned)( ( (unsigned long long)n * t ) / nt );
+			unsigned end = (unsigned)( ( (unsigned long long)n * (t + 1) ) / nt );
+
+			unsigned *h = &hist[t * QUANT_SIZE];
+
+			/// Per-thread histogram of its block (quantized keys)
+			memset(h, 0, QUANT_SIZE * sizeof(unsigned));
+
+			for (unsigned j = begin; j < end; ++j) {
+				unsigned q = (unsigned)( (keys[j] - zMin) * scale );
+				if (q >= QUANT_SIZE) q = QUANT_SIZE - 1;
+				quant[j] = (unsigned short)q;
+				++h[q];
+			}
+
+#pragma omp barrier
+
+#pragma omp single
+			{
+
+				/// Exclusive prefix sum by key, then by thread (runs
+				///   keeps the start of each key)
+				unsigned sum = 0;
+
+				for (unsigned q = 0; q < QUANT_SIZE; ++q) {
+					runs[q] = sum;
+					for (unsigned p = 0; p < nt; ++p) {
+						unsigned c = hist[p * QUANT_SIZE + q];
+						hist[p * QUANT_SIZE + q] = sum;
+						sum += c;
+					}
+				}
+
+				runs[QUANT_SIZE] = sum;
+
+			}
+
+			/// Scatter of the block
+			for (unsigned j = begin; j < end; ++j)
+				ids[ h[ quant[j] ]++ ] = j;
+
+		}
+
+		/// Full precision refinement of the long runs
+		long q, refined = 0;
+
+#pragma omp parallel for schedule(dynamic, 256) reduction(+:refined)
+		for (q = 0; q < QUANT_SIZE; ++q)
+			if (runs[q+1] - runs[q] > refineRun) {
+				refine(keys, ids + runs[q], runs[q+1] - runs[q]);
+				++refined;
+			}
+
+		lastRefined = refined;
+
+		return true;
+
+	}
+
+	/// Runs refined in the last quantized sort
+	unsigned refined(void) const { return lastRefined; }
+
+	/// Re-sort ids by increasing depth from a previous order
+	///   The disorder is estimated by probing key pairs RESORT_WINDOW
+	///   positions apart in the previous order (neighbor swaps, as ties
+	///   flipping, are cheap to repair and not counted).  If few pairs
+	///   are inverted, the order is repaired by insertion sort, else (or
+	///   above RESORT_MAX_SWAPS swaps per key) a full radix sort is done
+	/// @arg keys depth keys (n floats)
+	/// @arg ids previous order (a permutation of 0 .. n-1), returns
+	///          the ids sorted by key
+	/// @arg n number of keys
+	/// @return true if it succeed
+	bool resort(const float* keys, unsigned* ids, unsigned n) {
+
+		if (!reserve(n)) return false;
+
+		long i, displaced = 0, probes = 0;
+
+		lastSwaps = 0;
+		lastFull = false;
+
+#pragma omp parallel for reduction(+:displaced,probes)
+		for (i = 0; i < (long)n - RESORT_WINDOW; i += RESORT_PROBE_STEP) {
+			if (keys[ ids[i] ] > keys[ ids[i + RESORT_WINDOW] ]) ++displaced;
+			++probes;
+		}
+
+		if (displaced * RESORT_MAX_DISORDER > probes) {
+			lastFull = true;
+			return sort(keys, ids, n);
+		}
+
+		/// Keys in the previous order
+#pragma omp parallel for
+		for (i = 0; i < (long)n; ++i)
+			k0[i] = floatKey(keys[ ids[i] ]);
+
+		/// Insertion sort of the out-of-order keys
+		unsigned long maxSwaps = (unsigned long)n * RESORT_MAX_SWAPS;
+
+		for (unsigned j = 1; j < n; ++j) {
+
+			if (k0[j-1] <= k0[j]) continue;
+
+			unsigned key = k0[j], id = ids[j], k = j;
+
+			while (k > 0 && k0[k-1] > key) {
+				k0[k] = k0[k-1];
+				ids[k] = ids[k-1];
+				--k;
+			}
+
+			k0[k] = key;
+			ids[k] = id;
+
+			lastSwaps += j - k;
+
+			if (lastSwaps > maxSwaps) {
+				lastFull = true;
+				return sort(keys, ids, n);
+			}
+
+		}
+
+		return true;
+
+	}
+
+	/// Repair ids by insertion sort with a bounded displacement
+	///   Each key moves at most window positions back, so the cost is
+	///   bounded by n * window moves and the result is only approximately
+	///   sorted if the order was farther from sorted than that
+	/// @arg keys depth keys (n floats)
+	/// @arg ids order to repair (a permutation of 0 .. n-1)
+	/// @arg n number of keys
+	/// @arg window maximum displacement of a key
+	/// @return true if it succeed
+	bool repair(const float* keys, unsigned* ids, unsigned n, unsigned window) {
+
+		if (!reserve(n)) return false;
+
+		long i;
+
+		lastSwaps = 0;
+		lastFull = false;
+
+#pragma omp parallel for
+		for (i = 0; i < (long)n; ++i)
+			k0[i] = floatKey(keys[ ids[i] ]);
+
+		for (unsigned j = 1; j < n; ++j) {
+
+			if (k0[j-1] <= k0[j]) continue;
+
+			unsigned key = k0[j], id = ids[j], k = j, stop = (j > window) ? j - window : 0;
+
+			while (k > stop && k0[k-1] > key) {
+				k0[k] = k0[k-1];
+				ids[k] = ids[k-1];
+				--k;
+			}
+
+			k0[k] = key;
+			ids[k] = id;
+
+			lastSwaps += j - k;
+
+		}
+
+		return true;
+
+	}
+
+	/// Swaps of the last resort (or repair)
+	unsigned long swaps(void) const { return lastSwaps; }
+
+	/// Last resort fell back to a full sort
+	bool fullSort(void) const { return lastFull; }
+
+	/// Order-preserving float to unsigned conversion
+	///   Negative floats have all bits flipped, positive floats only
+	///   the sign bit, so unsigned order matches float order
+	/// @arg f float key
+	/// @return unsigned key
+	static unsigned floatKey(float f) {
+		unsigned u;
+		memcpy(&u, &f, sizeof(unsigned));
+		return (u & 0x80000000u) ? ~u : (u | 0x80000000u);
+	}
+
+private:
+
+	/// Sort a run of ids by full precision key, on (key, id) pairs
+	///   (insertion sort up to QUANT_INSERTION_RUN ids, else std::sort)
+	/// @arg keys depth keys
+	/// @arg ids run of ids
+	/// @arg size run size
+	static void refine(const float* keys, unsigned* ids, unsigned size) {
+
+		unsigned long long small[QUANT_INSERTION_RUN];
+		std::vector< unsigned long long > large;
+
+		unsigned long long *e = small;
+
+		if (size > QUANT_INSERTION_RUN) {
+			large.resize(size);
+			e = &large[0];
+		}
+
+		for (unsigned j = 0; j < size; ++j)
+			e[j] = ( (unsigned long long)floatKey(keys[ ids[j] ]) << 32 ) | ids[j];
+
+		if (size > QUANT_INSERTION_RUN) std::sort(e, e + size);
+		else {
+			for (unsigned j = 1; j < size; ++j) {
+				unsigned long long x = e[j];
+				unsigned k = j;
+				while (k > 0 && e[k-1] > x) {
+					e[k] = e[k-1];
+					--k;
+				}
+				e[k] = x;
+			}
+		}
+
+		for (unsigned j = 0; j < size; ++j)
+			ids[j] = (unsigned)e[j];
+
+	}
+
+	/// One radix pass from (k0, i0) to (k1, i1)
+	/// @arg n number of keys
+	/// @arg shift digit shift
+	/// @return false if the pass was skipped (all keys share the digit)
+	bool radixPass(unsigned n, unsigned shift) {
+
+		bool skip = false;
+
+#pragma omp parallel
+		{
+
+			unsigned t = threadId(), nt = numThreads();
+			unsigned begin = (unsigned)( ( (unsigned long long)n * t ) / nt );
+			unsigned end = (unsigned)( ( (unsigned long long)n * (t + 1) ) / nt );
+
+			unsigned *h = &hist[t * RADIX_SIZE];
+
+			/// Per-thread histogram of its block
+			memset(h, 0, RADIX_SIZE * sizeof(unsigned));
+
+			for (unsigned j = begin; j < end; ++j)
+				++h[ ( k0[j] >> shift ) & (RADIX_SIZE - 1) ];
+
+#pragma omp barrier
+
+#pragma omp single
+			{
+
+				/// Exclusive prefix sum by digit, then by thread
+				unsigned sum = 0;
+
+				for (unsigned d = 0; d < RADIX_SIZE; ++d) {
+
+					unsigned digitCount = 0;
+
+					for (unsigned b = 0; b < nt; ++b) {
+						unsigned c = hist[b * RADIX_SIZE + d];
+						hist[b * RADIX_SIZE + d] = sum;
+						sum += c;
+						digitCount += c;
+					}
+
+					if (digitCount == n) skip = true;
+
+				}
+
+			}
+
+			/// Stable scatter of the block
+			if (!skip) {
+
+				for (unsigned j = begin; j < end; ++j) {
+
+					unsigned pos = h[ ( k0[j] >> shift ) & (RADIX_SIZE - 1) ]++;
+
+					k1[pos] = k0[j];
+					i1[pos] = i0[j];
+
+				}
+
+			}
+
+		}
+
+		return !skip;
+
+	}
+
+	/// Reserve sort buffers
+	/// @arg n number of keys
+	/// @return true if it succeed
+	bool reserve(unsigned n) {
+
+		if (n <= capacity) return true;
+
+		release();
+
+		k0 = new unsigned[n]; k1 = new unsigned[n];
+		i0 = new unsigned[n]; i1 = new unsigned[n];
+
+		if (!k0 || !k1 || !i0 || !i1) { release(); return false; }
+
+		capacity = n;
+
+		return true;
+
+	}
+
+	/// Release sort buffers
+	void release(void) {
+		if (k0) delete [] k0;
+		if (k1) delete [] k1;
+		if (i0) delete [] i0;
+		if (i1) delete [] i1;
+		k0 = k1 = i0 = i1 = NULL;
+		capacity = 0;
+	}
+
+	/// OpenMP helpers (one thread without OpenMP)
+	static unsigned maxThreads(void) {
+#ifdef _OPENMP
+		return omp_get_max_threads();
+#else
+		return 1;
+#endif
+	}
+	static unsigned numThreads(void) {
+#ifdef _OPENMP
+		return omp_get_num_threads();
+#else
+		return 1;
+#endif
+	}
+	static unsigned threadId(void) {
+#ifdef _OPENMP
+		return omp_get_thread_num();
+#else
+		return 0;
+#endif
+	}
+
+	unsigned capacity; ///< Allocated keys
+	unsigned *k0, *k1; ///< Keys (ping-pong)
+	unsigned *i0, *i1; ///< Ids (ping-pong)
+	std::vector< unsigned > hist; ///< Per-thread digit histograms
+	std::vector< unsigned > runs; ///< Start of each quantized key run
+	std::vector< unsigned short > quant; ///< Quantized keys
+
+	unsigned numBuckets; ///< Buckets of the last bucket sort
+	unsigned lastRefined; ///< Runs refined in the last quantized sort
+
+	unsigned long lastSwaps; ///< Swaps of the last resort (or repair)
+	bool lastFull; ///< Last resort was a full sort
+
+};
+
+#endif
@@ -17,7 +17,9 @@
  *     [4] Classify the projectino (1 access);
  *     [5] Compute thick vertex;
  *     [6] Compute cell thickness, scalar front and back;
- *     [7] Write back the results in 2 FBO.
+ *     [7] Write back the results in 2 FBO (read back as half floats:
+ *         TTT index and count packed in one channel, 7 halves per
+ *         tetrahedron).
  *
  * GLSL code.
  *
@@ -299,8 +301,9 @@ void main(void) {
 
 	computeScalars();
 
-	/// Output data in FBOs
-	gl_FragData[0] = vec4( intersectionPoint.xy, centroidZ, idTTT );
-	gl_FragData[1] = vec4( scalarFront, scalarBack, abs(thickness), countTFan );
+	/// Output data in FBOs: idTTT (7 bits) | countTFan << 7 (3 bits) is
+	///   an integer below 2048, exact in half float
+	gl_FragData[0] = vec4( intersectionPoint.xy, centroidZ, float(idTTT + countTFan * 128) );
+	gl_FragData[1] = vec4( scalarFront, scalarBack, abs(thickness), 0.0 );
 
 }
@@ -0,0 +1,200 @@
+/**
+ *   Frustum Cull
+ *
+ */
+
+/**
+ *   frustumCull : defines a class to cull clusters of tetrahedra
+ *                 outside the view volume by their bounding boxes
+ *
+ * C++ header (with implementation).
+ *
+ */
+
+/// --------------------------------   Definitions   ------------------------------------
+
+#ifndef _FRUSTUMCULL_H_
+#define _FRUSTUMCULL_H_
+
+#include <cmath>
+#include <cstddef>
+
+#include <algorithm>
+#include <vector>
+
+#include "offVol.h"
+
+#include "clusterSort.h"
+
+#include "glMatrix.h"
+
+/// --------------------------------   frustumCull   -----------------------------------
+
+/// Frustum Cull Class
+///   Culls the clusters of clusterSort (CLUSTER_SIZE consecutive
+///   tetrahedra), each bounded by a box stored as center and half
+///   extent in separate arrays.  Each view tests the boxes against the
+///   six clip planes of the modelview projection (w +- x, w +- y and
+///   w +- z) in one vectorized loop.  The result is conservative: a
+///   cluster is kept if its box touches the view volume, so every
+///   visible tetrahedron is active, but not every active one visible
+class frustumCull {
+
+public:
+
+	/// Constructor
+	frustumCull() : numTets(0), numActive(0) { }
+
+	/// Size of the culling arrays
+	/// @return size in Bytes
+	size_t sizeOf(void) const {
+		return ( cx.size() + cy.size() + cz.size() + ex.size() + ey.size() + ez.size() ) * sizeof(float) +
+			inside.size() + ( ranges.size() + active.size() ) * sizeof(unsigned);
+	}
+
+	/// Number of clusters (0 if not built)
+	unsigned clusters(void) const { return cx.size(); }
+
+	/// Build the cluster bounding boxes
+	/// @arg vol volume
+	template< class real, class natural >
+	void build(const offVol< real, natural >& vol) {
+
+		natural nT = vol.numTets;
+		unsigned nC = (nT + CLUSTER_SIZE - 1) / CLUSTER_SIZE;
+
+		numTets = nT;
+
+		cx.resize(nC); cy.resize(nC); cz.resize(nC);
+		ex.resize(nC); ey.resize(nC); ez.resize(nC);
+		inside.resize(nC);
+
+		long c;
+
+#pragma omp parallel for
+		for (c = 0; c < (long)nC; ++c) {
+
+			unsigned begin = c * CLUSTER_SIZE, end = std::min(begin + CLUSTER_SIZE, (unsigned)nT);
+			float bmin[3], bmax[3];
+
+			for (unsigned j = 0; j < 3; ++j)
+				bmin[j] = bmax[j] = vol.vertList[ vol.tetList[begin][0] ][j];
+
+			for (unsigned i = begin; i < end; ++i)
+				for (unsigned k = 0; k < 4; ++k)
+					for (unsigned j = 0; j < 3; ++j) {
+						float v = vol.vertList[ vol.tetList[i][k] ][j];
+						bmin[j] = std::min(bmin[j], v);
+						bmax[j] = std::max(bmax[j], v);
+					}
+
+			cx[c] = 0.5f * (bmin[0] + bmax[0]); ex[c] = 0.5f * (bmax[0] - bmin[0]);
+			cy[c] = 0.5f * (bmin[1] + bmax[1]); ey[c] = 0.5f * (bmax[1] - bmin[1]);
+			cz[c] = 0.5f * (bmin[2] + bmax[2]); ez[c] = 0.5f * (bmax[2] - bmin[2]);
+
+		}
+
+	}
+
+	/// Cull the clusters outside the view volume
+	/// @arg mv modelview matrix (OpenGL column-major)
+	/// @arg pj projection matrix (OpenGL column-major)
+	/// @return number of active tetrahedra
+	unsigned cull(const float* mv, const float* pj) {
+
+		float mvp[16];
+
+		glMatrix::modelviewProjection(mv, pj, mvp);
+
+		unsigned nC = cx.size();
+
+		/// Clip planes (a, b, c, d) from the matrix rows: w + x, w - x,
+		///   w + y, w - y, w + z and w - z (inside when a x + b y + c z + d >= 0)
+		float pl[6][4];
+
+		for (unsigned p = 0; p < 6; ++p) {
+			float s = (p & 1) ? -1.0f : 1.0f;
+			for (unsigned j = 0; j < 4; ++j)
+				pl[p][j] = mvp[j*4 + 3] + s * mvp[j*4 + p/2];
+		}
+
+		const float *x = &cx[0], *y = &cy[0], *z = &cz[0], *hx = &ex[0], *hy = &ey[0], *hz = &ez[0];
+		unsigned char *in = &inside[0];
+
+		long c;
+
+		/// Box outside a plane: its center is farther than the box
+		///   projected radius on the plane normal
+#pragma omp parallel for
+		for (c = 0; c < (long)nC; ++c) {
+
+			float out = 0.0f;
+
+			for (unsigned p = 0; p < 6; ++p) {
+				float d = pl[p][0] * x[c] + pl[p][1] * y[c] + pl[p][2] * z[c] + pl[p][3];
+				float r = fabsf(pl[p][0]) * hx[c] + fabsf(pl[p][1]) * hy[c] + fabsf(pl[p][2]) * hz[c];
+				out = (d + r < 0.0f) ? 1.0f : out;
+			}
+
+			in[c] = (out == 0.0f) ? 1 : 0;
+
+		}
+
+		/// Active ranges (runs of inside clusters) and tetrahedra
+		ranges.clear();
+		active.clear();
+
+		for (unsigned k = 0; k < nC; ++k) {
+
+			if (!in[k]) continue;
+
+			unsigned begin = k * CLUSTER_SIZE, end = std::min(begin + CLUSTER_SIZE, numTets);
+
+			if (!ranges.empty() && ranges.back() == begin) ranges.back() = end;
+			else { ranges.push_back(begin); ranges.push_back(end); }
+
+			for (unsigned i = begin; i < end; ++i)
+				active.push_back(i);
+
+		}
+
+		numActive = active.size();
+
+		return numActive;
+
+	}
+
+	/// Active tetrahedron (its cluster inside the view volume in the last cull)
+	/// @arg t tetrahedron id
+	bool isActive(unsigned t) const { return inside[ t / CLUSTER_SIZE ] != 0; }
+
+	/// Cluster inside the view volume in the last cull
+	/// @arg c cluster id
+	bool isInside(unsigned c) const { return inside[c] != 0; }
+
+	/// Active tetrahedra ids (ascending) of the last cull
+	const unsigned* activeTets(void) const { return (active.empty()) ? NULL : &active[0]; }
+
+	/// Number of active tetrahedra of the last cull
+	unsigned activeCount(void) const { return numActive; }
+
+	/// Active ranges of the last cull: [ begin, end ) pairs of tetrahedra ids
+	const unsigned* activeRanges(void) const { return (ranges.empty()) ? NULL : &ranges[0]; }
+
+	/// Number of active ranges of the last cull
+	unsigned rangeCount(void) const { return ranges.size() / 2; }
+
+private:
+
+	unsigned numTets; ///< Number of tetrahedra
+	unsigned numActive; ///< Active tetrahedra of the last cull
+
+	std::vector< float > cx, cy, cz; ///< Cluster box centers
+	std::vector< float > ex, ey, ez; ///< Cluster box half extents
+	std::vector< unsigned char > inside; ///< Cluster inside flags of the last cull
+	std::vector< unsigned > ranges; ///< Active ranges of the last cull
+	std::vector< unsigned > active; ///< Active tetrahedra of the last cull
+
+};
+
+#endif
@@ -0,0 +1,49 @@
+/**
+ *   GL Matrix
+ *
+ */
+
+/**
+ *   glMatrix : defines a class with the 4x4 matrix operations of the
+ *              CPU stages on OpenGL (column-major) matrices
+ *
+ * C++ header (with implementation).
+ *
+ */
+
+/// --------------------------------   Definitions   ------------------------------------
+
+#ifndef _GLMATRIX_H_
+#define _GLMATRIX_H_
+
+/// --------------------------------   glMatrix   -----------------------------------
+
+/// GL Matrix Class
+///   Matrices are 16 floats in OpenGL order: element ( row r, column c )
+///   is m[c*4 + r]
+class glMatrix {
+
+public:
+
+	/// Matrix product
+	/// @arg a left matrix
+	/// @arg b right matrix
+	/// @arg ab returns a * b (not a or b)
+	static void product(const float* a, const float* b, float* ab) {
+		for (unsigned c = 0; c < 4; ++c)
+			for (unsigned r = 0; r < 4; ++r)
+				ab[c*4 + r] = a[0*4 + r] * b[c*4 + 0] + a[1*4 + r] * b[c*4 + 1] +
+					a[2*4 + r] * b[c*4 + 2] + a[3*4 + r] * b[c*4 + 3];
+	}
+
+	/// Modelview projection, as gl_ModelViewProjectionMatrix
+	/// @arg mv modelview matrix
+	/// @arg pj projection matrix
+	/// @arg mvp returns pj * mv
+	static void modelviewProjection(const float* mv, const float* pj, float* mvp) {
+		product(pj, mv, mvp);
+	}
+
+};
+
+#endif
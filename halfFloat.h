@@ -0,0 +1,105 @@
+/**
+ *   Half Float
+ *
+ */
+
+/**
+ *   halfFloat : defines a class to convert between 32-bit floats and
+ *               16-bit half floats (as OpenGL GL_HALF_FLOAT_ARB)
+ *
+ * C++ header (with implementation).
+ *
+ */
+
+/// --------------------------------   Definitions   ------------------------------------
+
+#ifndef _HALFFLOAT_H_
+#define _HALFFLOAT_H_
+
+#include <cstring>
+
+/// --------------------------------   halfFloat   -----------------------------------
+
+/// Half Float Class
+///   IEEE 754 binary16: 1 sign, 5 exponent and 10 mantissa bits.
+///   Floats are rounded to the nearest half (ties to even), with
+///   denormals and infinities kept (NaNs become one quiet NaN).
+///   Every half is exactly a float, so unpack(pack(f)) is f rounded,
+///   and a half read back from a GL_RGBA16F_ARB texture unpacks to
+///   the same float that GL_FLOAT would give
+class halfFloat {
+
+public:
+
+	/// Pack a float into a half
+	///   Branch-free (selects), so loops of packs are vectorized
+	/// @arg f float
+	/// @return nearest half
+	static unsigned short pack(float f) {
+
+		unsigned x;
+		memcpy(&x, &f, sizeof(unsigned));
+
+		unsigned sign = x & 0x80000000u;
+
+		x ^= sign;
+
+		/// Denormal half: adding 0.5 leaves the half mantissa (rounded
+		///   by the float adder) in the lowest bits
+		float a;
+		memcpy(&a, &x, sizeof(float));
+		a += 0.5f;
+
+		unsigned d;
+		memcpy(&d, &a, sizeof(unsigned));
+		d -= 126u << 23;
+
+		/// Normal half: rebias the exponent and round to nearest even
+		///   (a carry may go to the exponent)
+		unsigned n = ( x + ( (unsigned)(15 - 127) << 23 ) + 0xfff + ( (x >> 13) & 1 ) ) >> 13;
+
+		unsigned h = ( x >= (143u << 23) ) ? ( ( x > 0x7f800000u ) ? 0x7e00u : 0x7c00u ) : ///< Infinity or NaN
+			( x < (113u << 23) ) ? d : n;
+
+		return (unsigned short)( h | (sign >> 16) );
+
+	}
+
+	/// Pack an array of floats into halves
+	/// @arg f floats
+	/// @arg h returns the nearest halves
+	/// @arg n number of floats
+	static void pack(const float* f, unsigned short* h, unsigned n) {
+		for (unsigned i = 0; i < n; ++i)
+			h[i] = pack(f[i]);
+	}
+
+	/// Unpack a half into a float
+	/// @arg h half
+	/// @return float (exact)
+	static float unpack(unsigned short h) {
+
+		unsigned sign = (h & 0x8000u) << 16, e = (h >> 10) & 0x1f, m = h & 0x3ff, x;
+
+		if (e == 0x1f) x = sign | 0x7f800000 | (m << 13); ///< Infinity or NaN
+		else if (e) x = sign | ( (e + 127 - 15) << 23 ) | (m << 13);
+		else if (m) { ///< Denormal half: normalize
+
+			e = 127 - 14;
+
+			while ( !(m & 0x400) ) { m <<= 1; --e; }
+
+			x = sign | (e << 23) | ( (m & 0x3ff) << 13 );
+
+		} else x = sign;
+
+		float f;
+		memcpy(&f, &x, sizeof(float));
+
+		return f;
+
+	}
+
+};
+
+#endif
@@ -74,7 +74,7 @@ void volume::compute_1st_shader_on_cpu(void)
 
 	vec4 v;
 
-	GLuint vertId = (GLuint)tetrahedralBuffer[idTet*4 + i];
+	GLuint vertId = tetVertex(idTet, i);
 
 	for (uint j = 0; j < 4; ++j) {
 
@@ -304,10 +304,27 @@ void volume::compute_2nd_shader_on_cpu(void)
   glPushMatrix();
   glLoadIdentity();
 
-  //--- For each tetrahedron do (glMultiDrawElements) ---
-  for (uint i = 0; i < numTets; ++i) {
+  //--- K-buffer: composite the fans in CPU (see kBuffer.h) ---
+  bool kbuffer = (kBufferSize > 0);
 
-    glBegin(GL_TRIANGLE_FAN);
+  if (kbuffer) {
+    if (kbuf.k() != (uint)kBufferSize || kbufWidth != modelWinWidth || kbufHeight != modelWinHeight) {
+      kbufWidth = modelWinWidth;
+      kbufHeight = modelWinHeight;
+      kbuf.resize(kbufWidth, kbufHeight, kBufferSize);
+    }
+    else
+      kbuf.clear();
+  }
+
+  GLfloat fanPos[6][3], fanColor[6][4];
+
+  //--- For each tetrahedron do (glMultiDrawElements: the fans
+  //--- of the curTets not discarded) ---
+  for (uint i = 0; i < curTets; ++i) {
+
+    if (!kbuffer)
+      glBegin(GL_TRIANGLE_FAN);
 
     //--- For each triangle fan do (glMultiDrawElements) ---
     for (GLint j = 0; j < count[i]; ++j) {
@@ -375,6 +392,18 @@ void volume::compute_2nd_shader_on_cpu(void)
       }
       */
 
+      if (kbuffer) {
+	//--- Fan vertex in pixels and eye Z (the thick vertex is
+	//--- inside the tetrahedron, its centroid Z approximates it) ---
+	fanPos[j][0] = (vertexArray[indices[i][j] * 4 + 0] + 1.0) * 0.5 * kbufWidth;
+	fanPos[j][1] = (vertexArray[indices[i][j] * 4 + 1] + 1.0) * 0.5 * kbufHeight;
+	fanPos[j][2] = (j == 0) ? outputBuffer0[(indices[i][0] / 5) * 4 + 2]
+	  : vertexArray[indices[i][j] * 4 + 2];
+	for (uint k = 0; k < 4; ++k)
+	  fanColor[j][k] = color[k];
+	continue;
+      }
+
       glColor4f(color[0], color[1], color[2], color[3]);
       //glVertex4f(v[0], v[1], v[2], 1.0);
 
@@ -387,10 +416,25 @@ void volume::compute_2nd_shader_on_cpu(void)
 
     } // j
 
+    if (kbuffer) {
+      for (GLint j = 1; j < count[i] - 1; ++j)
+	kbuf.triangle(fanPos[0], fanPos[j], fanPos[j+1],
+		      fanColor[0], fanColor[j], fanColor[j+1]);
+      continue;
+    }
+
     glEnd();
 
   } // i
 
+  if (kbuffer) {
+    //--- Composite the kept fragments and draw the image over the
+    //--- background (identity matrices, blending as the fans) ---
+    kbuf.resolve();
+    glRasterPos2f(-1.0, -1.0);
+    glDrawPixels(kbufWidth, kbufHeight, GL_RGBA, GL_FLOAT, kbuf.image());
+  }
+
   glPopMatrix();
   glMatrixMode(GL_MODELVIEW);
   glPopMatrix();
@@ -22,6 +22,11 @@ uniform sampler1D orderTableTex;
 
 uniform float vertTexSize;
 
+uniform bool implicitTets; // structured grid: no tetrahedralTex
+uniform float tetTexSize;
+uniform float cellRows; // rows of cells in each texel row (implicitTets)
+uniform vec3 gridDim;
+
 vec3 vert_proj[4]; // vertex position in homogenous clip-space (screen space)
 vec3 vert_order[4]; //vertices in right order (basis graph)
 float scalar_order[4]; // color in right order (basis graph)
@@ -31,16 +36,66 @@ float paramU1, paramU2; // line intersection parameters
 vec3 grad_orig[4]; //vertices gradients
 vec3 grad_order[4];
 
+/// Quotient and remainder of integers a and d (a below 2^24)
+/// The division is not exactly rounded, so the quotient is fixed
+/// from the (exact) remainder
+vec2 div_mod(float a, float d)
+{
+  float q = floor((a + 0.5) / d);
+  float r = a - q * d;
+
+  if (r < 0.0) { q -= 1.0; r += d; }
+  else if (r >= d) { q += 1.0; r -= d; }
+
+  return vec2(q, r);
+}
+
+/// Implicit tetrahedra: the fragment position is the tetrahedron id,
+/// 5 tetrahedra by grid cell (same split as volume::generateTets)
+/// Each texel row holds cellRows whole rows of cells, so the cell is
+/// found from the texel row and column without the (inexact above
+/// 2^24) flat tetrahedron id
+vec4 implicit_tet_ids()
+{
+  vec2 pix = floor(gl_TexCoord[0].st * tetTexSize);
+  vec3 cdim = gridDim - vec3(1.0);
+
+  vec2 xl = div_mod(pix.x, 5.0); // cell in the texel row, tetrahedron in the cell
+  vec2 rx = div_mod(xl.x, cdim.x); // row of cells in the texel row, cell x
+  vec2 zy = div_mod(pix.y * cellRows + rx.x, cdim.y); // cell z, cell y
+
+  float l = xl.y;
+  vec3 c = vec3(rx.y, zy.y, zy.x);
+
+  float base = c.x + c.y * gridDim.x + c.z * gridDim.x * gridDim.y;
+  float dy = gridDim.x, dz = gridDim.x * gridDim.y;
+
+  // hexahedron corners: corner k = (k&1) + (k>>1&1)*dy + (k>>2&1)*dz
+  vec4 corners;
+  if (l < 0.5) corners = vec4(0.0, dy, 1.0 + dy, dy + dz);
+  else if (l < 1.5) corners = vec4(1.0 + dy, 1.0 + dz, dy + dz, 1.0 + dy + dz);
+  else if (l < 2.5) corners = vec4(0.0, dz, 1.0 + dz, dy + dz);
+  else if (l < 3.5) corners = vec4(0.0, 1.0, 1.0 + dy, 1.0 + dz);
+  else corners = vec4(0.0, 1.0 + dy, 1.0 + dz, dy + dz);
+
+  return vec4(base) + corners;
+}
+
 void vertex_data_retrieval(out float cZ)
 {
   cZ = 0.0;
-  vec4 ids = texture2D(tetrahedralTex, gl_TexCoord[0].st).xyzw;
+  vec4 ids;
+  if (implicitTets)
+    ids = implicit_tet_ids();
+  else
+    ids = texture2D(tetrahedralTex, gl_TexCoord[0].st).xyzw;
 
   for (int i = 0; i < 4; i++)
     {
       //      vec2 texParam = vec2(mod(ids[i],vertTexSize), floor(ids[i]/vertTexSize));
 
-      vec2 texParam = vec2((mod(ids[i],vertTexSize)+0.5)/vertTexSize, (floor(ids[i]/vertTexSize)+0.5)/vertTexSize);
+      vec2 rc = div_mod(ids[i], vertTexSize);
+      vec2 texParam = (rc.yx + vec2(0.5)) / vertTexSize;
       vec4 texInfo = texture2D(vertexPosTex, texParam).xyzw;
       grad_orig[i] = texture2D(gradientTex, texParam).xyz;
 
@@ -321,7 +321,9 @@ fileType read_args(int& argc, char**& argv, uint* dim)
 	   << "  PNM  images : heart1  heart2  heart3" << endl
 	   << "  GEO datsets : salt    skull" << endl << endl
 	   << "And in [extended option] you can enter: " << endl
-	   << "  -t : to generate a text file in a 2 min execution" << endl << endl;
+	   << "  -t : to generate a text file in a 2 min execution" << endl
+	   << "  -s xy z : subsample RAW/BIN volumes by xy and z steps" << endl
+	   << "  -g : compute RAW/BIN grid tetrahedra on the fly (no tetrahedra buffer)" << endl << endl;
       exit(0);
     }
   return OFF;
@@ -86,6 +86,9 @@ bool integrating = true,
   debug_shaders = true,
   sorting = true;
 
+// CPU k-buffer depth (0 disables it)
+GLint kBufferSize = 0;
+
 static bool rotate_always = false,
   show_debug = true,
   show_help = false,
@@ -300,6 +303,13 @@ bool displayDebugModel(void)
     glWrite(0.8, -1.0, "* integrating *");
   if (shading)
     glWrite(0.8, -1.1, "* shading *");
+#ifdef NO_NVIDIA
+  if (kBufferSize > 0) {
+    ostringstream oss_kbuffer;
+    oss_kbuffer << "* k-buffer " << kBufferSize << " *";
+    glWrite(0.8, -1.2, (char*) oss_kbuffer.str().c_str());
+  }
+#endif
 
   if (write_in_file)
     {
@@ -420,7 +430,7 @@ void displayModelWin(void)
       if (show_debug)
 	sta_sh = glutGet(GLUT_ELAPSED_TIME);
 	
-      vol->SetupArrays(true);
+      vol->SetupArrays();
 	
       if (show_debug) {
 	end_sh = glutGet(GLUT_ELAPSED_TIME);
@@ -459,7 +469,7 @@ void displayModelWin(void)
       if (show_debug)
 	sta_sh = glutGet(GLUT_ELAPSED_TIME);
 	
-      vol->SetupArrays(false);
+      vol->SetupArrays();
 	
       if (show_debug) {
 	end_sh = glutGet(GLUT_ELAPSED_TIME);
@@ -488,7 +498,7 @@ void displayModelWin(void)
       if (show_debug)
 	sta_sh = glutGet(GLUT_ELAPSED_TIME);
 	
-      vol->SetupArrays(true);
+      vol->SetupArrays();
 	
       if (show_debug) {
 	end_sh = glutGet(GLUT_ELAPSED_TIME);
@@ -820,6 +830,15 @@ void keyboardModelWin(unsigned char key, int x, int y)
     integrating = !integrating;
     glutPostRedisplay();
     break;
+#ifdef NO_NVIDIA
+  case 'k': case 'K': // k-buffer depth (0, 1, 2, 4, 8)
+    kBufferSize = (kBufferSize == 0) ? 1 : 2*kBufferSize;
+    if (kBufferSize > KBUFFER_MAX)
+      kBufferSize = 0;
+    rotated = true;
+    glutPostRedisplay();
+    break;
+#endif
   case 'l': case 'L': // integrating
     shading = !shading;
     glutPostRedisplay();
@@ -945,6 +964,28 @@ int main(int argc, char** argv)
   if (show_debug)
     sta_in = glutGet(GLUT_ELAPSED_TIME);
 
+  // Subsampling option: -s xy_step z_step
+  uint xy_step = 1, z_step = 1;
+  for (int a = 1; a < argc - 2; ++a)
+    if (strcmp(argv[a], "-s") == 0) {
+      xy_step = (uint)atoi(argv[a+1]);
+      z_step = (uint)atoi(argv[a+2]);
+      for (int b = a; b + 3 < argc; ++b)
+	argv[b] = argv[b+3];
+      argc -= 3;
+      break;
+    }
+
+  // Implicit tetrahedra option: -g (structured grids only)
+  for (int a = 1; a < argc; ++a)
+    if (strcmp(argv[a], "-g") == 0) {
+      vol->setImplicitTets(true);
+      for (int b = a; b + 1 < argc; ++b)
+	argv[b] = argv[b+1];
+      argc -= 1;
+      break;
+    }
+
   // Extended options
   if ( ((argc == 4) && (strcmp(argv[3], "-t") == 0)) ||
        ((argc == 3) && (strcmp(argv[2], "-t") == 0)) ) {
@@ -967,7 +1008,7 @@ int main(int argc, char** argv)
   dimensionY = dim[1];
   dimensionZ = dim[2];
 
-  vol->readFile(volume_name, fType, dim[0], dim[1], dim[2]);
+  vol->readFile(volume_name, fType, dim[0], dim[1], dim[2], xy_step, z_step);
   vol->tf.readTF(tfName);
 
   //-- Model Window --
@@ -14,14 +14,25 @@
 
 #define GL_GLEXT_PROTOTYPES
 
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
 #include <iostream>
 #include <iomanip>
 #include <algorithm>
+#include <cstring>
+#include <cctype>
+#include <cstdio>
 
 #include "volume.h"
 
 #include "tables.h"
 
+#include "../offParser.h"
+
 /// Shaders CPU version
 
 #ifdef NO_NVIDIA
@@ -32,7 +43,6 @@
 /// Static local function
 
 static void errcheck(char * place);
-static bool lessCentroid(const pairTet& p1, const pairTet& p2);
 
 /// Error check
 /// @arg place were this functions was called
@@ -50,23 +60,17 @@ void errcheck(char * place)
     }
 }
 
-/// Less Centroid comparison
-/// @arg p1 first tet's pair 
-/// @arg p2 second tet's pair 
-
-bool lessCentroid(const pairTet& p1, const pairTet& p2) 
-{
-  return p1.cZ < p2.cZ;
-}
-
 /**
  * volume Class
  */
 
 /// Constructor
 
-volume::volume()
+volume::volume() : implicitTets(false)
 {
+#ifdef NO_NVIDIA
+  kbufWidth = kbufHeight = 0;
+#endif
 }
 
 /// Destructor
@@ -158,85 +162,111 @@ void volume::deleteArrays(void)
 
 bool volume::readFile(const char* filename, const fileType& ft,
 		      const uint& rows, const uint& cols,
-		      const uint& nums)
+		      const uint& nums, const uint& xy_step,
+		      const uint& z_step)
 {
   bool rb = false;
+  if (ft == OFF || ft == GRADOFF || ft == GEO) implicitTets = false; // unstructured
   if (ft == OFF) rb = readOFF(filename);
   else if (ft == GRADOFF) rb = readGradOFF(filename);
   else if (ft == GEO) rb = readGeoOFF(filename);
-  else rb = readMedBIN(filename, rows, cols, nums, ft);
+  else rb = readMedBIN(filename, rows, cols, nums, ft, xy_step, z_step);
   return rb;
 }
 
 /// Read Object File Format (OFF)
+/// The file is read in large blocks and parsed in parallel
+/// (files with records split across lines, or sharing a line, are read
+/// again by the ifstream reader)
 
 bool volume::readOFF(const char* filename)
 {
-  uint numVerts, numTets, idxV1, idxV2, idxV3, idxV4;
-  GLfloat x, y, z, scalar;
-
-  ifstream input(filename);
+  offParser< GLfloat, uint > parser;
 
-  if(input.fail())
+  if (!parser.open(filename))
     return false;
 
-  input >> numVerts >> numTets;
+  createBuffers(parser.numTets, parser.numVerts);
 
-  createBuffers(numTets, numVerts);
-
-  for(uint i = 0; i < numVerts; i++)
-    {
-      input >> x >> y >> z >> scalar;
-      addVertex(x, y, z, scalar);
-    }
-
-  for(uint i = 0; i < numTets; i++)
-    {
-      input >> idxV1 >> idxV2 >> idxV3 >> idxV4;
-      addCell(idxV1, idxV2, idxV3, idxV4);
-    }
+  // vertex records: x y z scalar
+  if (!parser.parse(positionBuffer, 4, (GLfloat*)NULL, 0, tetrahedralBuffer)) {
+    parser.close();
+    if (!readOFFStream(filename, false))
+      return false;
+  }
 
   Normalize();
 
-  input.close();
-
   return true;
 }
 
 /// Read Object File Format with gradients (grad.off)
+/// The file is read in large blocks and parsed in parallel
+/// (files with records split across lines, or sharing a line, are read
+/// again by the ifstream reader)
 
 bool volume::readGradOFF(const char* filename)
 {
-  uint numVerts, numTets, idxV1, idxV2, idxV3, idxV4;
-  GLfloat x, y, z, scalar, gx, gy, gz;
+  offParser< GLfloat, uint > parser;
+
+  if (!parser.open(filename))
+    return false;
+
+  createBuffers(parser.numTets, parser.numVerts);
+
+  // vertex records: x y z scalar gx gy gz
+  if (!parser.parse(positionBuffer, 4, gradientBuffer, 3, tetrahedralBuffer)) {
+    parser.close();
+    if (!readOFFStream(filename, true))
+      return false;
+  }
+
+  Normalize();
+
+  return true;
+}
+
+/// Read OFF records with the ifstream reader, into the created
+/// buffers (any white space between the values)
+/// @arg filename name of the file to be open
+/// @arg readGrad vertex records with gradients (grad.off)
+
+bool volume::readOFFStream(const char* filename, const bool& readGrad)
+{
+  uint nV, nT;
 
   ifstream input(filename);
 
   if(input.fail())
     return false;
 
-  input >> numVerts >> numTets;
+  input >> nV >> nT;
 
-  createBuffers(numTets, numVerts);
+  if(input.fail() || nV != numVerts || nT != numTets)
+    return false;
 
   for(uint i = 0; i < numVerts; i++)
     {
-      input >> x >> y >> z >> scalar >> gx >> gy >> gz;
-      addVertex(x, y, z, scalar);
-      addGradient(gx, gy, gz);
+      for(uint k = 0; k < 4; k++)
+	input >> positionBuffer[i*4 + k];
+      if (readGrad)
+	for(uint k = 0; k < 3; k++)
+	  input >> gradientBuffer[i*3 + k];
     }
 
   for(uint i = 0; i < numTets; i++)
-    {
-      input >> idxV1 >> idxV2 >> idxV3 >> idxV4;
-      addCell(idxV1, idxV2, idxV3, idxV4);
-    }
+    for(uint k = 0; k < 4; k++)
+      {
+	uint idx;
+	input >> idx;
+	tetrahedralBuffer[i*4 + k] = (GLfloat)idx;
+      }
 
-  Normalize();
+  bool ok = !input.fail();
 
   input.close();
 
-  return true;
+  return ok;
 }
 
 /// Read Geological OFF
@@ -284,10 +314,13 @@ bool volume::readGeoOFF(const char* filename)
 /// @arg cols number of columns of the binary file
 /// @arg nums number of slices of the binary file
 /// @arg ft file type
+/// @arg xy_step subsampling step in x and y
+/// @arg z_step subsampling step in z
 
 bool volume::readMedBIN(const char* filename, const uint& rows,
 			const uint& cols, const uint& nums,
-			const fileType& ft)
+			const fileType& ft, const uint& xy_step,
+			const uint& z_step)
 {
   uint nB = 1; //< number of Bytes for each scalar
   bool ffiles = false; //< true if it is fragmented files
@@ -312,145 +345,329 @@ bool volume::readMedBIN(const char* filename, const uint& rows,
   if (readGrad) // if the gradients are being read
     B2jump = nB + sizeof( float ) * 3; // increment the number of Bytes for each data chunk
 
-  // Get Dimensions
-  dimX = rows;
-  dimY = cols;
-  dimZ = nums;
+  if (xy_step < 1 || z_step < 1)
+    return false;
 
-  /// Get Offsets
-  uint offset_x_begin = 0; uint offset_x_end = 0;
-  uint offset_y_begin = 0; uint offset_y_end = 0;
-  uint offset_z_begin = 0; uint offset_z_end = 0;
-  uint xy_step = 1; uint z_step = 1;
+  // Get Dimensions (subsampled grid)
+  dimX = (rows + xy_step - 1) / xy_step;
+  dimY = (cols + xy_step - 1) / xy_step;
+  dimZ = (nums + z_step - 1) / z_step;
 
   // Create Buffers
   uint numTets = (dimX-1)*(dimY-1)*(dimZ-1)*5;
   uint numVerts = dimX*dimY*dimZ;
 
-  createBuffers(numTets, numVerts);
-
-  // File to be read
-  ifstream volume_file;
-
-  if (!ffiles) { // if its only one binary file
-    volume_file.open(filename);
-    if (volume_file.fail()) {
-      cerr << "Can't open " << filename << " for reading." << endl;
-      return false;
-    }
+  // Implicit tetrahedra: the first step computes vertex ids in
+  // floats, exact up to 2^24
+  if (implicitTets && numVerts > (1u << 24)) {
+    cerr << "Grid of " << numVerts << " vertices too large for -g (at most "
+	 << (1u << 24) << "): subsample it with -s." << endl;
+    return false;
   }
 
+  createBuffers(numTets, numVerts);
+
   cout << "readMedBin: " << filename << " grad? "
        << (readGrad ? "true" : "false") << " frag? "
        << (ffiles ? "true" : "false")
        << " ; Bytes to jump: " << B2jump << endl;
 
-  cout << "dimensions: " << rows << "x" << cols << "x" << nums << endl;
+  cout << "dimensions: " << rows << "x" << cols << "x" << nums
+       << " ; step: " << xy_step << "x" << xy_step << "x" << z_step << endl;
 
-  for (uint z = offset_z_begin; z < (nums - offset_z_end); z+=z_step) {
+  bool rb = false;
 
-    if (ffiles) { // if its more than one binary file
-      stringstream ss;
-      if (pnm)
-	ss << filename << "." << (z+1) << ".pnm";
-      else
-	ss << filename << "." << (z+1);
+  if (ffiles)
+    rb = readSliceFiles(filename, rows, cols, nums, nB, bigE, pnm, xy_step, z_step);
+  else
+    rb = readRawSlabs(filename, rows, cols, nums, nB, bigE, readGrad, xy_step, z_step);
 
-      volume_file.open(ss.str().c_str());
+  if (!rb)
+    return false;
 
-      if (volume_file.fail()) {
-	cerr << "Can't open " << ss.str() << " for reading." << endl;
-	return false;
-      }
+  generateTets();
 
-      if (pnm) { // jump the first 3 lines (header)
-	char buf[256];
-	volume_file.getline(buf, 256);
-	volume_file.getline(buf, 256);
-	volume_file.getline(buf, 256);
-      }
+  Normalize();
+
+  return true;
+}
+
+/// Decode a row of raw voxels into the position buffer
+/// @arg src first voxel of the row
+/// @arg srcStride Bytes between two sampled voxels
+/// @arg n number of sampled voxels
+/// @arg nB number of Bytes for each scalar
+/// @arg bigE big endian scalars
+/// @arg dst first vertex of the row in the position buffer (x, y, z, s)
+/// @arg x0 x coordinate of the first vertex
+/// @arg xStep x coordinate step
+/// @arg y, z coordinates of the row
+
+static void decodeRawRow(const unsigned char* src, uint srcStride, uint n,
+			 uint nB, bool bigE, GLfloat* dst, uint x0, uint xStep,
+			 GLfloat y, GLfloat z)
+{
+  // Scalars: one specialized loop for each format (vectorizable)
+  if (nB == 1)
+    for (uint i = 0; i < n; ++i)
+      dst[i*4 + 3] = (GLfloat)src[i*srcStride];
+  else if (bigE)
+    for (uint i = 0; i < n; ++i)
+      dst[i*4 + 3] = (GLfloat)( src[i*srcStride + 1] | (src[i*srcStride] << 8) );
+  else
+    for (uint i = 0; i < n; ++i)
+      dst[i*4 + 3] = (GLfloat)( src[i*srcStride] | (src[i*srcStride + 1] << 8) );
+
+  // Positions
+  for (uint i = 0; i < n; ++i)
+    {
+      dst[i*4 + 0] = (GLfloat)(x0 + i*xStep);
+      dst[i*4 + 1] = y;
+      dst[i*4 + 2] = z;
     }
+}
 
-    for (uint y = offset_y_begin; y < (cols - offset_y_end); y+=xy_step) {
+/// Read Raw Slabs
+/// Map a single raw file and decode each sampled slice straight
+/// into the position (and gradient) buffers, one slice per thread
 
-      for (uint x = offset_x_begin; x < (rows - offset_x_end); x+=xy_step) {
+bool volume::readRawSlabs(const char* filename, const uint& rows,
+			  const uint& cols, const uint& nums,
+			  const uint& nB, const bool& bigE,
+			  const bool& readGrad, const uint& xy_step,
+			  const uint& z_step)
+{
+  uint B2jump = (readGrad) ? nB + sizeof( float ) * 3 : nB;
+  size_t sliceBytes = (size_t)rows * cols * B2jump;
+  size_t needed = sliceBytes * nums;
 
-	// compute the total jump factor
-	uint jump = 0;
+  int fd = open(filename, O_RDONLY);
 
-	if (ffiles) {
-	  if (pnm)
-	    jump = (uint)(y*rows*B2jump*3 + x*B2jump*3);
-	  else
-	    jump = (uint)(y*rows*B2jump + x*B2jump);
-	}
-	else
-	  jump = (uint)(z*cols*rows*B2jump + y*rows*B2jump + x*B2jump);
+  if (fd < 0) {
+    cerr << "Can't open " << filename << " for reading." << endl;
+    return false;
+  }
 
-	// seek the file to the correct position
-	volume_file.seekg( jump );
+  struct stat st;
 
-	char* buf;
+  if (fstat(fd, &st) < 0 || (size_t)st.st_size < needed) {
+    cerr << "File " << filename << " is smaller than " << needed << " Bytes." << endl;
+    close(fd);
+    return false;
+  }
 
-	buf = new char[nB];
+  void *addr = mmap(NULL, needed, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
 
-	GLfloat data, gx, gy, gz;
+  if (addr == MAP_FAILED) {
+    cerr << "Can't map " << filename << " for reading." << endl;
+    return false;
+  }
 
-	volume_file.read(buf, nB);
+  madvise(addr, needed, MADV_SEQUENTIAL);
 
-	if (readGrad) {
-	  volume_file.read( (char*)&gx, sizeof(float) );
-	  volume_file.read( (char*)&gy, sizeof(float) );
-	  volume_file.read( (char*)&gz, sizeof(float) );
+  const unsigned char *data = (const unsigned char*)addr;
 
-	  addGradient(gx, gy, gz);
-	}
+#pragma omp parallel for schedule(dynamic, 1)
+  for (int zi = 0; zi < (int)dimZ; ++zi) {
 
-	if (nB > 1) {
-	  if (bigE)
-	    data = (GLfloat)((unsigned char)buf[1] + 256*(unsigned char)buf[0]);
-	  else
-	    data = (GLfloat)((unsigned char)buf[0] + 256*(unsigned char)buf[1]);
-	}
-	else
-	  data = (GLfloat)((unsigned char)buf[0]);
+    uint z = zi * z_step;
+
+    for (uint yi = 0; yi < dimY; ++yi) {
 
-	delete buf;
+      uint y = yi * xy_step;
 
-	if (pnm)
-	  addVertex((GLfloat)x, (GLfloat)y, (GLfloat)z*20, data);
-	else
-	  addVertex((GLfloat)x, (GLfloat)y, (GLfloat)z, data);
+      const unsigned char *row = data + z * sliceBytes + (size_t)y * rows * B2jump;
+      uint vId = (zi * dimY + yi) * dimX;
+
+      decodeRawRow(row, xy_step * B2jump, dimX, nB, bigE,
+		   &positionBuffer[vId * 4], 0, xy_step,
+		   (GLfloat)y, (GLfloat)z);
+
+      if (readGrad) // gradients are interleaved after each scalar
+	for (uint xi = 0; xi < dimX; ++xi)
+	  memcpy(&gradientBuffer[(vId + xi) * 3],
+		 row + xi * xy_step * B2jump + nB, sizeof( float ) * 3);
+    }
+  }
+
+  munmap(addr, needed);
+
+  return true;
+}
 
+/// Parse a Netpbm (PNM) header: magic, width, height and maxval
+/// @arg buf slice file contents
+/// @arg size slice file size
+/// @arg channels returns number of channels (P5 = 1, P6 = 3)
+/// @arg nB returns number of Bytes for each sample
+/// @return offset of the first sample or 0 on error
+
+static size_t parsePNMHeader(const unsigned char* buf, size_t size,
+			     uint& channels, uint& nB)
+{
+  if (size < 2 || buf[0] != 'P' || (buf[1] != '5' && buf[1] != '6'))
+    return 0;
+
+  channels = (buf[1] == '6') ? 3 : 1;
+
+  uint values[3]; // width, height, maxval
+  size_t p = 2;
+
+  for (uint v = 0; v < 3; ++v) {
+
+    // skip white spaces and comments
+    while (p < size && (isspace(buf[p]) || buf[p] == '#')) {
+      if (buf[p] == '#')
+	while (p < size && buf[p] != '\n') ++p;
+      else
+	++p;
+    }
+
+    if (p == size || !isdigit(buf[p]))
+      return 0;
+
+    values[v] = 0;
+    while (p < size && isdigit(buf[p]))
+      values[v] = values[v] * 10 + (buf[p++] - '0');
+  }
+
+  nB = (values[2] > 255) ? 2 : 1;
+
+  // a single white space separates the header from the samples
+  return p + 1;
+}
+
+/// Read Slice Files
+/// Read one file per slice (filename.N or filename.N.pnm) using a
+/// pool of I/O threads: each thread reads a whole slice file, parses
+/// its header and decodes it straight into the position buffer
+
+bool volume::readSliceFiles(const char* filename, const uint& rows,
+			    const uint& cols, const uint& nums,
+			    const uint& nB, const bool& bigE,
+			    const bool& pnm, const uint& xy_step,
+			    const uint& z_step)
+{
+  vector< double > readLatency(dimZ, 0.0), decodeTime(dimZ, 0.0);
+  vector< size_t > sliceBytes(dimZ, 0);
+
+  // Result of each slice (written only by the thread reading it)
+  vector< char > sliceOk(dimZ, 0);
+
+#pragma omp parallel for schedule(dynamic, 1) num_threads(NUM_IO_THREADS)
+  for (int zi = 0; zi < (int)dimZ; ++zi) {
+
+    uint z = zi * z_step;
+
+    stringstream ss;
+    if (pnm)
+      ss << filename << "." << (z+1) << ".pnm";
+    else
+      ss << filename << "." << (z+1);
+
+    struct timeval t0, t1, t2;
+    gettimeofday(&t0, 0);
+
+    // Read the whole slice file
+    vector< unsigned char > buf;
+    FILE *slice_file = fopen(ss.str().c_str(), "rb");
+
+    if (slice_file) {
+      fseek(slice_file, 0, SEEK_END);
+      long size = ftell(slice_file);
+      fseek(slice_file, 0, SEEK_SET);
+      if (size > 0) {
+	buf.resize(size);
+	if (fread(&buf[0], 1, size, slice_file) != (size_t)size)
+	  buf.clear();
       }
+      fclose(slice_file);
+    }
+
+    gettimeofday(&t1, 0);
+
+    // Decode the slice
+    uint channels = 1, sB = nB;
+    size_t offset = 0;
+
+    if (!buf.empty() && pnm)
+      offset = parsePNMHeader(&buf[0], buf.size(), channels, sB);
+
+    uint sampleBytes = sB * channels;
+
+    if (buf.empty() || (pnm && offset == 0) ||
+	buf.size() < offset + (size_t)rows * cols * sampleBytes) {
+
+#pragma omp critical
+      cerr << "Can't read " << ss.str() << "." << endl;
+
+      continue;
+    }
+
+    for (uint yi = 0; yi < dimY; ++yi) {
+
+      uint y = yi * xy_step;
+      uint vId = (zi * dimY + yi) * dimX;
+
+      // Netpbm samples are big endian; only the first channel is used
+      decodeRawRow(&buf[offset + (size_t)y * rows * sampleBytes], xy_step * sampleBytes,
+		   dimX, sB, (pnm) ? true : bigE, &positionBuffer[vId * 4], 0, xy_step,
+		   (GLfloat)y, (pnm) ? (GLfloat)z*20 : (GLfloat)z);
     }
-    if (ffiles) // if its more than one binary file
-      volume_file.close();
+
+    gettimeofday(&t2, 0);
+
+    readLatency[zi] = (t1.tv_sec - t0.tv_sec) + (t1.tv_usec - t0.tv_usec)/1000000.0;
+    decodeTime[zi] = (t2.tv_sec - t1.tv_sec) + (t2.tv_usec - t1.tv_usec)/1000000.0;
+    sliceBytes[zi] = buf.size();
+    sliceOk[zi] = 1;
   }
 
-  if (!ffiles) // if its only one binary file
-    volume_file.close();
+  for (uint zi = 0; zi < dimZ; ++zi)
+    if (!sliceOk[zi])
+      return false;
 
-  generateTets();
+  // Per-slice latency report
+  if (debug_cout) {
 
-  Normalize();
+    double minRead = readLatency[0], maxRead = readLatency[0], sumRead = 0.0, sumDecode = 0.0;
+    uint slowest = 0;
+    size_t totalBytes = 0;
+
+    for (uint zi = 0; zi < dimZ; ++zi) {
+      if (readLatency[zi] < minRead) minRead = readLatency[zi];
+      if (readLatency[zi] > maxRead) { maxRead = readLatency[zi]; slowest = zi; }
+      sumRead += readLatency[zi];
+      sumDecode += decodeTime[zi];
+      totalBytes += sliceBytes[zi];
+    }
+
+    cout << "*** Slices read              : " << setw(10) << dimZ << " ( "
+	 << NUM_IO_THREADS << " I/O threads ) ***" << endl;
+    cout << "*** Slice read latency (s)   : min " << minRead << " avg " << sumRead / dimZ
+	 << " max " << maxRead << " ( slice " << (slowest * z_step + 1) << " ) ***" << endl;
+    cout << "*** Slice decode time (s)    : avg " << sumDecode / dimZ << " ***" << endl;
+    cout << "*** Slice read throughput    : " << (totalBytes / 1000000.0) / (sumRead / NUM_IO_THREADS)
+	 << " MB/s ( " << ((sumRead > sumDecode) ? "I/O" : "decode") << " bound ) ***" << endl;
+  }
 
   return true;
 }
 
 /// Generate Tetrahedra (5 by Hexahedron)
+/// The grid dimensions are already subsampled by readMedBIN
 
 void volume::generateTets(void)
 {
-  // Get Dimensions and step
-
-  uint xy_step = 1; uint z_step = 1;
+  if (implicitTets) // computed on the fly by tetVertex
+    return;
 
   uint idv[8];
 
-  for (uint z = 0; z < (dimZ - 1); z += (uint)z_step) {
-    for (uint y = 0; y < (dimY - 1); y += (uint)xy_step) {
-      for (uint x = 0; x < (dimX - 1); x += (uint)xy_step) {
+  for (uint z = 0; z < (dimZ - 1); ++z) {
+    for (uint y = 0; y < (dimY - 1); ++y) {
+      for (uint x = 0; x < (dimX - 1); ++x) {
 
 	idv[0] = (uint)(   x +     y*(dimX) +     z*(dimX*dimY) );
 	idv[1] = (uint)( x+1 +     y*(dimX) +     z*(dimX*dimY) );
@@ -483,13 +700,20 @@ void volume::createBuffers(const uint& nt, const uint& nv)
 
   vertTexSize = (uint)ceil(sqrt(numVerts));
   tetTexSize = (uint)ceil(sqrt(numTets));
+
+  // Implicit tetrahedra: each texel row holds whole rows of cells
+  // (see frag_1st.shader)
+  if (implicitTets && dimX > 1) {
+    uint cellRow = 5 * (dimX - 1);
+    tetTexSize = ((tetTexSize + cellRow - 1) / cellRow) * cellRow;
+  }
 /*
   if (tetrahedralBuffer)
     delete tetrahedralBuffer;
   if (positionBuffer)
     delete positionBuffer;
 */
-  tetrahedralBuffer = new GLfloat[numTets * 4];
+  tetrahedralBuffer = (implicitTets) ? NULL : new GLfloat[numTets * 4];
   positionBuffer = new GLfloat[vertTexSize * vertTexSize * 4];
   gradientBuffer = new GLfloat[vertTexSize * vertTexSize * 3];
 
@@ -554,7 +778,7 @@ void volume::CreateArrays(void)
       /// Fill vertex array with tetrahedron's four vertices
       for (j = 1; j < 5; ++j)
 	{
-	  vertId = (GLuint)tetrahedralBuffer[i*4 + j-1];
+	  vertId = tetVertex(i, j-1);
 	  for (k = 0; k < 3; ++k)
 	    {
 	      colorArray[idArray + j*4 + k] = positionBuffer[vertId*4 + 3];
@@ -667,6 +891,7 @@ void volume::CreateOutputTextures()
  **/
 void volume::updateIC(void)
 {
+#ifndef NO_NVIDIA
   shaders_2nd_with_shading->use();
   shaders_2nd_with_shading->set_uniform("ks", ic.getKs());
   shaders_2nd_with_shading->set_uniform("kd", ic.getKd());
@@ -678,6 +903,7 @@ void volume::updateIC(void)
   shaders_2nd_with_shading->set_uniform("brightnessIC", ic.getRho(0, 1), ic.getRho(1, 1), ic.getRho(2, 1));
 
   shaders_2nd_with_shading->use(0);
+#endif
 }
 
 /// Reload Tetrahedra Textures
@@ -685,6 +911,11 @@ void volume::updateIC(void)
 
 void volume::reloadTetTex(void)
 {
+  /// Implicit tetrahedra are not discarded: the cell index is the
+  /// tetrahedron id, so the grid order must be kept
+  if (implicitTets)
+    return;
+
   /// Discard n tetrahedra
   GLfloat *curTetBuffer;
   curTetBuffer = new GLfloat[numTets * 4];
@@ -697,7 +928,7 @@ void volume::reloadTetTex(void)
 
       for (GLint j = 0; j < 4; ++j)
 	{
-	  GLuint vertId = (GLuint)tetrahedralBuffer[i*4 + j];
+	  GLuint vertId = tetVertex(i, j);
 
 	  s = positionBuffer[vertId*4 + 3];
 
@@ -760,6 +991,7 @@ void volume::reloadTetTex(void)
     curTets = newCurTets;
     tetTexSize = (uint)ceil(sqrt( curTets ));
 
+#ifndef NO_NVIDIA
     glDeleteTextures(1, &tetrahedralTex);
 
     glActiveTexture(GL_TEXTURE9);
@@ -771,6 +1003,7 @@ void volume::reloadTetTex(void)
     shader_1st->use();
     shader_1st->set_uniform("tetrahedralTex", 9);
     shader_1st->use(0);
+#endif
   }
 
   delete curTetBuffer;
@@ -781,8 +1014,6 @@ void volume::reloadTetTex(void)
 
 void volume::reloadTFTex(void)
 {
-#ifndef NO_NVIDIA
-
   for (uint i = 0; i < 256; ++i)
     {
       for (uint j = 0; j < 4; ++j)
@@ -790,6 +1021,8 @@ void volume::reloadTFTex(void)
     }
 
   reloadTetTex();
+
+#ifndef NO_NVIDIA
   
   /// Reload TF texture
   glActiveTexture(GL_TEXTURE5);
@@ -826,13 +1059,14 @@ void volume::CreateInputTextures(void)
     cout << "*** Tetrahedral Texture Size : " << setw(10) << tetTexSize << " ***" << endl;
   }
 
-  /// Generate tetrahedral texture
+  /// Generate tetrahedral texture (implicit tetrahedra need none)
   glGenTextures(1, &tetrahedralTex);
   glActiveTexture(GL_TEXTURE9);
   glBindTexture(TEX_FORMAT, tetrahedralTex);
   glTexParameteri(TEX_FORMAT, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
   glTexParameteri(TEX_FORMAT, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-  glTexImage2D(TEX_FORMAT, 0, TEX_TYPE, tetTexSize, tetTexSize, 0, GL_RGBA, GL_FLOAT, tetrahedralBuffer);
+  if (!implicitTets)
+    glTexImage2D(TEX_FORMAT, 0, TEX_TYPE, tetTexSize, tetTexSize, 0, GL_RGBA, GL_FLOAT, tetrahedralBuffer);
 
   /// Generate vertex position texture
   glGenTextures(1, &vertexPosTex);
@@ -950,6 +1184,15 @@ void volume::CreateInputTextures(void)
   if (debug_cout)
     cout << "*** psiGamma Table Size      : " << setw(10) << preIntTexSize << " ***" << endl;
 
+  // The CPU path discards tetrahedra by the transfer function too
+  tfTexBuffer = new GLfloat[256*4];
+
+  for (int i = 0; i < 256; ++i)
+    {
+      for (int j = 0; j < 4; ++j)
+	tfTexBuffer[i*4 + j] = tf[i][j];
+    } 
+
 #endif
 }
 
@@ -1070,6 +1313,10 @@ void volume::CreateShaders()
   shader_1st->set_uniform("orderTableTex", 4);
   shader_1st->set_uniform("gradientTex", 8);
   shader_1st->set_uniform("vertTexSize", (GLfloat)vertTexSize);
+  shader_1st->set_uniform("implicitTets", (GLint)implicitTets);
+  shader_1st->set_uniform("tetTexSize", (GLfloat)tetTexSize);
+  shader_1st->set_uniform("cellRows", (GLfloat)((implicitTets && dimX > 1) ? tetTexSize / (5 * (dimX - 1)) : 0));
+  shader_1st->set_uniform("gridDim", (GLfloat)dimX, (GLfloat)dimY, (GLfloat)dimZ);
   shader_1st->use(0);
 
   shaders_2nd = shaders_2nd_with_int;
@@ -1211,12 +1458,11 @@ void volume::UpdateData()
 /// Setup Arrays
 /// Fill (Intersection Vertex) and reorder vertex and color arrays
 
-void volume::SetupArrays(bool useCentroid)
+void volume::SetupArrays(void)
 {
   GLuint id_order = 0, tetId = 0;
   GLuint vecArrayId = 0, vecIndicesId = 0;
   GLuint count_tfan = 0;
-  GLuint curr_bucket = 0;
 
   //------------ debug -----------------
 
@@ -1238,20 +1484,8 @@ void volume::SetupArrays(bool useCentroid)
 
   for(uint i = 0; i < curTets; ++i)
     {
-      if (sorting) { // debug
-	if (useCentroid) //centroid sorting
-	  {
-	    tetId = cellSorted[i].id;
-	  }
-	else //layer sorting
-	  {
-	    while (centroidBucket[curr_bucket].empty())
-	      curr_bucket ++;
-	    
-	    tetId = centroidBucket[curr_bucket].back();
-	    centroidBucket[curr_bucket].pop_back();
-	  }
-      }
+      if (sorting) // centroid or bucket sorting (debug)
+	tetId = cellSorted[i].id;
       else
 	tetId = i; // no sorting
 
@@ -1371,6 +1605,7 @@ void volume::SetupArrays(bool useCentroid)
   //   }
   //   cout << endl;
 
+#ifndef NO_NVIDIA
   shaders_2nd_with_int->use();
   shaders_2nd_with_int->set_uniform("max_thickness", max_thickness);
   shaders_2nd_with_int->use(0);
@@ -1380,6 +1615,7 @@ void volume::SetupArrays(bool useCentroid)
   shaders_2nd_no_int->use();
   shaders_2nd_no_int->set_uniform("max_thickness", max_thickness);
   shaders_2nd_no_int->use(0);
+#endif
 
 }
 
@@ -1471,23 +1707,44 @@ void volume::Normalize()
 {
   GLfloat min[4], max[4];
   GLfloat scaleCoord, scaleScalar, maxCoord;
-  GLfloat vert, center[3];
+  GLfloat center[3];
   
   for (int i = 0; i < 4; ++i)
     {
       min[i] = positionBuffer[i];
       max[i] = positionBuffer[i];
     }
-    
-  for(uint i = 1; i < numVerts; ++i)
-    {
-      for (int k = 0; k < 4; ++k)
-	{
-	  vert = positionBuffer[i*4 + k];
-	  if(min[k] > vert) min[k] = vert;
-	  if(max[k] < vert) max[k] = vert;
-	}
-    }
+
+  // Bounding box and scalar range: per-thread partial limits
+  // merged at the end (the inner loop over x, y, z, s vectorizes)
+#pragma omp parallel
+  {
+    GLfloat tmin[4], tmax[4];
+
+    for (int k = 0; k < 4; ++k)
+      {
+	tmin[k] = min[k];
+	tmax[k] = max[k];
+      }
+
+#pragma omp for nowait
+    for(int i = 1; i < (int)numVerts; ++i)
+      {
+	const GLfloat *vert = &positionBuffer[i*4];
+	for (int k = 0; k < 4; ++k)
+	  {
+	    tmin[k] = (vert[k] < tmin[k]) ? vert[k] : tmin[k];
+	    tmax[k] = (vert[k] > tmax[k]) ? vert[k] : tmax[k];
+	  }
+      }
+
+#pragma omp critical
+    for (int k = 0; k < 4; ++k)
+      {
+	if(min[k] > tmin[k]) min[k] = tmin[k];
+	if(max[k] < tmax[k]) max[k] = tmax[k];
+      }
+  }
     
   for (int i = 0; i < 3; ++i)
     {
@@ -1500,7 +1757,8 @@ void volume::Normalize()
   scaleCoord = (GLfloat)( 1.0 / maxCoord );
   scaleScalar = (GLfloat)( 1.0 / (max[3] - min[3]) );
   
-  for(uint i = 0; i < numVerts; ++i)
+#pragma omp parallel for
+  for(int i = 0; i < (int)numVerts; ++i)
     {
       for (int k = 0; k < 3; ++k)
 	positionBuffer[i*4 + k] = (positionBuffer[i*4 + k] - center[k]) * scaleCoord;
@@ -1557,50 +1815,53 @@ void volume::addCell(uint idxV0, uint idxV1, uint idxV2, uint idxV3)
 void volume::centroidSorting(void)
 {
   if (!sorting) return;
-  for (uint i = 0; i < curTets; ++i)
+  long i;
+
+  depthKeys.resize(curTets);
+  sortedIds.resize(curTets);
+
+#pragma omp parallel for
+  for (i = 0; i < (long)curTets; ++i)
+    depthKeys[i] = outputBuffer0[i*4 + 2];
+
+  // parallel radix sort on separate keys and ids (see ../depthSort.h)
+  radixSorter.sort( &depthKeys[0], &sortedIds[0], curTets );
+
+#pragma omp parallel for
+  for (i = 0; i < (long)curTets; ++i)
     {
-      cellSorted[i].id = i;
-      cellSorted[i].cZ = outputBuffer0[i*4 + 2];
-      //  cout << i << " : " << cellSorted[i].cZ << endl;
+      cellSorted[i].id = sortedIds[i];
+      cellSorted[i].cZ = depthKeys[ sortedIds[i] ];
     }
-  //  cout << endl;
-
-  std::sort( cellSorted, cellSorted+curTets, lessCentroid ); // stl stable sort
 }
 
 /*
- * Simple bucket sorting:
- * divide the normalized model in NUM_BUCKETS layers,
- * put each tetrahedron in the layer that matches its centroid Z coordinate
- * render the buckets in back-to-front order
+ * Bucket sorting:
+ * divide the centroid Z range in layers (about 4 tetrahedra per layer),
+ * count sort each tetrahedron in the layer that matches its centroid Z
+ * coordinate, rendering the layers in back-to-front order
  * note: inside the buckets the tetrahedra remain unsorted
  */
 void volume::bucketSorting(void)
 {
   if (!sorting) return;
-  uint bucket = 0;
-  for (uint i = 0; i <= NUM_BUCKETS; ++i)
-    centroidBucket[i].clear();
-
-  double min = outputBuffer0[2];
-  double max = outputBuffer0[2];
-  for (uint i = 0; i < curTets; ++i)
-    {	  
-      double cz = outputBuffer0[i*4 + 2];
-      if (min > cz) min = cz;
-      if (max < cz) max = cz;
-    }
+  long i;
+
+  depthKeys.resize(curTets);
+  sortedIds.resize(curTets);
+
+#pragma omp parallel for
+  for (i = 0; i < (long)curTets; ++i)
+    depthKeys[i] = outputBuffer0[i*4 + 2];
 
-  double rng = max - min;
-  int offset = (int)(NUM_BUCKETS);
-  for (uint i = 0; i < curTets; ++i)
-    {	  
-      bucket = (int)(((outputBuffer0[i*4 + 2] - min) / rng) * offset);
-      if (bucket > NUM_BUCKETS)
-	bucket = NUM_BUCKETS;
-      if (bucket < 0)
-	bucket = 0;
-
-      centroidBucket[bucket].push_back(i);
+  // flat parallel counting sort, the number of buckets grows with the
+  // number of tetrahedra (see ../depthSort.h)
+  radixSorter.bucketSort( &depthKeys[0], &sortedIds[0], curTets );
+
+#pragma omp parallel for
+  for (i = 0; i < (long)curTets; ++i)
+    {
+      cellSorted[i].id = sortedIds[i];
+      cellSorted[i].cZ = depthKeys[ sortedIds[i] ];
     }
 }
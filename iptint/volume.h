@@ -27,15 +27,18 @@ extern "C" {
 
 #ifndef NO_NVIDIA
 #include "glslKernel.h"
+#else
+#include "../kBuffer.h"
 #endif
 
 #include "transferFunction.h"
+#include "../depthSort.h"
 #include "illuminationControl.h"
 
 #define MINORTHOSIZE -1.2
 #define MAXORTHOSIZE 1.2
 
-#define NUM_BUCKETS 150
+#define NUM_IO_THREADS 8 ///< I/O threads reading slice files
 
 /// Object file format type
 enum fileType { OFF, GRADOFF, GEO, BIN8, BIN16BE, BIN16LE,
@@ -65,6 +68,7 @@ typedef struct _pairTet {
 
 extern bool debug_shaders, debug_cout, integrating, sorting, shading;
 extern GLint modelWinWidth, modelWinHeight;
+extern GLint kBufferSize;
 
 class volume
 {
@@ -80,7 +84,8 @@ class volume
 
   bool readFile(const char* filename, const fileType& ft,
 		const uint& rows = 0, const uint& cols = 0,
-		const uint& nums = 0);
+		const uint& nums = 0, const uint& xy_step = 1,
+		const uint& z_step = 1);
 
   void CreateTextures(void);
   void CreateShaders(void);
@@ -114,11 +119,16 @@ class volume
   void centroidSorting(void);
   void bucketSorting(void);
 
-  void SetupArrays(bool useCentroid);
+  void SetupArrays(void);
   void createBuffers(const uint& nt, const uint& nv);
 
   uint getCurTets(void) { return curTets; }
 
+  /// Structured grids: compute tetrahedra on the fly from the cell
+  /// index instead of storing them (set before readFile)
+  void setImplicitTets(bool it) { implicitTets = it; }
+  bool getImplicitTets(void) { return implicitTets; }
+
   transferFunction tf; //< transfer function
   illuminationControl ic; //illumination control
 
@@ -137,6 +147,9 @@ class volume
   void compute_1st_shader_on_cpu(void);
   void compute_2nd_shader_on_cpu(void);
 
+  kBuffer kbuf; //< CPU k-buffer (kBufferSize > 0)
+  GLint kbufWidth, kbufHeight; //< k-buffer image size
+
 #endif
 
   GLfloat *tetrahedralBuffer, *positionBuffer;
@@ -159,21 +172,49 @@ class volume
 
   pairTet* cellSorted;
 
+  vector<GLfloat> depthKeys; //< centroid Z keys for the radix sort
+  vector<GLuint> sortedIds; //< tetrahedra ids sorted by depthKeys
+  depthSort radixSorter;
+
   uint dimX, dimY, dimZ;
 
+  bool implicitTets; //< tetrahedra computed from (x,y,z) cell index
+
+  /// Vertex k of tetrahedron t (tetrahedralBuffer or implicit grid)
+  GLuint tetVertex(const uint& t, const uint& k) const {
+    if (!implicitTets)
+      return (GLuint)tetrahedralBuffer[t*4 + k];
+    // 5 tetrahedra by hexahedron (see generateTets)
+    static const uint hexCorner[5][4] = { {0, 2, 3, 6}, {3, 5, 6, 7}, {0, 4, 5, 6},
+					  {0, 1, 3, 5}, {0, 3, 5, 6} };
+    uint cell = t / 5, c = hexCorner[t % 5][k];
+    uint x = cell % (dimX-1), y = (cell / (dimX-1)) % (dimY-1), z = cell / ((dimX-1)*(dimY-1));
+    return (x + (c & 1)) + (y + ((c >> 1) & 1))*dimX + (z + ((c >> 2) & 1))*dimX*dimY;
+  }
+
   GLfloat ks, kd, rho[2];
 
   GLfloat max_thickness;
 
-  vector<uint> centroidBucket[NUM_BUCKETS+1];
-
   /// Functions to read volume files
   bool readOFF(const char* filename);
   bool readGradOFF(const char* filename);
   bool readGeoOFF(const char* filename);
+  bool readOFFStream(const char* filename, const bool& readGrad);
   bool readMedBIN(const char* filename, const uint& rows,
 		  const uint& cols, const uint& nums,
-		  const fileType& ft);
+		  const fileType& ft, const uint& xy_step = 1,
+		  const uint& z_step = 1);
+  bool readRawSlabs(const char* filename, const uint& rows,
+		    const uint& cols, const uint& nums,
+		    const uint& nB, const bool& bigE,
+		    const bool& readGrad, const uint& xy_step,
+		    const uint& z_step);
+  bool readSliceFiles(const char* filename, const uint& rows,
+		      const uint& cols, const uint& nums,
+		      const uint& nB, const bool& bigE,
+		      const bool& pnm, const uint& xy_step,
+		      const uint& z_step);
 
   void generateTets(void);
 
@@ -0,0 +1,236 @@
+/**
+ *   K-Buffer
+ *
+ */
+
+/**
+ *   kBuffer : defines a class to composite fragments in CPU keeping
+ *             the k nearest of each pixel, to fix local ordering
+ *             errors of approximate sorts
+ *
+ * C++ header (with implementation).
+ *
+ */
+
+/// --------------------------------   Definitions   ------------------------------------
+
+#ifndef _KBUFFER_H_
+#define _KBUFFER_H_
+
+#include <cmath>
+#include <cstring>
+
+#include <vector>
+#include <algorithm>
+
+#define KBUFFER_MAX 8 ///< Largest number of fragments kept per pixel
+
+/// ----------------------------------   kBuffer   -------------------------------------
+
+/// K-Buffer Class
+///   Fragments (premultiplied RGBA and depth, the eye Z of the cell
+///   front face at the pixel, larger is nearer) arrive roughly
+///   back-to-front.  Each pixel keeps
+///   its k nearest fragments sorted by depth; when a new fragment does
+///   not fit, the farthest of the k + 1 is composited (over operator,
+///   as glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA)) into the pixel
+///   color.  Fragments arriving up to k places too late are thus
+///   composited in depth order.  With k = 0 the fragments are
+///   composited as they arrive
+class kBuffer {
+
+public:
+
+	/// Constructor
+	kBuffer() : width(0), height(0), depth(0), numReordered(0) { }
+
+	/// Size of the buffers
+	/// @return size in Bytes
+	size_t sizeOf(void) const {
+		return frags.size() * sizeof(fragment) + count.size() + color.size() * sizeof(float);
+	}
+
+	/// Resize the buffers (and clear them)
+	/// @arg w, h image size in pixels
+	/// @arg k fragments kept per pixel (at most KBUFFER_MAX)
+	/// @return true if it succeed
+	bool resize(unsigned w, unsigned h, unsigned k) {
+
+		if (k > KBUFFER_MAX) return false;
+
+		width = w;
+		height = h;
+		depth = k;
+
+		frags.resize( (size_t)w * h * k );
+		count.resize( (size_t)w * h );
+		color.resize( (size_t)w * h * 4 );
+
+		clear();
+
+		return true;
+
+	}
+
+	/// Clear the image (transparent black) and the kept fragments
+	void clear(void) {
+		std::fill(count.begin(), count.end(), 0);
+		std::fill(color.begin(), color.end(), 0.0f);
+		numReordered = 0;
+	}
+
+	/// Insert a fragment
+	/// @arg p pixel index ( y * width + x )
+	/// @arg z fragment depth (eye Z, larger is nearer)
+	/// @arg c premultiplied color RGBA
+	void insert(unsigned p, float z, const float* c) {
+
+		fragment f = { z, { c[0], c[1], c[2], c[3] } };
+
+		if (depth == 0) { over(&color[p * 4], f); return; }
+
+		fragment *kept = &frags[ (size_t)p * depth ];
+		unsigned n = count[p];
+
+		if (n == depth) {
+
+			/// Farthest of the k + 1 fragments goes to the pixel color
+			if (z <= kept[0].z) {
+				if (z < kept[0].z) ++numReordered;
+				over(&color[p * 4], f);
+				return;
+			}
+
+			over(&color[p * 4], kept[0]);
+
+			memmove(kept, kept + 1, (depth - 1) * sizeof(fragment));
+
+			--n;
+
+		} else
+			++count[p];
+
+		/// Sorted insertion (kept[0] is the farthest)
+		unsigned k = n;
+
+		while (k > 0 && kept[k-1].z > z) {
+			kept[k] = kept[k-1];
+			--k;
+		}
+
+		kept[k] = f;
+
+		if (k < n) ++numReordered;
+
+	}
+
+	/// Rasterize a triangle (pixel centers, top-left fill rule) with
+	///   depth and colors interpolated from its vertices
+	/// @arg v0, v1, v2 vertices in pixel coordinates and eye Z ( x, y, z )
+	/// @arg c0, c1, c2 premultiplied vertex colors RGBA
+	void triangle(const float* v0, const float* v1, const float* v2,
+		      const float* c0, const float* c1, const float* c2) {
+
+		float area = (v1[0] - v0[0]) * (v2[1] - v0[1]) - (v1[1] - v0[1]) * (v2[0] - v0[0]);
+
+		if (area == 0.0f) return;
+
+		/// Counter-clockwise winding
+		if (area < 0.0f) { std::swap(v1, v2); std::swap(c1, c2); area = -area; }
+
+		const float *v[3] = { v0, v1, v2 }, *c[3] = { c0, c1, c2 };
+
+		int xMin = std::max( 0, (int)floor( std::min( v0[0], std::min(v1[0], v2[0]) ) ) );
+		int yMin = std::max( 0, (int)floor( std::min( v0[1], std::min(v1[1], v2[1]) ) ) );
+		int xMax = std::min( (int)width - 1, (int)ceil( std::max( v0[0], std::max(v1[0], v2[0]) ) ) );
+		int yMax = std::min( (int)height - 1, (int)ceil( std::max( v0[1], std::max(v1[1], v2[1]) ) ) );
+
+		/// Edge e is opposite to vertex e
+		bool topLeft[3];
+
+		for (unsigned e = 0; e < 3; ++e) {
+			const float *a = v[(e + 1) % 3], *b = v[(e + 2) % 3];
+			topLeft[e] = ( b[1] < a[1] ) || ( b[1] == a[1] && b[0] < a[0] );
+		}
+
+		for (int y = yMin; y <= yMax; ++y)
+			for (int x = xMin; x <= xMax; ++x) {
+
+				float px = x + 0.5f, py = y + 0.5f, w[3];
+				bool inside = true;
+
+				for (unsigned e = 0; e < 3 && inside; ++e) {
+					const float *a = v[(e + 1) % 3], *b = v[(e + 2) % 3];
+					w[e] = (b[0] - a[0]) * (py - a[1]) - (b[1] - a[1]) * (px - a[0]);
+					inside = ( w[e] > 0.0f || ( w[e] == 0.0f && topLeft[e] ) );
+				}
+
+				if (!inside) continue;
+
+				float rgba[4], z = ( w[0] * v[0][2] + w[1] * v[1][2] + w[2] * v[2][2] ) / area;
+
+				for (unsigned j = 0; j < 4; ++j)
+					rgba[j] = ( w[0] * c[0][j] + w[1] * c[1][j] + w[2] * c[2][j] ) / area;
+
+				insert(y * width + x, z, rgba);
+
+			}
+
+	}
+
+	/// Composite the fragments still kept (back-to-front)
+	void resolve(void) {
+
+		if (depth == 0) return;
+
+		long p;
+
+#pragma omp parallel for
+		for (p = 0; p < (long)count.size(); ++p) {
+
+			const fragment *kept = &frags[ (size_t)p * depth ];
+
+			for (unsigned k = 0; k < count[p]; ++k)
+				over(&color[p * 4], kept[k]);
+
+			count[p] = 0;
+
+		}
+
+	}
+
+	/// Composited image (premultiplied RGBA floats, width x height)
+	const float* image(void) const { return &color[0]; }
+
+	/// Fragments arrived after a nearer one since the last clear
+	unsigned long reordered(void) const { return numReordered; }
+
+	/// Fragments kept per pixel
+	unsigned k(void) const { return depth; }
+
+private:
+
+	/// Fragment
+	typedef struct _fragment {
+		float z; ///< Depth
+		float c[4]; ///< Premultiplied color
+	} fragment;
+
+	/// Over operator: fragment in front of the pixel color
+	static void over(float* dst, const fragment& f) {
+		float t = 1.0f - f.c[3];
+		for (unsigned j = 0; j < 4; ++j)
+			dst[j] = f.c[j] + t * dst[j];
+	}
+
+	unsigned width, height; ///< Image size
+	unsigned depth; ///< Fragments kept per pixel (k)
+	unsigned long numReordered; ///< Fragments fixed by the buffer
+
+	std::vector< fragment > frags; ///< Kept fragments ( k per pixel )
+	std::vector< unsigned char > count; ///< Kept fragments of each pixel
+	std::vector< float > color; ///< Composited color of each pixel
+
+};
+
+#endif
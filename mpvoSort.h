@@ -0,0 +1,254 @@
+/**
+ *   MPVO Sort
+ *
+ */
+
+/**
+ *   mpvoSort : defines a class to compute a visibility ordering of
+ *              the tetrahedra from the face connectivity (MPVONC)
+ *
+ * C++ header (with implementation).
+ *
+ */
+
+/// --------------------------------   Definitions   ------------------------------------
+
+#ifndef _MPVOSORT_H_
+#define _MPVOSORT_H_
+
+#include "offVol.h"
+
+#include "depthSort.h"
+
+#define MPVO_BUCKETS 1024 ///< Depth buckets of the ready tetrahedra
+
+/// ----------------------------------   mpvoSort   ------------------------------------
+
+/// MPVO Sort Class
+///   Each interior face gives an edge from the tetrahedron behind it
+///   to the one in front, decided by the side of the face normal on
+///   the view direction, once per face from its lower id tetrahedron
+///   (as sortAudit), so both tetrahedra agree on flat faces.  The ordering is a topological sort (Kahn)
+///   of this graph: ready tetrahedra wait in buckets by centroid depth
+///   and the deepest bucket is drained first, so disconnected parts of
+///   non-convex meshes are interleaved back-to-front.  The bucket cursor
+///   never moves back, keeping the sort linear.  Tetrahedra left in
+///   cycles are appended in centroid order.
+template< class real, class natural >
+class mpvoSort {
+
+public:
+
+	typedef offVol< real, natural > volType;
+
+	/// Constructor
+	mpvoSort() : numCycleTets(0) { }
+
+	/// Size of the sort buffers
+	/// @return size in Bytes
+	size_t sizeOf(void) const {
+		return front.size() + bucket.size() * sizeof(unsigned short) + ( inDeg.size() + next.size() + head.size() ) * sizeof(natural) +
+			fallback.sizeOf();
+	}
+
+	/// Tetrahedra ordered by the cycle fallback in the last sort
+	natural cycleTets(void) const { return numCycleTets; }
+
+	/// Sort tetrahedra back-to-front
+	/// @arg vol volume with vertices, tetrahedra and connectivity
+	/// @arg viewZ eye +z axis (towards the viewer) in object coordinates
+	/// @arg keys centroid eye Z of each tetrahedron
+	/// @arg order returns the tetrahedra ids in visibility order
+	/// @return true if it succeed
+	bool sort(const volType& vol, const real* viewZ, const float* keys, natural* order) {
+
+		natural nT = vol.numTets;
+
+		if (!vol.conTet || nT == 0) return false;
+
+		front.resize(nT);
+		bucket.resize(nT);
+		inDeg.resize(nT);
+		next.resize(nT);
+		head.assign(MPVO_BUCKETS, nT);
+
+		long i;
+
+		/// Depth range of the buckets
+		float zMin = keys[0], zMax = keys[0];
+
+		for (natural t = 1; t < nT; ++t) {
+			if (keys[t] < zMin) zMin = keys[t];
+			if (keys[t] > zMax) zMax = keys[t];
+		}
+
+		float zScale = (zMax > zMin) ? (MPVO_BUCKETS - 1) / (zMax - zMin) : 0.0f;
+
+		/// Faces whose neighbor is in front of the tetrahedron, the
+		///   number of neighbors behind it (in-degree, counted from its
+		///   own faces) and its depth bucket
+#pragma omp parallel for
+		for (i = 0; i < (long)nT; ++i) {
+
+			unsigned char mask = 0;
+			natural behind = 0;
+
+			for (natural f = 0; f < 4; ++f) {
+
+				natural n = vol.conTet[i][f];
+
+				if ( n == (natural)i ) continue;
+
+				int side = sideOf(vol, i, f, n, viewZ);
+
+				if (side > 0) mask |= 1 << f;
+				else if (side < 0) ++behind;
+
+			}
+
+			front[i] = mask;
+			inDeg[i] = behind;
+			bucket[i] = bucketOf(keys[i], zMin, zScale);
+
+		}
+
+		for (natural t = nT; t-- > 0; )
+			if (inDeg[t] == 0)
+				push(t, bucket[t]);
+
+		/// Kahn's topological sort, draining the deepest bucket first
+		natural emitted = 0;
+		unsigned cur = 0;
+
+		while (true) {
+
+			while (cur < MPVO_BUCKETS && head[cur] == nT) ++cur;
+
+			if (cur == MPVO_BUCKETS) break;
+
+			natural t = head[cur];
+			head[cur] = next[t];
+
+			order[emitted++] = t;
+
+			for (natural f = 0; f < 4; ++f)
+				if ( front[t] & (1 << f) ) {
+					natural n = vol.conTet[t][f];
+					if (--inDeg[n] == 0)
+						push(n, (bucket[n] < cur) ? cur : bucket[n]);
+				}
+
+		}
+
+		/// Cycles: remaining tetrahedra in centroid order
+		numCycleTets = nT - emitted;
+
+		if (numCycleTets > 0) {
+
+			vector< natural > rest;
+			vector< float > restKeys;
+			vector< unsigned > restOrder( numCycleTets );
+
+			rest.reserve( numCycleTets );
+			restKeys.reserve( numCycleTets );
+
+			for (natural t = 0; t < nT; ++t)
+				if (inDeg[t] > 0) {
+					rest.push_back(t);
+					restKeys.push_back(keys[t]);
+				}
+
+			if ( !fallback.sort(&restKeys[0], &restOrder[0], numCycleTets) ) return false;
+
+			for (natural t = 0; t < numCycleTets; ++t)
+				order[emitted++] = rest[ restOrder[t] ];
+
+		}
+
+		return true;
+
+	}
+
+	/// Side of the neighbor n across face f of tetrahedron t, decided
+	///   by the lower id of the two (the same answer, negated, for n)
+	/// @arg vol volume
+	/// @arg t tetrahedron id
+	/// @arg f face id
+	/// @arg n neighbor across f
+	/// @arg viewZ view direction
+	/// @return as faceSide
+	static int sideOf(const volType& vol, natural t, natural f, natural n, const real* viewZ) {
+
+		natural g = 0;
+
+		while (g < 4 && vol.conTet[n][g] != t) ++g;
+
+		if (g == 4) return 0; ///< not mutual (anomaly): no constraint on either side
+
+		return (t < n) ? faceSide(vol, t, f, viewZ) : -faceSide(vol, n, g, viewZ);
+
+	}
+
+	/// Side of the neighbor across face f of tetrahedron t
+	///   The face normal is computed from the vertices in increasing
+	///   id order, so both tetrahedra sharing the face use the same
+	///   normal and, in a valid mesh, get opposite answers
+	/// @arg vol volume
+	/// @arg t tetrahedron id
+	/// @arg f face id (opposite to vertex MOD4(3, f))
+	/// @arg viewZ view direction
+	/// @return 1 if the neighbor is in front (drawn after t), -1 if
+	///         behind, 0 if the face is parallel to the view direction
+	static int faceSide(const volType& vol, natural t, natural f, const real* viewZ) {
+
+		natural v0 = vol.tetList[t][ MOD4(0, f) ];
+		natural v1 = vol.tetList[t][ MOD4(1, f) ];
+		natural v2 = vol.tetList[t][ MOD4(2, f) ];
+
+		if (v0 > v1) std::swap(v0, v1);
+		if (v1 > v2) std::swap(v1, v2);
+		if (v0 > v1) std::swap(v0, v1);
+
+		const real *a = &vol.vertList[v0][0], *b = &vol.vertList[v1][0], *c = &vol.vertList[v2][0];
+		const real *o = &vol.vertList[ vol.tetList[t][ MOD4(3, f) ] ][0];
+
+		real e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+		real e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+		real n[3] = { e1[1]*e2[2] - e1[2]*e2[1], e1[2]*e2[0] - e1[0]*e2[2], e1[0]*e2[1] - e1[1]*e2[0] };
+
+		real d = n[0]*viewZ[0] + n[1]*viewZ[1] + n[2]*viewZ[2];
+		real s = n[0]*(o[0] - a[0]) + n[1]*(o[1] - a[1]) + n[2]*(o[2] - a[2]);
+
+		if (d == 0 || s == 0) return 0;
+
+		/// Crossing from t to the neighbor goes along -sign(s) n
+		return ( (s < 0) == (d > 0) ) ? 1 : -1;
+
+	}
+
+private:
+
+	/// Depth bucket of a centroid Z
+	static unsigned bucketOf(float z, float zMin, float zScale) {
+		unsigned b = (unsigned)( (z - zMin) * zScale );
+		return (b < MPVO_BUCKETS) ? b : MPVO_BUCKETS - 1;
+	}
+
+	/// Push a ready tetrahedron in a bucket
+	void push(natural t, unsigned b) {
+		next[t] = head[b];
+		head[b] = t;
+	}
+
+	vector< unsigned char > front; ///< Faces with the neighbor in front
+	vector< unsigned short > bucket; ///< Depth bucket of each tetrahedron
+	vector< natural > inDeg; ///< Neighbors behind not yet drawn
+	vector< natural > next, head; ///< Bucket lists of ready tetrahedra (nT ends)
+
+	depthSort fallback; ///< Centroid sort of tetrahedra in cycles
+
+	natural numCycleTets; ///< Tetrahedra in cycles (last sort)
+
+};
+
+#endif
@@ -0,0 +1,346 @@
+/**
+ *   OFF (object file format) Parallel Parser
+ *
+ */
+
+/**
+ *   offParser : defines a class to read ASCII OFF volumes in large
+ *               blocks and parse vertex and tetrahedra records in
+ *               parallel using locale-free numeric conversion
+ *
+ * C++ header (with implementation).
+ *
+ */
+
+/// --------------------------------   Definitions   ------------------------------------
+
+#ifndef _OFFPARSER_H_
+#define _OFFPARSER_H_
+
+#include <cstdio>
+
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/// Block size used to read the file (16 MB)
+#define OFF_READ_BLOCK (16 << 20)
+
+/// Number of chunks per thread (load balance between lines of different sizes)
+#define OFF_CHUNKS_PER_THREAD 4
+
+/// --------------------------------   offParser   ------------------------------------
+
+/// OFF Parser Class
+///   Parse files with a header "numVerts numTets" followed by one
+///   record per line: numVerts vertex lines and numTets tetrahedra lines.
+///   Unlike the stream reader (offVol::readOff(ifstream&)), a record
+///   split across lines or sharing a line with another one is an
+///   error: parse returns false (offVol::readOff then falls back to
+///   the stream reader)
+/// @template real number type (float, double, etc.)
+/// @template natural number type (short, unsigned, long, etc.)
+template< class real, class natural >
+class offParser {
+
+public:
+
+	natural numVerts, numTets;
+
+	/// Constructor
+	offParser() : numVerts(0), numTets(0), bodyBegin(0) { }
+
+	/// Size of the file read
+	/// @return size in Bytes
+	size_t size(void) const { return buffer.size(); }
+
+	/// Read the whole file in large blocks and parse the header
+	/// @arg f off file name
+	/// @return true if it succeed
+	bool open(const char* f) {
+
+		FILE *in = fopen(f, "rb");
+		if (!in) return false;
+
+		fseek(in, 0, SEEK_END);
+		long fileSize = ftell(in);
+		fseek(in, 0, SEEK_SET);
+
+		if (fileSize <= 0) { fclose(in); return false; }
+
+		buffer.resize(fileSize);
+
+		/// Reading file blocks
+		for (long pos = 0; pos < fileSize; ) {
+
+			size_t toRead = ( fileSize - pos < OFF_READ_BLOCK ) ? fileSize - pos : OFF_READ_BLOCK;
+			size_t nRead = fread(&buffer[pos], 1, toRead, in);
+
+			if (nRead == 0) { fclose(in); return false; }
+
+			pos += nRead;
+
+		}
+
+		fclose(in);
+
+		/// Parsing header: numVerts numTets
+		const char *p = &buffer[0], *end = p + buffer.size();
+
+		p = parseNatural(p, end, numVerts);
+		if (!p) return false;
+		p = parseNatural(p, end, numTets);
+		if (!p) return false;
+
+		while (p < end && *p != '\n') ++p;
+
+		bodyBegin = p - &buffer[0];
+
+		return true;
+
+	}
+
+	/// Parse vertex and tetrahedra records in parallel
+	///   The first n0 vertex fields go to v0 (stride n0), the next
+	///   n1 fields go to v1 (stride n1); the four vertex ids of each
+	///   tetrahedron go to tets (stride 4)
+	/// @arg v0 first vertex fields output (numVerts * n0)
+	/// @arg n0 number of fields in v0
+	/// @arg v1 second vertex fields output (numVerts * n1)
+	/// @arg n1 number of fields in v1
+	/// @arg tets tetrahedra output (numTets * 4)
+	/// @return true if it succeed
+	template< class T >
+	bool parse(real* v0, int n0, real* v1, int n1, T* tets) {
+
+		if (buffer.empty()) return false;
+
+		const char *base = &buffer[0];
+		size_t bodySize = buffer.size() - bodyBegin;
+
+		/// Split the body in chunks at line boundaries
+		int numThreads = 1;
+#ifdef _OPENMP
+		numThreads = omp_get_max_threads();
+#endif
+		int numChunks = numThreads * OFF_CHUNKS_PER_THREAD;
+
+		std::vector< size_t > chunkBegin(numChunks + 1);
+		std::vector< size_t > chunkRecords(numChunks + 1, 0);
+
+		for (int c = 0; c < numChunks; ++c) {
+
+			size_t pos = bodyBegin + (bodySize * c) / numChunks;
+
+			if (c > 0) {
+				while (pos < buffer.size() && base[pos-1] != '\n') ++pos;
+				if (pos < chunkBegin[c-1]) pos = chunkBegin[c-1];
+			}
+
+			chunkBegin[c] = pos;
+
+		}
+
+		chunkBegin[numChunks] = buffer.size();
+
+		/// Count records (non-blank lines) in each chunk
+#pragma omp parallel for schedule(dynamic, 1)
+		for (int c = 0; c < numChunks; ++c) {
+
+			const char *p = base + chunkBegin[c], *end = base + chunkBegin[c+1];
+
+			while (p < end) {
+
+				const char *eol = nextLine(p, end);
+
+				if (!blankLine(p, eol)) ++chunkRecords[c+1];
+
+				p = eol;
+
+			}
+
+		}
+
+		/// Prefix sum: first record id of each chunk
+		for (int c = 0; c < numChunks; ++c)
+			chunkRecords[c+1] += chunkRecords[c];
+
+		if ( chunkRecords[numChunks] < (size_t)numVerts + (size_t)numTets ) return false;
+
+		/// Result of each chunk (written only by its thread)
+		std::vector< char > chunkOk(numChunks, 1);
+
+		/// Parse records
+#pragma omp parallel for schedule(dynamic, 1)
+		for (int c = 0; c < numChunks; ++c) {
+
+			const char *p = base + chunkBegin[c], *end = base + chunkBegin[c+1];
+			size_t r = chunkRecords[c];
+
+			while (p < end && chunkOk[c]) {
+
+				const char *eol = nextLine(p, end);
+
+				if (blankLine(p, eol)) { p = eol; continue; }
+
+				const char *q = p;
+
+				if (r < numVerts) { /// vertex record
+
+					for (int k = 0; k < n0 && q; ++k)
+						q = parseReal(q, eol, v0[r*n0 + k]);
+
+					for (int k = 0; k < n1 && q; ++k)
+						q = parseReal(q, eol, v1[r*n1 + k]);
+
+				} else if (r < (size_t)numVerts + numTets) { /// tetrahedron record
+
+					size_t t = r - numVerts;
+					natural id = 0;
+
+					for (int k = 0; k < 4 && q; ++k) {
+						q = parseNatural(q, eol, id);
+						tets[t*4 + k] = (T)id;
+					}
+
+				}
+
+				/// One record per line
+				if (q && !blankLine(q, eol)) q = NULL;
+
+				if (!q) chunkOk[c] = 0;
+
+				++r;
+				p = eol;
+
+			}
+
+		}
+
+		for (int c = 0; c < numChunks; ++c)
+			if (!chunkOk[c]) return false;
+
+		return true;
+
+	}
+
+	/// Release the file buffer
+	void close(void) {
+		std::vector< char >().swap(buffer);
+	}
+
+	/// --- Locale-free numeric conversion ---
+
+	/// Parse a natural number
+	/// @arg p current position
+	/// @arg end end of the line/buffer
+	/// @arg v returns the number
+	/// @return position after the number or NULL on error
+	static const char* parseNatural(const char* p, const char* end, natural& v) {
+
+		while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) ++p;
+
+		if (p == end || *p < '0' || *p > '9') return NULL;
+
+		v = 0;
+
+		while (p < end && *p >= '0' && *p <= '9')
+			v = v * 10 + (*p++ - '0');
+
+		return p;
+
+	}
+
+	/// Parse a real number: [sign] digits [. digits] [(e|E) [sign] digits]
+	/// @arg p current position
+	/// @arg end end of the line/buffer
+	/// @arg v returns the number
+	/// @return position after the number or NULL on error
+	static const char* parseReal(const char* p, const char* end, real& v) {
+
+		while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) ++p;
+
+		if (p == end) return NULL;
+
+		bool neg = false;
+
+		if (*p == '-' || *p == '+') neg = (*p++ == '-');
+
+		unsigned long long mantissa = 0;
+		int exponent = 0, digits = 0;
+
+		while (p < end && *p >= '0' && *p <= '9') {
+			if (mantissa < 100000000000000000ULL) mantissa = mantissa * 10 + (*p - '0');
+			else ++exponent;
+			++p; ++digits;
+		}
+
+		if (p < end && *p == '.') {
+			++p;
+			while (p < end && *p >= '0' && *p <= '9') {
+				if (mantissa < 100000000000000000ULL) { mantissa = mantissa * 10 + (*p - '0'); --exponent; }
+				++p; ++digits;
+			}
+		}
+
+		if (digits == 0) return NULL;
+
+		if (p < end && (*p == 'e' || *p == 'E')) {
+			++p;
+			bool negExp = false;
+			if (p < end && (*p == '-' || *p == '+')) negExp = (*p++ == '-');
+			int e = 0;
+			if (p == end || *p < '0' || *p > '9') return NULL;
+			while (p < end && *p >= '0' && *p <= '9') {
+				if (e < 10000) e = e * 10 + (*p - '0');
+				++p;
+			}
+			exponent += (negExp) ? -e : e;
+		}
+
+		double d = (double)mantissa;
+
+		if (exponent < 0) d /= pow10(-exponent);
+		else if (exponent > 0) d *= pow10(exponent);
+
+		v = (real)( (neg) ? -d : d );
+
+		return p;
+
+	}
+
+private:
+
+	/// Power of ten
+	/// @arg e non-negative exponent
+	/// @return 10^e
+	static double pow10(int e) {
+		static const double table[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7,
+						1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15 };
+		double r = 1.0;
+		while (e >= 16) { r *= 1e16; e -= 16; if (r > 1e300) return r; }
+		return r * table[e];
+	}
+
+	/// Next line
+	/// @return position after the end of the current line
+	static const char* nextLine(const char* p, const char* end) {
+		while (p < end && *p != '\n') ++p;
+		return (p < end) ? p + 1 : end;
+	}
+
+	/// Blank or comment line
+	/// @return true if the line has no record
+	static bool blankLine(const char* p, const char* eol) {
+		while (p < eol && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) ++p;
+		return (p == eol || *p == '#');
+	}
+
+	std::vector< char > buffer; ///< Whole file contents
+	size_t bodyBegin; ///< First Byte after the header line
+
+};
+
+#endif
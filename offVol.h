@@ -20,8 +20,26 @@
 
 #include "vec.h" ///< vec template class in lcg toolkit
 
+#include "offParser.h" ///< Parallel OFF parser
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #include <iostream>
 #include <fstream>
+#include <string>
+
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 #include <vector>
 #include <set>
@@ -37,12 +55,67 @@ using std::cout;
 using std::endl;
 using std::flush;
 using std::stable_sort;
+using std::sort;
+using std::unique;
+using std::copy;
 
 /// 4-Module operation using AND operation
 /// @arg x, y numbers to be summed
 /// @return 4-module of the sum: ( x + y ) % 4
 #define MOD4(x,y)           ((x+y)&3)
 
+/// Binary OFF (BOF) file format
+///  [ header | vertices block | tetrahedra block | gradients block (optional) ]
+///  Each block starts at a 64-Byte aligned offset, so the vertex and
+///  tetrahedra lists can be used directly from the memory-mapped file
+#define BOF_MAGIC "BOFV" ///< Magic characters
+#define BOF_VERSION 1 ///< Current format version
+#define BOF_BYTE_ORDER 0x01020304 ///< Byte order mark
+#define BOF_ALIGN 64 ///< Block alignment in Bytes
+
+#define BOF_NORMALIZED 1 ///< Flag: vertices are already normalized
+#define BOF_GRADIENTS 2 ///< Flag: gradients block is present
+#define BOF_REORDERED 4 ///< Flag: vertices and tetrahedra in Morton order
+
+/// BOF Header (64 Bytes)
+typedef struct _bofHeader {
+	char magic[4]; ///< BOF_MAGIC
+	unsigned int version; ///< BOF_VERSION
+	unsigned int byteOrder; ///< BOF_BYTE_ORDER in file endianness
+	unsigned int realSize, naturalSize; ///< sizeof(real) and sizeof(natural)
+	unsigned int flags; ///< BOF_NORMALIZED | BOF_GRADIENTS | BOF_REORDERED
+	unsigned int numVerts, numTets; ///< Number of vertices and tetrahedra
+	unsigned long long vertOffset, tetOffset, gradOffset; ///< Block offsets in Bytes
+	unsigned long long fileSize; ///< Total file size in Bytes
+} bofHeader;
+
+/// Preprocessing cache bundle file format
+///  [ header | connectivity | external faces | incidence (optional) ]
+///  The bundle is keyed by a hash of the mesh (vertices and tetrahedra)
+///  and the preprocessing options, so it is only used for the exact
+///  mesh it was built from
+#define CACHE_MAGIC "PTCB" ///< Magic characters
+#define CACHE_VERSION 1 ///< Current format version
+
+#define CACHE_NORMALIZED 1 ///< Option: vertices normalized before building
+#define CACHE_MORTON 2 ///< Option: mesh reordered along the Morton curve
+
+/// Cache Header (96 Bytes)
+typedef struct _cacheHeader {
+	char magic[4]; ///< CACHE_MAGIC
+	unsigned int version; ///< CACHE_VERSION
+	unsigned int byteOrder; ///< BOF_BYTE_ORDER in file endianness
+	unsigned int realSize, naturalSize; ///< sizeof(real) and sizeof(natural)
+	unsigned int options; ///< Preprocessing options (CACHE_NORMALIZED, ...)
+	unsigned int numVerts, numTets, numExtFaces; ///< Mesh and external faces sizes
+	unsigned int numIncidTets, numIncidVerts; ///< Incidence sizes (0 if not cached)
+	unsigned int pad; ///< Alignment
+	unsigned long long meshHash; ///< Hash of vertices and tetrahedra
+	unsigned long long payloadHash; ///< Hash of everything after the header
+	unsigned long long payloadSize; ///< Size of everything after the header
+	unsigned long long reserved[3]; ///< Future use
+} cacheHeader;
+
 /// ----------------------------------   offVol   ------------------------------------
 
 /// OFF Volume Class
@@ -61,21 +134,20 @@ public:
 	typedef vec< 3, real > vec3;
 	typedef vec< 4, real > vec4;
 
-	/// Incident in vertex: tetrahedra and vertices
+	/// Incident in vertex: tetrahedra and vertices (compressed rows)
+	///   Tetrahedra incident in vertex i: tetId[ tetOffset[i] .. tetOffset[i+1] ) (sorted)
+	///   Vertices incident in vertex i: vertId[ vertOffset[i] .. vertOffset[i+1] ) (sorted)
 	typedef struct _incident {
-		vector < natural > tetId;
-		set < natural, less<natural> > vertId;
+		natural *tetOffset, *tetId;
+		natural *vertOffset, *vertId;
 	} incident;
 
-	/// Set iterator type to iterate through a set of vertices
-	typedef typename set< unsigned, less<unsigned> >::const_iterator setIt;
-
 	natural numVerts, numTets, numExtFaces;
 
 	vec4 *vertList;
 	ivec4 *tetList;
 
-	incident *incidVert;
+	incident incidVert;
 
 	ivec4 *conTet;
 
@@ -87,21 +159,31 @@ public:
 
 	ivec2 *extFaces;
 
+	vec3 *gradList; ///< Vertex gradients (only from BOF files)
+
+	bool normalized; ///< Vertices already normalized
+
+	bool reordered; ///< Vertices and tetrahedra already in Morton order
+
+	char *mappedData; ///< Memory-mapped BOF file (owns vertList/tetList/gradList)
+	size_t mappedSize; ///< Memory-mapped size in Bytes
+
 	/// Constructor -- instantiate zero-volume
 	offVol() : numVerts(0), numTets(0),
 		numExtFaces(0), vertList(NULL),
-		tetList(NULL), incidVert(NULL),
+		tetList(NULL), incidVert(),
 		conTet(NULL), tf(NULL),
 		numColors(256), maxEdgeLength(0),
 		maxZ(0), minZ(0),
-		extFaces(NULL) { }
+		extFaces(NULL), gradList(NULL),
+		normalized(false), reordered(false), mappedData(NULL),
+		mappedSize(0) { }
 
 	/// Destructor -- clean up memory
 	~offVol() {
 
-		if (vertList) delete [] vertList;
-		if (tetList) delete [] tetList;
-		if (incidVert) delete [] incidVert;
+		deleteMesh();
+		deleteIncid();
 		if (conTet) delete [] conTet;
 		if (tf) delete [] tf;
 		if (extFaces) delete [] extFaces;
@@ -114,15 +196,48 @@ public:
 		return ( ( (vertList) ? numVerts * sizeof(vec4) : 0 ) + ///< Vertices list
 			 ( (tetList) ? numTets * sizeof(ivec4) : 0 ) + ///< Tetrahedra list
 			 ( (extFaces) ? numExtFaces * sizeof(ivec2) : 0 ) + ///< External Faces
-			 ( (incidVert) ? numVerts * sizeof(incident) : 0 ) + ///< Incident
+			 ( (incidVert.tetOffset) ? ( 2 * ( numVerts + 1 ) + numIncidTets() + numIncidVerts() ) * sizeof(natural) : 0 ) + ///< Incident
 			 ( (conTet) ? numTets * sizeof(ivec4) : 0 ) + ///< Connectivity
 			 ( (tf) ? numColors * sizeof(vec4) : 0 ) + ///< Transfer Function
+			 ( (gradList) ? numVerts * sizeof(vec3) : 0 ) + ///< Gradients
 			 ( 3 * sizeof(natural) ) + ///< numVerts, numTets and numExtFaces
-			 ( 6 * sizeof(int) ) + ///< pointers
+			 ( 11 * sizeof(int) ) + ///< pointers
 			 ( 3 * sizeof(real) ) ///< maxEdgeLength, maxZ and minZ
 			);
 	}
 
+	/// Delete mesh (vertices, tetrahedra and gradients)
+	///   Unmap the BOF file if the mesh lives inside it
+	void deleteMesh(void) {
+
+		if (mappedData) {
+
+#ifndef _WIN32
+			munmap(mappedData, mappedSize);
+#else
+			delete [] mappedData;
+#endif
+
+		} else {
+
+			if (vertList) delete [] vertList;
+			if (tetList) delete [] tetList;
+			if (gradList) delete [] gradList;
+
+		}
+
+		mappedData = NULL;
+		mappedSize = 0;
+
+		vertList = NULL;
+		tetList = NULL;
+		gradList = NULL;
+
+		normalized = false;
+		reordered = false;
+
+	}
+
 	/// --- OFF ---
 
 	/// Read OFF (object file format)
@@ -133,11 +248,11 @@ public:
 		in >> numVerts >> numTets;
 
 		/// Allocating memory for vertices and tetrahedra data
-		if (vertList) delete [] vertList;
+		deleteMesh();
+
 		vertList = new vec4[ numVerts ];
 		if (!vertList) return false;
 
-		if (tetList) delete [] tetList;
 		tetList = new ivec4[ numTets ];
 		if (!tetList) return false;
 
@@ -160,45 +275,286 @@ public:
 	}
 
 	/// Read OFF (overload)
+	///   The file is read in large blocks and its records are parsed
+	///   in parallel (see offParser).  Files the parser rejects (not
+	///   one record per line) are read again by the stream reader
 	/// @arg f off file name
 	/// @return true if it succeed
 	bool readOff(const char* f) {
 
+		offParser< real, natural > parser;
+
+		if (!parser.open(f)) return false;
+
+		numVerts = parser.numVerts;
+		numTets = parser.numTets;
+
+		/// Allocating memory for vertices and tetrahedra data
+		deleteMesh();
+
+		vertList = new vec4[ numVerts ];
+		if (!vertList) return false;
+
+		tetList = new ivec4[ numTets ];
+		if (!tetList) return false;
+
+		/// Parsing vertices (x, y, z, s) and tetrahedra (v0, v1, v2, v3)
+		if ( parser.parse( (real*)vertList, 4, (real*)NULL, 0, (natural*)tetList ) ) return true;
+
+		parser.close();
+
 		ifstream in(f);
+
 		return readOff(in);
 
 	}
 
-	/// Normalize vertices coordinates
-	void normalizeVertices(void) {
+	/// --- BOF ---
 
-		natural i, j;
-		real scaleCoord, scaleScalar, maxCoord, value;
-		vec3 center;
-		vec4 min, max;
+	/// Read BOF (binary object file format)
+	///   The file is memory-mapped (private copy-on-write) and the
+	///   vertex, tetrahedra and gradient lists point straight into it
+	/// @arg f bof file name
+	/// @return true if it succeed
+	bool readBin(const char* f) {
+
+		deleteMesh();
+
+		bofHeader h;
+		char *data = NULL;
+		size_t size = 0;
+
+#ifndef _WIN32
+
+		int fd = open(f, O_RDONLY);
+		if (fd < 0) return false;
+
+		struct stat st;
+		if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(bofHeader)) {
+			close(fd);
+			return false;
+		}
+
+		size = st.st_size;
+
+		void *addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (addr == MAP_FAILED) return false;
+
+		data = (char*)addr;
+
+#else
+
+		ifstream in(f, std::ios::binary);
+		if (in.fail()) return false;
+
+		in.seekg(0, std::ios::end);
+		size = in.tellg();
+		in.seekg(0, std::ios::beg);
+		if (size < sizeof(bofHeader)) return false;
+
+		data = new char[ size ];
+		if (!data) return false;
+
+		in.read(data, size);
+		if (in.fail()) { delete [] data; return false; }
+
+#endif
+
+		mappedData = data;
+		mappedSize = size;
+
+		memcpy(&h, data, sizeof(bofHeader));
+
+		/// Validate header against this volume types and file size
+		if ( strncmp(h.magic, BOF_MAGIC, 4) != 0 || h.version != BOF_VERSION ||
+		     h.byteOrder != BOF_BYTE_ORDER || h.realSize != sizeof(real) ||
+		     h.naturalSize != sizeof(natural) || h.fileSize != size ||
+		     h.vertOffset + h.numVerts * sizeof(vec4) > size ||
+		     h.tetOffset + h.numTets * sizeof(ivec4) > size ||
+		     ( (h.flags & BOF_GRADIENTS) && h.gradOffset + h.numVerts * sizeof(vec3) > size ) ) {
+
+			deleteMesh();
+			return false;
+
+		}
+
+		numVerts = h.numVerts;
+		numTets = h.numTets;
+
+		vertList = (vec4*)(data + h.vertOffset);
+		tetList = (ivec4*)(data + h.tetOffset);
+
+		if (h.flags & BOF_GRADIENTS)
+			gradList = (vec3*)(data + h.gradOffset);
+
+		normalized = ( (h.flags & BOF_NORMALIZED) != 0 );
+		reordered = ( (h.flags & BOF_REORDERED) != 0 );
+
+		return true;
+
+	}
+
+	/// Write BOF (binary object file format)
+	///   Convert the current mesh to BOF, writing to a temporary file
+	///   that is renamed at the end (readers never see a partial file)
+	/// @arg f bof file name
+	/// @return true if it succeed
+	bool writeBin(const char* f) {
+
+		if (!vertList || !tetList) return false;
+
+		bofHeader h;
+		memset(&h, 0, sizeof(bofHeader));
+
+		memcpy(h.magic, BOF_MAGIC, 4);
+		h.version = BOF_VERSION;
+		h.byteOrder = BOF_BYTE_ORDER;
+		h.realSize = sizeof(real);
+		h.naturalSize = sizeof(natural);
+		h.flags = ( (normalized) ? BOF_NORMALIZED : 0 ) | ( (gradList) ? BOF_GRADIENTS : 0 ) |
+			( (reordered) ? BOF_REORDERED : 0 );
+		h.numVerts = numVerts;
+		h.numTets = numTets;
+
+		h.vertOffset = alignBin( sizeof(bofHeader) );
+		h.tetOffset = alignBin( h.vertOffset + numVerts * sizeof(vec4) );
+		h.gradOffset = (gradList) ? alignBin( h.tetOffset + numTets * sizeof(ivec4) ) : 0;
+		h.fileSize = (gradList) ? h.gradOffset + numVerts * sizeof(vec3) :
+			h.tetOffset + numTets * sizeof(ivec4);
+
+		std::string tmp = std::string(f) + ".tmp";
+
+		ofstream out(tmp.c_str(), std::ios::binary);
+		if (out.fail()) return false;
+
+		out.write((const char*)&h, sizeof(bofHeader));
+
+		writeBinBlock(out, h.vertOffset, (const char*)vertList, numVerts * sizeof(vec4));
+		writeBinBlock(out, h.tetOffset, (const char*)tetList, numTets * sizeof(ivec4));
+
+		if (gradList)
+			writeBinBlock(out, h.gradOffset, (const char*)gradList, numVerts * sizeof(vec3));
+
+		out.close();
+
+		if (out.fail()) { remove(tmp.c_str()); return false; }
+
+		if (rename(tmp.c_str(), f) != 0) { remove(tmp.c_str()); return false; }
+
+		return true;
+
+	}
+
+	/// Find the volume bounds in one parallel pass
+	///   Each thread keeps partial limits (merged at the end); the
+	///   vertex loop works on the x, y, z, s components together and
+	///   the edge loop compares squared lengths
+	/// @arg min returns minimum ( x, y, z, s )
+	/// @arg max returns maximum ( x, y, z, s )
+	/// @arg maxEdge returns maximum edge length (if edges is true)
+	/// @arg edges also find the maximum edge length (pass over tetrahedra)
+	void findBounds(vec4& min, vec4& max, real& maxEdge, bool edges = true) const {
 
 		min = vertList[0];
 		max = vertList[0];
 
-		/// Find out the min/max points
-		for(i = 1; i < numVerts; i++) {
-			for(j = 0; j < 4; j++) { // x, y, z, s
-				value = vertList[i][j];
-				if (value < min[j])
-					min[j] = value;
-				if (value > max[j])
-					max[j] = value;
+		real maxEdge2 = 0;
+
+		maxEdge = 0;
+
+#pragma omp parallel
+		{
+
+			real tmin[4], tmax[4], tmaxEdge2 = 0;
+
+			for (natural j = 0; j < 4; ++j) {
+				tmin[j] = min[j];
+				tmax[j] = max[j];
+			}
+
+			/// Bounding box and scalar range
+#pragma omp for nowait
+			for (long i = 1; i < (long)numVerts; ++i) {
+
+				const real *v = (const real*)&vertList[i];
+
+				for (natural j = 0; j < 4; ++j) { // x, y, z, s
+					tmin[j] = (v[j] < tmin[j]) ? v[j] : tmin[j];
+					tmax[j] = (v[j] > tmax[j]) ? v[j] : tmax[j];
+				}
+
+			}
+
+			/// Maximum (squared) edge length
+			if (edges) {
+
+#pragma omp for nowait
+				for (long i = 0; i < (long)numTets; ++i) {
+
+					const real *v[4];
+
+					for (natural k = 0; k < 4; ++k)
+						v[k] = (const real*)&vertList[ tetList[i][k] ];
+
+					for (natural a = 0; a < 3; ++a) {
+						for (natural b = a + 1; b < 4; ++b) {
+
+							real dx = v[a][0] - v[b][0], dy = v[a][1] - v[b][1], dz = v[a][2] - v[b][2];
+							real len2 = dx*dx + dy*dy + dz*dz;
+
+							tmaxEdge2 = (len2 > tmaxEdge2) ? len2 : tmaxEdge2;
+
+						}
+					}
+
+				}
+
+			}
+
+#pragma omp critical
+			{
+				for (natural j = 0; j < 4; ++j) {
+					if (tmin[j] < min[j]) min[j] = tmin[j];
+					if (tmax[j] > max[j]) max[j] = tmax[j];
+				}
+				if (tmaxEdge2 > maxEdge2) maxEdge2 = tmaxEdge2;
 			}
+
+		}
+
+		maxEdge = sqrt(maxEdge2);
+
+	}
+
+	/// Normalize vertices coordinates
+	///   The limits (maxEdgeLength, maxZ and minZ) of the normalized
+	///   volume follow from the bounds found before normalizing, so
+	///   they can be computed in the same pass
+	/// @arg withLimits also compute the volume limits
+	void normalizeVertices(bool withLimits = false) {
+
+		if (normalized) {
+			if (withLimits) findLimits();
+			return;
 		}
 
+		long i;
+		real scaleCoord, scaleScalar, maxCoord, maxEdge;
+		vec3 center;
+		vec4 min, max;
+
+		/// Find out the min/max points
+		findBounds(min, max, maxEdge, withLimits);
+
 		/// Compute the center point
-		for(i = 0; i < 3; ++i) { // x, y, z
+		for(natural j = 0; j < 3; ++j) { // x, y, z
 
-			center[i] = (min[i] + max[i]) / 2.0;
+			center[j] = (min[j] + max[j]) / 2.0;
 
 			/// Center volume in origin
-			max[i] -= center[i];
-			min[i] -= center[i];
+			max[j] -= center[j];
+			min[j] -= center[j];
 
 		}
 
@@ -209,41 +565,223 @@ public:
 		scaleScalar = 1.0 / (max[3] - min[3]);
 
 		/// Update vertex list
-		for(i = 0; i < numVerts; ++i) {
+#pragma omp parallel for
+		for(i = 0; i < (long)numVerts; ++i) {
+
+			real *v = (real*)&vertList[i];
+
+			for (natural j = 0; j < 3; ++j) // x, y, z
+				v[j] = (v[j] - center[j]) * scaleCoord;
 
-			for (j = 0; j < 3; ++j) { // x, y, z
+			v[3] = (v[3] - min[3]) * scaleScalar;
 
-				vertList[i][j] = (vertList[i][j] - center[j]) * scaleCoord;
+		}
+
+		/// Limits of the normalized volume
+		if (withLimits) {
+
+			maxEdgeLength = maxEdge * scaleCoord;
+			maxZ = max[2] * scaleCoord;
+			minZ = min[2] * scaleCoord;
+
+		}
+
+		normalized = true;
+
+	}
+
+	/// --- Reordering ---
+
+	/// Mean vertex fetch stride: distance (in vertices) between
+	/// consecutive vertex fetches walking the tetrahedra list, a proxy
+	/// for the cache misses of the vertex gathers
+	/// @return mean stride
+	double fetchStride(void) const {
+
+		if (!tetList || numTets == 0) return 0.0;
+
+		double sum = 0.0;
+		long i;
+
+#pragma omp parallel for reduction(+:sum)
+		for (i = 0; i < (long)numTets; ++i) {
+
+			natural prev = (i > 0) ? tetList[i-1][3] : tetList[i][0];
+
+			for (natural k = 0; k < 4; ++k) {
+
+				natural v = tetList[i][k];
+				sum += (v > prev) ? v - prev : prev - v;
+				prev = v;
 
 			}
 
-			vertList[i][3] = (vertList[i][3] - min[3]) * scaleScalar;
+		}
+
+		return sum / ( 4.0 * numTets );
+
+	}
+
+	/// Reorder vertices and tetrahedra along the Morton (Z-order)
+	/// curve of vertex positions and tetrahedra centroids
+	///   tetList, conTet, extFaces and gradList are remapped
+	///   consistently; the arrays are rewritten in place (so it also
+	///   works on a memory-mapped BOF)
+	/// @return true if it succeed
+	bool reorderMorton(void) {
+
+		if (!vertList || !tetList) return false;
+
+		if (reordered) return true;
+
+		long i;
 
+		/// Bounding box of vertex positions
+		vec3 min = vertList[0].xyz(), max = vertList[0].xyz();
+
+		for (i = 1; i < (long)numVerts; ++i) {
+			for (natural j = 0; j < 3; ++j) {
+				if (vertList[i][j] < min[j]) min[j] = vertList[i][j];
+				if (vertList[i][j] > max[j]) max[j] = vertList[i][j];
+			}
 		}
 
+		vec3 scale;
+
+		for (natural j = 0; j < 3; ++j)
+			scale[j] = (max[j] > min[j]) ? MORTON_MAX / (max[j] - min[j]) : 0;
+
+		/// Sorting vertices by Morton code
+		vector< mortonKey > keys( numVerts );
+
+#pragma omp parallel for
+		for (i = 0; i < (long)numVerts; ++i) {
+			keys[i].first = mortonCode( vertList[i].xyz(), min, scale );
+			keys[i].second = i;
+		}
+
+		sort( keys.begin(), keys.end() );
+
+		vector< natural > newVert( numVerts );
+
+#pragma omp parallel for
+		for (i = 0; i < (long)numVerts; ++i)
+			newVert[ keys[i].second ] = i;
+
+		/// Sorting tetrahedra by Morton code of centroids
+		keys.resize( numTets );
+
+#pragma omp parallel for
+		for (i = 0; i < (long)numTets; ++i) {
+			vec3 c = ( vertList[ tetList[i][0] ].xyz() + vertList[ tetList[i][1] ].xyz() +
+				   vertList[ tetList[i][2] ].xyz() + vertList[ tetList[i][3] ].xyz() ) * (real)0.25;
+			keys[i].first = mortonCode( c, min, scale );
+			keys[i].second = i;
+		}
+
+		sort( keys.begin(), keys.end() );
+
+		vector< natural > newTet( numTets );
+
+#pragma omp parallel for
+		for (i = 0; i < (long)numTets; ++i)
+			newTet[ keys[i].second ] = i;
+
+		/// Permuting vertices (and gradients)
+		{
+			vector< vec4 > v( vertList, vertList + numVerts );
+
+#pragma omp parallel for
+			for (i = 0; i < (long)numVerts; ++i)
+				vertList[ newVert[i] ] = v[i];
+		}
+
+		if (gradList) {
+
+			vector< vec3 > g( gradList, gradList + numVerts );
+
+#pragma omp parallel for
+			for (i = 0; i < (long)numVerts; ++i)
+				gradList[ newVert[i] ] = g[i];
+
+		}
+
+		/// Permuting tetrahedra and renaming their vertices
+		{
+			vector< ivec4 > t( tetList, tetList + numTets );
+
+#pragma omp parallel for
+			for (i = 0; i < (long)numTets; ++i)
+				for (natural k = 0; k < 4; ++k)
+					tetList[ newTet[i] ][k] = newVert[ t[i][k] ];
+		}
+
+		/// Permuting connectivity and renaming neighbors
+		if (conTet) {
+
+			vector< ivec4 > c( conTet, conTet + numTets );
+
+#pragma omp parallel for
+			for (i = 0; i < (long)numTets; ++i)
+				for (natural f = 0; f < 4; ++f)
+					conTet[ newTet[i] ][f] = newTet[ c[i][f] ];
+
+		}
+
+		/// Renaming external faces (kept in tetrahedra order)
+		if (extFaces) {
+
+			vector< std::pair< natural, natural > > e( numExtFaces );
+
+			for (i = 0; i < (long)numExtFaces; ++i)
+				e[i] = std::make_pair( newTet[ extFaces[i][0] ], extFaces[i][1] );
+
+			sort( e.begin(), e.end() );
+
+			for (i = 0; i < (long)numExtFaces; ++i) {
+				extFaces[i][0] = e[i].first;
+				extFaces[i][1] = e[i].second;
+			}
+
+		}
+
+		/// The incidence refers to old ids
+		deleteIncid();
+
+		reordered = true;
+
+		return true;
+
 	}
 
 	/// --- Incid ---
 
+	/// Number of incident tetrahedra entries
+	/// @return size of incidVert.tetId
+	natural numIncidTets(void) const { return (incidVert.tetOffset) ? incidVert.tetOffset[numVerts] : 0; }
+
+	/// Number of incident vertices entries
+	/// @return size of incidVert.vertId
+	natural numIncidVerts(void) const { return (incidVert.vertOffset) ? incidVert.vertOffset[numVerts] : 0; }
+
 	/// Read Con (incidents in vertex)
 	/// @arg in input file stream
 	bool readIncid(ifstream& in) {
 
 		if (in.fail()) return false;
 
-		natural i, j, numIncidVerts, tetIdSize, vertIdSize, tetId, vertId;
+		natural i, j, numIncidVerts, tetIdSize, vertIdSize;
 
 		in >> numIncidVerts;
 
 		if (numIncidVerts != numVerts) return false;
 
-		/// Allocating memory for incidents in vertex data
+		/// Reading indents in vertex information in growing rows
 
-		if (incidVert) delete [] incidVert;
-		incidVert = new incident[ numVerts ];
-		if (!incidVert) return false;
+		vector< natural > tetOffset(1, 0), tetId, vertOffset(1, 0), vertId;
 
-		/// Reading indents in vertex information
+		tetOffset.reserve( numVerts + 1 );
+		vertOffset.reserve( numVerts + 1 );
 
 		for(i = 0; i < numVerts; i++) {
 
@@ -251,30 +789,42 @@ public:
 
 			for (j = 0; j < tetIdSize; j++) {
 
-				in >> tetId;
-
-				incidVert[i].tetId.push_back( tetId );
+				tetId.push_back( 0 );
+				in >> tetId.back();
 
 				if (in.fail()) return false;
 
 			}
 
+			tetOffset.push_back( tetId.size() );
+
 			in >> vertIdSize;
 
 			for (j = 0; j < vertIdSize; j++) {
 
-				in >> vertId;
-
-				incidVert[i].vertId.insert( vertId );
+				vertId.push_back( 0 );
+				in >> vertId.back();
 
 				if (in.fail()) return false;
 
 			}
 
+			vertOffset.push_back( vertId.size() );
+
 		}
 
 		in.close();
 
+		/// Allocating memory for incidents in vertex data
+		deleteIncid();
+
+		if ( !allocIncid( tetId.size(), vertId.size() ) ) return false;
+
+		copy( tetOffset.begin(), tetOffset.end(), incidVert.tetOffset );
+		copy( tetId.begin(), tetId.end(), incidVert.tetId );
+		copy( vertOffset.begin(), vertOffset.end(), incidVert.vertOffset );
+		copy( vertId.begin(), vertId.end(), incidVert.vertId );
+
 		return true;
 
 	}
@@ -290,53 +840,127 @@ public:
 
 	}
 
-	/// Build incidTet array
+	/// Build incidVert arrays
+	///   Counting sort of the 4 * numTets (vertex, tetrahedron) pairs
+	///   by vertex id, followed by the sorted and unique neighbors of
+	///   each vertex; both passes are linear and run in parallel.
+	///   Vertices not referenced by any tetrahedron get empty rows
 	/// @return true if it succeed
 	bool buildIncid(void) {
 
-		natural i, j, k;
-
-		incidVert = new incident[ numVerts ];
-		if (!incidVert) return false;
-    
 		if (!tetList) return false;
 
-		for (i = 0; i < numVerts; ++i) { /// for each vertex
-            
-			incidVert[i].tetId.clear();
+		deleteIncid();
+
+		/// Counting incident tetrahedra per vertex
+		natural *count = new natural[ numVerts + 1 ];
+		if (!count) return false;
+
+		memset(count, 0, ( numVerts + 1 ) * sizeof(natural));
 
-			incidVert[i].vertId.clear();
+		long i;
 
-			for (j = 0; j < numTets; ++j) {
-               
-				for (k = 0; k < 4; ++k) {
+#pragma omp parallel for
+		for (i = 0; i < (long)numTets; ++i) {
 
-					/// if tetrahedron j contains the vertex i
-					if (i == tetList[j][k]) {
+			for (natural k = 0; k < 4; ++k) {
 
-						/// tetrahedron j is incident on vertex i
-						incidVert[i].tetId.push_back( j );
+				natural v = tetList[i][k];
 
-						/// other three vertices are incident on vertex i
-						incidVert[i].vertId.insert( tetList[j][MOD4(1, k)] );
-						incidVert[i].vertId.insert( tetList[j][MOD4(2, k)] );
-						incidVert[i].vertId.insert( tetList[j][MOD4(3, k)] );
+				if (v >= numVerts) continue; ///< anomaly: checked below
 
-						break;
+#pragma omp atomic
+				count[v]++;
 
-					} // if
+			}
+
+		}
+
+		/// Prefix sum: first entry of each vertex row
+		natural sum = 0;
+
+		for (i = 0; i < (long)numVerts; ++i) {
+
+			natural c = count[i];
+			count[i] = sum;
+			sum += c;
+
+		}
+
+		count[numVerts] = sum;
+
+		if ( sum != 4 * numTets || !allocIncid( sum, 0 ) ) { delete [] count; deleteIncid(); return false; }
+
+		copy( count, count + numVerts + 1, incidVert.tetOffset );
+
+		/// Scattering tetrahedra in vertex rows
+#pragma omp parallel for
+		for (i = 0; i < (long)numTets; ++i) {
+
+			for (natural k = 0; k < 4; ++k) {
+
+				natural v = tetList[i][k], pos;
+
+#pragma omp atomic capture
+				pos = count[v]++;
+
+				incidVert.tetId[pos] = i;
+
+			}
+
+		}
+
+		delete [] count;
+
+		/// Sorting each row (scattering order is not deterministic)
+		/// and counting unique neighbor vertices
+		natural *neighbors = new natural[ 3 * incidVert.tetOffset[numVerts] ];
+		if (!neighbors) { deleteIncid(); return false; }
+
+		incidVert.vertOffset[0] = 0;
+
+#pragma omp parallel for schedule(dynamic, 1024)
+		for (i = 0; i < (long)numVerts; ++i) {
+
+			natural begin = incidVert.tetOffset[i], end = incidVert.tetOffset[i+1];
+
+			sort( incidVert.tetId + begin, incidVert.tetId + end );
+
+			natural *row = neighbors + 3 * begin, n = 0;
+
+			for (natural j = begin; j < end; ++j) {
 
-				} // k
+				const ivec4& t = tetList[ incidVert.tetId[j] ];
 
-			} // j
+				for (natural k = 0; k < 4; ++k)
+					if (t[k] != (natural)i) row[n++] = t[k];
 
-			if ( incidVert[i].tetId.empty() ) {
+			}
+
+			sort( row, row + n );
+
+			incidVert.vertOffset[i+1] = unique( row, row + n ) - row;
+
+		}
+
+		for (i = 0; i < (long)numVerts; ++i)
+			incidVert.vertOffset[i+1] += incidVert.vertOffset[i];
+
+		/// Compacting neighbor rows
+		incidVert.vertId = new natural[ incidVert.vertOffset[numVerts] ];
+		if (!incidVert.vertId) { delete [] neighbors; deleteIncid(); return false; }
 
-				return false; ///< some anomaly happens
+#pragma omp parallel for schedule(dynamic, 1024)
+		for (i = 0; i < (long)numVerts; ++i) {
 
-			} // if
+			const natural *row = neighbors + 3 * incidVert.tetOffset[i];
 
-		} // i
+			copy( row, row + ( incidVert.vertOffset[i+1] - incidVert.vertOffset[i] ),
+			      incidVert.vertId + incidVert.vertOffset[i] );
+
+		}
+
+		delete [] neighbors;
 
 		return true;
 
@@ -348,7 +972,7 @@ public:
 
 		if (out.fail()) return false;
 
-		if (!incidVert) return false;
+		if (!incidVert.tetOffset) return false;
 
 		natural i, j;
 
@@ -360,39 +984,21 @@ public:
 
 		for(i = 0; i < numVerts; i++) {
 
-			out << incidVert[i].tetId.size() << " ";
-
-			for (j = 0; j < incidVert[i].tetId.size(); j++) {
-
-				out << incidVert[i].tetId[j];
-
-				if ( j < (incidVert[i].tetId.size()-1) )
-					out << " ";
-				else
-					out << endl;
-
-				if (out.fail()) return false;
+			out << incidVert.tetOffset[i+1] - incidVert.tetOffset[i];
 
-			}
-
-			out << incidVert[i].vertId.size() << " ";
-
-			j = 0;
-
-			for (setIt it = incidVert[i].vertId.begin(); it != incidVert[i].vertId.end(); it++) {
+			for (j = incidVert.tetOffset[i]; j < incidVert.tetOffset[i+1]; j++)
+				out << " " << incidVert.tetId[j];
 
-				out << (*it);
+			out << endl;
 
-				if ( j < (incidVert[i].vertId.size()-1) )
-					out << " ";
-				else
-					out << endl;
+			out << incidVert.vertOffset[i+1] - incidVert.vertOffset[i];
 
-				if (out.fail()) return false;
+			for (j = incidVert.vertOffset[i]; j < incidVert.vertOffset[i+1]; j++)
+				out << " " << incidVert.vertId[j];
 
-				j++;
+			out << endl;
 
-			}
+			if (out.fail()) return false;
 
 		}
 
@@ -413,24 +1019,20 @@ public:
 
 	}
 
-	/// Delete incidTet array
+	/// Delete incidVert arrays
 	/// @return true if it succeed
 	bool deleteIncid(void) {
 
-		if (!incidVert)
+		if (!incidVert.tetOffset)
 			return false;
 
-		for (natural i = 0; i < numVerts; ++i) {
-
-			incidVert[i].tetId.clear();
-			incidVert[i].vertId.clear();
+		if (incidVert.tetOffset) delete [] incidVert.tetOffset;
+		if (incidVert.tetId) delete [] incidVert.tetId;
+		if (incidVert.vertOffset) delete [] incidVert.vertOffset;
+		if (incidVert.vertId) delete [] incidVert.vertId;
 
-		}
-
-		if (incidVert)
-			delete [] incidVert;
-
-		incidVert = NULL;
+		incidVert.tetOffset = incidVert.tetId = NULL;
+		incidVert.vertOffset = incidVert.vertId = NULL;
 
 		return true;
 
@@ -486,82 +1088,196 @@ public:
 
 	}
 
-	/// Build tetrahedra connectivity
+	/// Build tetrahedra connectivity and external faces
+	///   The 4 * numTets faces are bucketed by their smallest vertex id
+	///   (counting sort), then each bucket is sorted by the two other
+	///   vertex ids so that the faces shared by two tetrahedra become
+	///   adjacent; faces left alone are external faces.  All passes
+	///   run in parallel and the incidence is not needed
 	/// @return true if it succeed
 	bool buildCon(void) {
 
-		natural i, j, k, l, f, currTetId;
-
-		numExtFaces = 0;
-
-		natural currVId[3];
-
-		if (!incidVert) return false;
+		if (!tetList) return false;
 
 		if (conTet) delete [] conTet;
 		conTet = new ivec4[ numTets ];
 		if (!conTet) return false;
 
-		for (i = 0; i < numTets; i++) { /// for each tet
+		natural *faceOffset = new natural[ numVerts + 1 ];
+		if (!faceOffset) { delete [] conTet; conTet = NULL; return false; }
 
-			for (f = 0; f < 4; f++) { /// for each face
+		memset(faceOffset, 0, ( numVerts + 1 ) * sizeof(natural));
 
-				for (k = 0; k < 3; k++) { // for each vertex of current face
+		long i;
 
-					currVId[k] = tetList[i][ MOD4(k, f) ];
+		/// Counting faces per smallest vertex id
+#pragma omp parallel for
+		for (i = 0; i < (long)numTets; ++i) {
+
+			for (natural f = 0; f < 4; ++f) {
+
+				natural v[3];
+
+				faceVertices(i, f, v);
+
+				if (v[2] >= numVerts) continue; ///< anomaly: checked below
+
+#pragma omp atomic
+				faceOffset[ v[0] ]++;
+
+			}
+
+		}
+
+		/// Prefix sum: first face of each bucket
+		natural sum = 0;
+
+		for (i = 0; i < (long)numVerts; ++i) {
+
+			natural c = faceOffset[i];
+			faceOffset[i] = sum;
+			sum += c;
+
+		}
+
+		faceOffset[numVerts] = sum;
+
+		/// Faces with a vertex id out of range were not counted
+		if (sum != 4 * numTets) { delete [] faceOffset; delete [] conTet; conTet = NULL; return false; }
+
+		/// Scattering face codes ( 4 * tetId + face ) in buckets
+		natural *faceCode = new natural[ sum ];
+		natural *cursor = new natural[ numVerts ];
+		if (!faceCode || !cursor) { delete [] faceOffset; delete [] conTet; conTet = NULL; return false; }
+
+		copy( faceOffset, faceOffset + numVerts, cursor );
+
+#pragma omp parallel for
+		for (i = 0; i < (long)numTets; ++i) {
+
+			for (natural f = 0; f < 4; ++f) {
+
+				natural v = minFaceVertex(i, f), pos;
+
+#pragma omp atomic capture
+				pos = cursor[v]++;
+
+				faceCode[pos] = 4 * i + f;
+
+			}
+
+		}
+
+		delete [] cursor;
+
+		/// Matching faces inside each bucket
+#pragma omp parallel
+		{
+
+			vector< faceKey > bucket;
+
+#pragma omp for schedule(dynamic, 1024)
+			for (i = 0; i < (long)numVerts; ++i) {
+
+				natural begin = faceOffset[i], end = faceOffset[i+1];
+
+				if (begin == end) continue;
+
+				bucket.resize( end - begin );
+
+				for (natural j = begin; j < end; ++j) {
+
+					faceKey& k = bucket[j - begin];
+					natural t = faceCode[j] >> 2, f = faceCode[j] & 3;
+
+					k.code = faceCode[j];
+					faceVertices(t, f, k.v);
 
 				}
 
-				conTet[i][f] = i; /// sets all face as external face
+				/// Sorting by (middle, largest) vertex ids, then by code
+				sort( bucket.begin(), bucket.end() );
 
-				for (j = 0; j < incidVert[ currVId[0] ].tetId.size(); j++) {
+				for (natural j = 0; j < bucket.size(); ) {
 
-					currTetId = incidVert[ currVId[0] ].tetId[j];
+					natural e = j + 1;
 
-					if (i != currTetId) {
+					while (e < bucket.size() && bucket[e].v[1] == bucket[j].v[1] &&
+					       bucket[e].v[2] == bucket[j].v[2]) ++e;
 
-						for (k = 0; k < incidVert[ currVId[1] ].tetId.size(); k++) {
+					/// The neighbor is the other tetrahedron with smallest id
+					for (natural k = j; k < e; ++k) {
 
-							if ( incidVert[ currVId[1] ].tetId[k] > currTetId )
-								break;
+						natural t = bucket[k].code >> 2, f = bucket[k].code & 3;
+						natural o = (k == j) ? ( (e - j > 1) ? j + 1 : j ) : j;
 
-							if ( currTetId == incidVert[ currVId[1] ].tetId[k] ) {
+						conTet[t][f] = bucket[o].code >> 2; /// itself when external
 
-								for (l = 0; l < incidVert[ currVId[2] ].tetId.size(); l++) {
+					}
 
-									if ( incidVert[ currVId[2] ].tetId[l] > currTetId )
-										break;
+					j = e;
 
-									if ( currTetId == incidVert[ currVId[2] ].tetId[l] ) {
+				}
 
-										conTet[i][f] = currTetId;
+			}
 
-										break;
+		}
 
-									}
+		delete [] faceCode;
+		delete [] faceOffset;
 
-								} // l
+		/// Compacting external faces in tetrahedra order (fused buildExtF)
+		int numBlocks = 1;
+#ifdef _OPENMP
+		numBlocks = omp_get_max_threads();
+#endif
 
-								if (conTet[i][f] == currTetId) /// it has already been found
-									break;
+		vector< natural > blockExtFaces( numBlocks + 1, 0 );
 
-							} // if
+#pragma omp parallel for
+		for (int b = 0; b < numBlocks; ++b) {
 
-						} // k
+			natural begin = ( (unsigned long long)numTets * b ) / numBlocks;
+			natural end = ( (unsigned long long)numTets * (b + 1) ) / numBlocks;
 
-						if (conTet[i][f] == currTetId) /// it has already been found
-							break;
+			for (natural t = begin; t < end; ++t)
+				for (natural f = 0; f < 4; ++f)
+					if (conTet[t][f] == t) blockExtFaces[b + 1]++;
 
-					} // if
+		}
 
-				} // j
+		for (int b = 0; b < numBlocks; ++b)
+			blockExtFaces[b + 1] += blockExtFaces[b];
 
-				if (conTet[i][f] == i) /// if this is an external face
-					numExtFaces++;
+		numExtFaces = blockExtFaces[numBlocks];
+
+		if (extFaces) delete [] extFaces;
+		extFaces = new ivec2[ numExtFaces ];
+		if (!extFaces) return false;
+
+#pragma omp parallel for
+		for (int b = 0; b < numBlocks; ++b) {
+
+			natural begin = ( (unsigned long long)numTets * b ) / numBlocks;
+			natural end = ( (unsigned long long)numTets * (b + 1) ) / numBlocks;
+			natural extFacesId = blockExtFaces[b];
+
+			for (natural t = begin; t < end; ++t) {
+
+				for (natural f = 0; f < 4; ++f) {
+
+					if (conTet[t][f] != t) continue;
+
+					extFaces[ extFacesId ][0] = t;
+					extFaces[ extFacesId ][1] = f;
+
+					extFacesId++;
+
+				}
 
-			} // f
+			}
 
-		} // i
+		}
 
 		return true;
 
@@ -867,51 +1583,38 @@ public:
 
 	}
 
-	/// Find maximum edge length inside the volume
-	void findMaxEdgeLength(void) {
+	/// Find volume limits: maximum edge length, maximum and minimum Z
+	///   values in one parallel pass (see findBounds)
+	void findLimits(void) {
 
-		real len;
-
-		for (natural i = 0; i < numTets; ++i) { // for each tet
-
-			vec3 edge[6];
+		vec4 min, max;
 
-			edge[0] = vertList[tetList[i][0]].xyz() - vertList[tetList[i][1]].xyz();
-			edge[1] = vertList[tetList[i][0]].xyz() - vertList[tetList[i][2]].xyz();
-			edge[2] = vertList[tetList[i][0]].xyz() - vertList[tetList[i][3]].xyz();
-			edge[3] = vertList[tetList[i][1]].xyz() - vertList[tetList[i][2]].xyz();
-			edge[4] = vertList[tetList[i][1]].xyz() - vertList[tetList[i][3]].xyz();
-			edge[5] = vertList[tetList[i][2]].xyz() - vertList[tetList[i][3]].xyz();
+		findBounds(min, max, maxEdgeLength, true);
 
-			for (natural j = 0; j < 6; ++j) { // for each edge
+		maxZ = max[2];
+		minZ = min[2];
 
-				len = edge[j].length();
+	}
 
-				if (len > maxEdgeLength)
-					maxEdgeLength = len;
+	/// Find maximum edge length inside the volume
+	void findMaxEdgeLength(void) {
 
-			}
+		vec4 min, max;
 
-		}
+		findBounds(min, max, maxEdgeLength, true);
 
 	}
 
 	/// Find maximum and minimum Z values inside the volume
-
 	void findMaxMinZ(void) {
 
-		maxZ = -1.0;
-		minZ = 1.0;
-
-		for (natural i = 0; i < numVerts; ++i) { // for each vertex
-
-			if ( vertList[i][2] > maxZ )
-				maxZ = vertList[i][2];
+		vec4 min, max;
+		real maxEdge;
 
-			if ( vertList[i][2] < minZ )
-				minZ = vertList[i][2];
+		findBounds(min, max, maxEdge, false);
 
-		}
+		maxZ = max[2];
+		minZ = min[2];
 
 	}
 
@@ -941,6 +1644,334 @@ public:
 
 	}
 
+	/// --- Cache ---
+
+	/// Hash the mesh (vertices and tetrahedra) to key the cache bundle
+	/// @return 64-bit hash (see hashBytes)
+	unsigned long long hashMesh(void) const {
+
+		unsigned long long h = hashBytes(HASH_SEED, (const char*)&numVerts, sizeof(natural));
+		h = hashBytes(h, (const char*)&numTets, sizeof(natural));
+
+		if (vertList) h = hashBytes(h, (const char*)vertList, numVerts * sizeof(vec4));
+		if (tetList) h = hashBytes(h, (const char*)tetList, numTets * sizeof(ivec4));
+
+		return h;
+
+	}
+
+	/// Read Cache (preprocessing bundle)
+	///   Load connectivity, external faces and incidence if the bundle
+	///   was built from the same mesh with the same options
+	/// @arg f cache file name
+	/// @arg meshHash hash of the current mesh (see hashMesh)
+	/// @arg options preprocessing options
+	/// @return true if it succeed (false if missing, stale or corrupted)
+	bool readCache(const char* f, unsigned long long meshHash, unsigned int options) {
+
+		ifstream in(f, std::ios::binary);
+		if (in.fail()) return false;
+
+		cacheHeader h;
+
+		in.read((char*)&h, sizeof(cacheHeader));
+		if (in.fail()) return false;
+
+		/// Validate header against this mesh and options
+		if ( strncmp(h.magic, CACHE_MAGIC, 4) != 0 || h.version != CACHE_VERSION ||
+		     h.byteOrder != BOF_BYTE_ORDER || h.realSize != sizeof(real) ||
+		     h.naturalSize != sizeof(natural) || h.options != options ||
+		     h.meshHash != meshHash || h.numVerts != numVerts || h.numTets != numTets ||
+		     h.numExtFaces > 4 * (unsigned long long)numTets )
+			return false;
+
+		bool hasIncid = ( h.numIncidTets > 0 );
+
+		unsigned long long expectedSize = numTets * sizeof(ivec4) +
+			h.numExtFaces * sizeof(ivec2) +
+			( (hasIncid) ? ( 2 * ( numVerts + 1 ) + h.numIncidTets + h.numIncidVerts ) * (unsigned long long)sizeof(natural) : 0 );
+
+		if (h.payloadSize != expectedSize) return false;
+
+		/// Read the whole payload and check it before touching the volume
+		vector< char > payload( h.payloadSize );
+
+		if (h.payloadSize > 0) {
+			in.read(&payload[0], h.payloadSize);
+			if ( in.fail() || (unsigned long long)in.gcount() != h.payloadSize ) return false;
+		}
+
+		const char *p = (h.payloadSize > 0) ? &payload[0] : NULL;
+
+		/// The payload hash chains the blocks in file order (see writeCache)
+		size_t blockSize[6] = { numTets * sizeof(ivec4), h.numExtFaces * sizeof(ivec2),
+					( numVerts + 1 ) * sizeof(natural), h.numIncidTets * sizeof(natural),
+					( numVerts + 1 ) * sizeof(natural), h.numIncidVerts * sizeof(natural) };
+
+		unsigned long long payloadHash = HASH_SEED;
+		const char *block = p;
+
+		for (int k = 0; k < ( (hasIncid) ? 6 : 2 ); ++k) {
+			payloadHash = hashBytes(payloadHash, block, blockSize[k]);
+			block += blockSize[k];
+		}
+
+		if (payloadHash != h.payloadHash) return false;
+
+		/// Connectivity
+		if (conTet) delete [] conTet;
+		conTet = new ivec4[ numTets ];
+		if (!conTet) return false;
+
+		memcpy(conTet, p, numTets * sizeof(ivec4));
+		p += numTets * sizeof(ivec4);
+
+		/// External faces
+		numExtFaces = h.numExtFaces;
+
+		if (extFaces) delete [] extFaces;
+		extFaces = new ivec2[ numExtFaces ];
+		if (!extFaces) return false;
+
+		memcpy(extFaces, p, numExtFaces * sizeof(ivec2));
+		p += numExtFaces * sizeof(ivec2);
+
+		/// Incidence (stored as offsets and ids)
+		if (hasIncid) {
+
+			const natural *tetOffset = (const natural*)p;
+			const natural *tetIds = tetOffset + numVerts + 1;
+			const natural *vertOffset = tetIds + h.numIncidTets;
+			const natural *vertIds = vertOffset + numVerts + 1;
+
+			if ( tetOffset[numVerts] != h.numIncidTets || vertOffset[numVerts] != h.numIncidVerts )
+				return false;
+
+			for (natural i = 0; i < numVerts; ++i)
+				if ( tetOffset[i] > tetOffset[i+1] || vertOffset[i] > vertOffset[i+1] )
+					return false;
+
+			deleteIncid();
+
+			if ( !allocIncid( h.numIncidTets, h.numIncidVerts ) ) return false;
+
+			copy( tetOffset, tetOffset + numVerts + 1, incidVert.tetOffset );
+			copy( tetIds, tetIds + h.numIncidTets, incidVert.tetId );
+			copy( vertOffset, vertOffset + numVerts + 1, incidVert.vertOffset );
+			copy( vertIds, vertIds + h.numIncidVerts, incidVert.vertId );
+
+		}
+
+		return true;
+
+	}
+
+	/// Write Cache (preprocessing bundle)
+	///   Write connectivity, external faces and incidence (if built)
+	///   to a temporary file that is renamed at the end
+	/// @arg f cache file name
+	/// @arg meshHash hash of the current mesh (see hashMesh)
+	/// @arg options preprocessing options
+	/// @return true if it succeed
+	bool writeCache(const char* f, unsigned long long meshHash, unsigned int options) {
+
+		if (!conTet || (numExtFaces && !extFaces)) return false;
+
+		natural numIncidTets = this->numIncidTets(), numIncidVerts = this->numIncidVerts();
+
+		cacheHeader h;
+		memset(&h, 0, sizeof(cacheHeader));
+
+		memcpy(h.magic, CACHE_MAGIC, 4);
+		h.version = CACHE_VERSION;
+		h.byteOrder = BOF_BYTE_ORDER;
+		h.realSize = sizeof(real);
+		h.naturalSize = sizeof(natural);
+		h.options = options;
+		h.numVerts = numVerts;
+		h.numTets = numTets;
+		h.numExtFaces = numExtFaces;
+		h.numIncidTets = numIncidTets;
+		h.numIncidVerts = numIncidVerts;
+		h.meshHash = meshHash;
+		h.payloadSize = numTets * sizeof(ivec4) + numExtFaces * sizeof(ivec2) +
+			( (numIncidTets) ? ( 2 * ( numVerts + 1 ) + numIncidTets + numIncidVerts ) * (unsigned long long)sizeof(natural) : 0 );
+
+		/// The payload hash chains the blocks in file order
+		h.payloadHash = hashBytes(HASH_SEED, (const char*)conTet, numTets * sizeof(ivec4));
+		h.payloadHash = hashBytes(h.payloadHash, (const char*)extFaces, numExtFaces * sizeof(ivec2));
+		if (numIncidTets) {
+			h.payloadHash = hashBytes(h.payloadHash, (const char*)incidVert.tetOffset, ( numVerts + 1 ) * sizeof(natural));
+			h.payloadHash = hashBytes(h.payloadHash, (const char*)incidVert.tetId, numIncidTets * sizeof(natural));
+			h.payloadHash = hashBytes(h.payloadHash, (const char*)incidVert.vertOffset, ( numVerts + 1 ) * sizeof(natural));
+			h.payloadHash = hashBytes(h.payloadHash, (const char*)incidVert.vertId, numIncidVerts * sizeof(natural));
+		}
+
+		std::string tmp = std::string(f) + ".tmp";
+
+		ofstream out(tmp.c_str(), std::ios::binary);
+		if (out.fail()) return false;
+
+		out.write((const char*)&h, sizeof(cacheHeader));
+		out.write((const char*)conTet, numTets * sizeof(ivec4));
+		if (numExtFaces) out.write((const char*)extFaces, numExtFaces * sizeof(ivec2));
+		if (numIncidTets) {
+			out.write((const char*)incidVert.tetOffset, ( numVerts + 1 ) * sizeof(natural));
+			out.write((const char*)incidVert.tetId, numIncidTets * sizeof(natural));
+			out.write((const char*)incidVert.vertOffset, ( numVerts + 1 ) * sizeof(natural));
+			out.write((const char*)incidVert.vertId, numIncidVerts * sizeof(natural));
+		}
+
+		out.close();
+
+		if (out.fail()) { remove(tmp.c_str()); return false; }
+
+		if (rename(tmp.c_str(), f) != 0) { remove(tmp.c_str()); return false; }
+
+		return true;
+
+	}
+
+private:
+
+	/// Morton code bits per axis (3 * 21 bits in 64-bit codes)
+	static const unsigned int MORTON_BITS = 21;
+	static const unsigned int MORTON_MAX = ( 1 << MORTON_BITS ) - 1;
+
+	/// Morton key: code and vertex or tetrahedron id
+	typedef std::pair< unsigned long long, natural > mortonKey;
+
+	/// Spread the lower 21 bits of x two bits apart
+	/// @arg x value
+	/// @return x with two zeros between each bit
+	static unsigned long long mortonSpread(unsigned long long x) {
+		x &= 0x1fffff;
+		x = ( x | x << 32 ) & 0x1f00000000ffffULL;
+		x = ( x | x << 16 ) & 0x1f0000ff0000ffULL;
+		x = ( x | x << 8 ) & 0x100f00f00f00f00fULL;
+		x = ( x | x << 4 ) & 0x10c30c30c30c30c3ULL;
+		x = ( x | x << 2 ) & 0x1249249249249249ULL;
+		return x;
+	}
+
+	/// Morton code of a point
+	/// @arg p point
+	/// @arg min bounding box minimum
+	/// @arg scale MORTON_MAX over bounding box size
+	/// @return 63-bit Morton code
+	static unsigned long long mortonCode(const vec3& p, const vec3& min, const vec3& scale) {
+		unsigned long long c = 0;
+		for (natural j = 0; j < 3; ++j) {
+			real q = ( p[j] - min[j] ) * scale[j];
+			unsigned long long u = (q <= 0) ? 0 : (q >= (real)MORTON_MAX) ? MORTON_MAX : (unsigned long long)q;
+			c |= mortonSpread(u) << j;
+		}
+		return c;
+	}
+
+	/// Face key: sorted vertex ids and code ( 4 * tetId + face )
+	typedef struct _faceKey {
+		natural v[3], code;
+		bool operator < (const struct _faceKey& k) const {
+			if (v[1] != k.v[1]) return v[1] < k.v[1];
+			if (v[2] != k.v[2]) return v[2] < k.v[2];
+			return code < k.code;
+		}
+	} faceKey;
+
+	/// Sorted vertex ids of a tetrahedron face
+	/// @arg t tetrahedron id
+	/// @arg f face id (opposite to vertex MOD4(3, f))
+	/// @arg v returns the three vertex ids in increasing order
+	void faceVertices(natural t, natural f, natural* v) const {
+		v[0] = tetList[t][ MOD4(0, f) ];
+		v[1] = tetList[t][ MOD4(1, f) ];
+		v[2] = tetList[t][ MOD4(2, f) ];
+		if (v[0] > v[1]) std::swap(v[0], v[1]);
+		if (v[1] > v[2]) std::swap(v[1], v[2]);
+		if (v[0] > v[1]) std::swap(v[0], v[1]);
+	}
+
+	/// Smallest vertex id of a tetrahedron face
+	/// @arg t tetrahedron id
+	/// @arg f face id
+	/// @return smallest vertex id
+	natural minFaceVertex(natural t, natural f) const {
+		natural v[3];
+		faceVertices(t, f, v);
+		return v[0];
+	}
+
+	/// 64-bit FNV-1a offset basis and prime
+	static const unsigned long long HASH_SEED = 14695981039346656037ULL;
+	static const unsigned long long HASH_PRIME = 1099511628211ULL;
+
+	/// Mix the bits of an 8-Byte word (splitmix64 finalizer): every
+	///   input bit changes about half of the output bits
+	/// @arg w word
+	/// @return mixed word
+	static unsigned long long mixWord(unsigned long long w) {
+		w = ( w ^ (w >> 30) ) * 0xbf58476d1ce4e5b9ULL;
+		w = ( w ^ (w >> 27) ) * 0x94d049bb133111ebULL;
+		return w ^ (w >> 31);
+	}
+
+	/// Hash a block of Bytes, chained by h: FNV-1a steps over the
+	///   8-Byte words, each mixed first (a multiply only carries bits
+	///   upward, so unmixed words leave the low hash bits blind to their
+	///   high bits), and over the remaining Bytes
+	/// @arg h current hash (HASH_SEED for the first block)
+	/// @arg data block data
+	/// @arg size block size in Bytes
+	/// @return updated hash
+	static unsigned long long hashBytes(unsigned long long h, const char* data, size_t size) {
+		size_t i = 0;
+		unsigned long long w;
+		for (; i + 8 <= size; i += 8) {
+			memcpy(&w, data + i, 8);
+			h = ( h ^ mixWord(w) ) * HASH_PRIME;
+		}
+		for (; i < size; ++i)
+			h = ( h ^ (unsigned char)data[i] ) * HASH_PRIME;
+		return h;
+	}
+
+	/// Allocate incidVert arrays
+	/// @arg nTets number of incident tetrahedra entries
+	/// @arg nVerts number of incident vertices entries (0 to allocate later)
+	/// @return true if it succeed
+	bool allocIncid(natural nTets, natural nVerts) {
+
+		incidVert.tetOffset = new natural[ numVerts + 1 ];
+		incidVert.tetId = new natural[ nTets ];
+		incidVert.vertOffset = new natural[ numVerts + 1 ];
+		incidVert.vertId = (nVerts) ? new natural[ nVerts ] : NULL;
+
+		return ( incidVert.tetOffset && incidVert.tetId && incidVert.vertOffset &&
+			 ( !nVerts || incidVert.vertId ) );
+
+	}
+
+	/// Align offset to the BOF block alignment
+	/// @arg offset in Bytes
+	/// @return next aligned offset
+	static unsigned long long alignBin(unsigned long long offset) {
+		return ( offset + BOF_ALIGN - 1 ) & ~(unsigned long long)(BOF_ALIGN - 1);
+	}
+
+	/// Write one BOF block padding the stream up to its offset
+	/// @arg out output file stream
+	/// @arg offset block offset in Bytes
+	/// @arg data block data
+	/// @arg size block size in Bytes
+	static void writeBinBlock(ofstream& out, unsigned long long offset,
+				  const char* data, size_t size) {
+		static const char zeros[BOF_ALIGN] = { 0 };
+		unsigned long long pos = out.tellp();
+		if (offset > pos) out.write(zeros, offset - pos);
+		out.write(data, size);
+	}
+
 };
 
 #endif
@@ -0,0 +1,1503 @@
+/**
+ *
+ *    PTINT -- Projected Tetrahedra with Partial Pre-Integration
+ *
+ **/
+
+/**
+ *   Benchmark : measure the CPU stages of PTINT outside the
+ *               OpenGL application
+ *
+ * C++ code.
+ *
+ */
+
+/// ----------------------------------   Definitions   ------------------------------------
+
+#include <sys/time.h>
+#include <sys/stat.h>
+
+#include <cstdlib>
+#include <cstring>
+
+#include "offVol.h"
+
+#include "depthSort.h"
+
+#include "mpvoSort.h"
+
+#include "clusterSort.h"
+
+#include "centroidKeys.h"
+
+#include "sortAudit.h"
+
+#include "kBuffer.h"
+
+#include "ptCPU.h"
+
+#include "frustumCull.h"
+
+#include "viewOrder.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using std::cerr;
+
+typedef offVol< float, unsigned > benchVol;
+
+/// -----------------------------------   Functions   -------------------------------------
+
+/// Wall-clock time
+/// @return current time in seconds
+static double wallTime(void) {
+
+	struct timeval t;
+	gettimeofday(&t, 0);
+	return t.tv_sec + t.tv_usec / 1000000.0;
+
+}
+
+/// Load a benchmark volume with the same preprocessing as the
+/// application: normalized vertices in Morton order
+/// @arg fn off file name
+/// @arg vol returns the volume
+/// @arg con also build the connectivity
+/// @return true if it succeed
+static bool loadBenchVolume(const char* fn, benchVol& vol, bool con = false) {
+
+	if ( !vol.readOff(fn) ) return false;
+
+	vol.normalizeVertices();
+
+	if ( !vol.reorderMorton() ) return false;
+
+	return ( !con || vol.buildCon() );
+
+}
+
+/// Parse benchmark: stream (ifstream >>) reader vs parallel parser
+/// @arg fn off file name
+/// @return true if it succeed
+static bool benchParse(const char* fn) {
+
+	struct stat st;
+	if (stat(fn, &st) != 0) return false;
+
+	double mb = st.st_size / 1000000.0, t;
+
+	benchVol streamVol, parallelVol;
+
+	t = wallTime();
+	ifstream in(fn);
+	if ( !streamVol.readOff(in) ) return false;
+	t = wallTime() - t;
+
+	cout << "Stream reader   : " << t << " s ( " << mb / t << " MB/s )" << endl;
+
+	t = wallTime();
+	if ( !parallelVol.readOff(fn) ) return false;
+	t = wallTime() - t;
+
+	cout << "Parallel parser : " << t << " s ( " << mb / t << " MB/s )" << endl;
+
+	/// Both readers must produce the same arrays
+	if ( streamVol.numVerts != parallelVol.numVerts ||
+	     streamVol.numTets != parallelVol.numTets ||
+	     memcmp(streamVol.tetList, parallelVol.tetList, streamVol.numTets * sizeof(benchVol::ivec4)) != 0 ) {
+
+		cerr << "Parallel parser mismatch!" << endl;
+		return false;
+
+	}
+
+	float maxDiff = 0.0;
+
+	for (unsigned i = 0; i < streamVol.numVerts; ++i)
+		for (unsigned j = 0; j < 4; ++j) {
+			float d = fabs(streamVol.vertList[i][j] - parallelVol.vertList[i][j]);
+			if (d > maxDiff) maxDiff = d;
+		}
+
+	cout << "Max vertex difference : " << maxDiff << endl;
+
+	return true;
+
+}
+
+/// Incidence benchmark: CSR incidence and connectivity builds
+///   from one thread up to all threads
+/// @arg fn off file name
+/// @return true if it succeed
+static bool benchIncid(const char* fn) {
+
+	benchVol vol;
+
+	if ( !vol.readOff(fn) ) return false;
+
+	int maxThreads = 1;
+#ifdef _OPENMP
+	maxThreads = omp_get_max_threads();
+#endif
+
+	for (int nt = 1; ; nt = (2 * nt < maxThreads) ? 2 * nt : maxThreads) {
+
+#ifdef _OPENMP
+		omp_set_num_threads(nt);
+#endif
+
+		double tIncid = wallTime();
+		if ( !vol.buildIncid() ) return false;
+		tIncid = wallTime() - tIncid;
+
+		double tCon = wallTime();
+		if ( !vol.buildCon() ) return false;
+		tCon = wallTime() - tCon;
+
+		cout << nt << " thread(s) : incidence " << tIncid << " s , connectivity "
+		     << tCon << " s" << endl;
+
+		if (nt == maxThreads) break;
+
+	}
+
+	cout << "Incidence entries : " << vol.numIncidTets() << " tets , "
+	     << vol.numIncidVerts() << " verts" << endl
+	     << "External faces : " << vol.numExtFaces << endl;
+
+	return true;
+
+}
+
+/// Gather pass: centroid depth of every tetrahedron (the vertex
+/// fetch pattern of the first step and of the sorting stage)
+/// @arg vol volume
+/// @arg depth returns the centroid depths
+/// @return time in seconds of the best of 5 runs
+static double gatherTime(const benchVol& vol, vector< float >& depth) {
+
+	double best = 0.0;
+
+	depth.resize( vol.numTets );
+
+	for (int r = 0; r < 5; ++r) {
+
+		double t = wallTime();
+
+#pragma omp parallel for
+		for (long i = 0; i < (long)vol.numTets; ++i)
+			depth[i] = vol.vertList[ vol.tetList[i][0] ][2] + vol.vertList[ vol.tetList[i][1] ][2] +
+				vol.vertList[ vol.tetList[i][2] ][2] + vol.vertList[ vol.tetList[i][3] ][2];
+
+		t = wallTime() - t;
+
+		if (r == 0 || t < best) best = t;
+
+	}
+
+	return best;
+
+}
+
+/// Reorder benchmark: vertex fetch stride and gather time before and
+/// after the Morton reordering, checking the remapped connectivity
+/// @arg fn off file name
+/// @return true if it succeed
+static bool benchReorder(const char* fn) {
+
+	benchVol vol;
+
+	if ( !vol.readOff(fn) ) return false;
+
+	vol.normalizeVertices();
+
+	if ( !vol.buildCon() ) return false;
+
+	vector< float > depth;
+
+	cout << "File order   : stride " << vol.fetchStride() << " vertices , gather "
+	     << gatherTime(vol, depth) * 1000.0 << " ms" << endl;
+
+	double t = wallTime();
+	if ( !vol.reorderMorton() ) return false;
+	t = wallTime() - t;
+
+	cout << "Morton order : stride " << vol.fetchStride() << " vertices , gather "
+	     << gatherTime(vol, depth) * 1000.0 << " ms" << endl
+	     << "Reordering : " << t << " s" << endl;
+
+	/// The remapped connectivity must match a rebuilt one
+	benchVol::ivec4 *remapped = vol.conTet;
+	vol.conTet = NULL;
+
+	bool same = vol.buildCon() &&
+		memcmp(remapped, vol.conTet, vol.numTets * sizeof(benchVol::ivec4)) == 0;
+
+	delete [] remapped;
+
+	if (!same) cerr << "Remapped connectivity mismatch!" << endl;
+
+	return same;
+
+}
+
+/// Limits benchmark: fused bounds and edge pass by number of
+/// threads, checked against the scalar loops
+/// @arg fn off file name
+/// @return true if it succeed
+static bool benchLimits(const char* fn) {
+
+	benchVol vol;
+
+	if ( !vol.readOff(fn) ) return false;
+
+	/// Scalar reference
+	double t = wallTime();
+
+	benchVol::vec4 rmin = vol.vertList[0], rmax = vol.vertList[0];
+	float rmaxEdge = 0.0;
+
+	for (unsigned i = 1; i < vol.numVerts; ++i)
+		for (unsigned j = 0; j < 4; ++j) {
+			if (vol.vertList[i][j] < rmin[j]) rmin[j] = vol.vertList[i][j];
+			if (vol.vertList[i][j] > rmax[j]) rmax[j] = vol.vertList[i][j];
+		}
+
+	for (unsigned i = 0; i < vol.numTets; ++i)
+		for (unsigned a = 0; a < 3; ++a)
+			for (unsigned b = a + 1; b < 4; ++b) {
+				float len = ( vol.vertList[ vol.tetList[i][a] ].xyz() -
+					      vol.vertList[ vol.tetList[i][b] ].xyz() ).length();
+				if (len > rmaxEdge) rmaxEdge = len;
+			}
+
+	t = wallTime() - t;
+
+	cout << "Scalar loops : " << t * 1000.0 << " ms" << endl;
+
+	int maxThreads = 1;
+#ifdef _OPENMP
+	maxThreads = omp_get_max_threads();
+#endif
+
+	double t1 = 0.0;
+
+	for (int nt = 1; ; nt = (2 * nt < maxThreads) ? 2 * nt : maxThreads) {
+
+#ifdef _OPENMP
+		omp_set_num_threads(nt);
+#endif
+
+		benchVol::vec4 min, max;
+		float maxEdge = 0.0;
+		double best = 0.0;
+
+		for (int r = 0; r < 3; ++r) {
+
+			t = wallTime();
+			vol.findBounds(min, max, maxEdge, true);
+			t = wallTime() - t;
+
+			if (r == 0 || t < best) best = t;
+
+		}
+
+		if (nt == 1) t1 = best;
+
+		cout << nt << " thread(s) : " << best * 1000.0 << " ms , speedup "
+		     << t1 / best << " , efficiency " << 100.0 * t1 / (best * nt) << " %" << endl;
+
+		for (unsigned j = 0; j < 4; ++j)
+			if (min[j] != rmin[j] || max[j] != rmax[j]) {
+				cerr << "Bounds mismatch!" << endl;
+				return false;
+			}
+
+		if ( fabs(maxEdge - rmaxEdge) > 1e-5 * rmaxEdge ) {
+			cerr << "Max edge mismatch!" << endl;
+			return false;
+		}
+
+		if (nt == maxThreads) break;
+
+	}
+
+	return true;
+
+}
+
+/// Centroid pair as sorted by the centroid sort method
+typedef struct _benchCentroid {
+	unsigned id; ///< Tetrahedron index
+	float cZ; ///< Centroid Z
+	friend bool operator < (const struct _benchCentroid& t1, const struct _benchCentroid& t2) {
+		return t1.cZ < t2.cZ;
+	}
+} benchCentroid;
+
+/// Eye +z axis in object coordinates of the benchmark view: the Z
+/// row of a 30 degrees rotation around x then y (as ptint's glRotatef)
+static const float benchViewZ[3] = { -0.4330127f, 0.5f, 0.75f };
+
+/// Centroid depth of every tetrahedron in a view
+/// @arg vol volume
+/// @arg viewZ eye +z axis in object coordinates
+/// @arg keys returns the centroid eye Z
+static void centroidDepth(const benchVol& vol, const float* viewZ, vector< float >& keys) {
+
+	keys.resize( vol.numTets );
+
+	for (unsigned i = 0; i < vol.numTets; ++i) {
+		float z = 0.0;
+		for (unsigned k = 0; k < 4; ++k)
+			for (unsigned j = 0; j < 3; ++j)
+				z += viewZ[j] * vol.vertList[ vol.tetList[i][k] ][j];
+		keys[i] = 0.25 * z;
+	}
+
+}
+
+/// Read depth keys: a raw float dump of the centroid Z column of
+/// outputBuffer0 (ptint key 'd'), or the centroid Z of an off file
+/// rotated as a view of the application
+/// @arg fn depth keys (.z) or off file name
+/// @arg keys returns the depth keys
+/// @return true if it succeed
+static bool readDepthKeys(const char* fn, vector< float >& keys) {
+
+	size_t len = strlen(fn);
+
+	if (len > 4 && strcmp(fn + len - 4, ".off") == 0) {
+
+		benchVol vol;
+
+		if ( !vol.readOff(fn) ) return false;
+
+		vol.normalizeVertices();
+
+		centroidDepth(vol, benchViewZ, keys);
+
+		return true;
+
+	}
+
+	struct stat st;
+
+	if (stat(fn, &st) != 0 || st.st_size < (off_t)sizeof(float)) return false;
+
+	keys.resize( st.st_size / sizeof(float) );
+
+	FILE *f = fopen(fn, "rb");
+	if (!f) return false;
+
+	bool ok = ( fread(&keys[0], sizeof(float), keys.size(), f) == keys.size() );
+
+	fclose(f);
+
+	return ok;
+
+}
+
+/// Keys benchmark: centroid depth keys gathered from the vertices of
+/// each tetrahedron vs the precomputed centroid arrays, by number of
+/// threads, checking both against each other
+/// @arg fn off file name
+/// @return true if it succeed
+static bool benchKeys(const char* fn) {
+
+	benchVol vol;
+
+	if ( !vol.readOff(fn) ) return false;
+
+	vol.normalizeVertices();
+
+	unsigned nT = vol.numTets;
+
+	/// Modelview of the benchmark view (column-major, Z row only)
+	float mv[16] = { 0 };
+	mv[2] = benchViewZ[0]; mv[6] = benchViewZ[1]; mv[10] = benchViewZ[2]; mv[14] = -0.5;
+
+	centroidKeys cpuKeys;
+
+	double t = wallTime();
+	cpuKeys.build(vol);
+	t = wallTime() - t;
+
+	cout << "Centroids : " << t * 1000.0 << " ms , " << cpuKeys.sizeOf() / 1000000.0 << " MB" << endl;
+
+	vector< float > gathered( nT ), keys( nT );
+
+	int maxThreads = 1;
+#ifdef _OPENMP
+	maxThreads = omp_get_max_threads();
+#endif
+
+	for (int nt = 1; ; nt = (2*nt < maxThreads) ? 2*nt : maxThreads) {
+
+#ifdef _OPENMP
+		omp_set_num_threads(nt);
+#endif
+
+		double tGather = 0.0, tKeys = 0.0;
+
+		for (int r = 0; r < 5; ++r) {
+
+			t = wallTime();
+
+#pragma omp parallel for
+			for (long i = 0; i < (long)nT; ++i) {
+				float z = 0.0;
+				for (unsigned k = 0; k < 4; ++k) {
+					const float *v = &vol.vertList[ vol.tetList[i][k] ][0];
+					z += mv[2] * v[0] + mv[6] * v[1] + mv[10] * v[2] + mv[14];
+				}
+				gathered[i] = 0.25 * z;
+			}
+
+			t = wallTime() - t;
+			if (r == 0 || t < tGather) tGather = t;
+
+			t = wallTime();
+			cpuKeys.compute(mv, &keys[0]);
+			t = wallTime() - t;
+			if (r == 0 || t < tKeys) tKeys = t;
+
+		}
+
+		for (unsigned i = 0; i < nT; ++i)
+			if ( fabs(keys[i] - gathered[i]) > 1e-4 ) {
+				cerr << "Key mismatch at tetrahedron " << i << "!" << endl;
+				return false;
+			}
+
+		cout << "Keys " << nt << " thread(s) : gather " << tGather * 1000.0 << " ms , centroids "
+		     << tKeys * 1000.0 << " ms , speedup " << tGather / tKeys << endl;
+
+		if (nt == maxThreads) break;
+
+	}
+
+	return true;
+
+}
+
+/// Sort benchmark: std::sort on centroid pairs vs parallel radix
+/// and bucket sorts on separate keys and ids, by number of threads
+/// @arg fn depth keys (.z) or off file name
+/// @return true if it succeed
+static bool benchSort(const char* fn) {
+
+	vector< float > keys;
+
+	if ( !readDepthKeys(fn, keys) ) return false;
+
+	unsigned n = keys.size();
+
+	cout << "Depth keys : " << n << endl;
+
+	/// std::sort reference
+	vector< benchCentroid > pairs( n );
+	double t, best = 0.0;
+
+	for (int r = 0; r < 5; ++r) {
+
+		for (unsigned i = 0; i < n; ++i) {
+			pairs[i].id = i;
+			pairs[i].cZ = keys[i];
+		}
+
+		t = wallTime();
+		std::sort( pairs.begin(), pairs.end() );
+		t = wallTime() - t;
+
+		if (r == 0 || t < best) best = t;
+
+	}
+
+	double tStd = best;
+
+	cout << "std::sort : " << tStd * 1000.0 << " ms" << endl;
+
+	int maxThreads = 1;
+#ifdef _OPENMP
+	maxThreads = omp_get_max_threads();
+#endif
+
+	depthSort sorter;
+	vector< unsigned > ids( n );
+
+	for (int nt = 1; ; nt = (2 * nt < maxThreads) ? 2 * nt : maxThreads) {
+
+#ifdef _OPENMP
+		omp_set_num_threads(nt);
+#endif
+
+		for (int r = 0; r < 5; ++r) {
+
+			t = wallTime();
+			if ( !sorter.sort(&keys[0], &ids[0], n) ) return false;
+			t = wallTime() - t;
+
+			if (r == 0 || t < best) best = t;
+
+		}
+
+		cout << "Radix " << nt << " thread(s) : " << best * 1000.0 << " ms , speedup over std::sort "
+		     << tStd / best << endl;
+
+		/// Same key sequence as std::sort (ties may differ in id)
+		for (unsigned i = 0; i < n; ++i)
+			if (keys[ ids[i] ] != pairs[i].cZ) {
+				cerr << "Radix order mismatch at " << i << "!" << endl;
+				return false;
+			}
+
+		if (nt == maxThreads) break;
+
+	}
+
+	/// Bucket sort: time and consecutive pairs out of order
+	for (int nt = 1; ; nt = (2 * nt < maxThreads) ? 2 * nt : maxThreads) {
+
+#ifdef _OPENMP
+		omp_set_num_threads(nt);
+#endif
+
+		for (int r = 0; r < 5; ++r) {
+
+			t = wallTime();
+			if ( !sorter.bucketSort(&keys[0], &ids[0], n) ) return false;
+			t = wallTime() - t;
+
+			if (r == 0 || t < best) best = t;
+
+		}
+
+		unsigned descents = 0;
+
+		for (unsigned i = 1; i < n; ++i)
+			if (keys[ ids[i-1] ] > keys[ ids[i] ]) ++descents;
+
+		cout << "Bucket " << nt << " thread(s) : " << best * 1000.0 << " ms , speedup over std::sort "
+		     << tStd / best << " , " << sorter.buckets() << " buckets , "
+		     << descents << " consecutive pairs out of order" << endl;
+
+		if (nt == maxThreads) break;
+
+	}
+
+	/// Quantized sort: time and consecutive pairs out of order
+	for (int nt = 1; ; nt = (2 * nt < maxThreads) ? 2 * nt : maxThreads) {
+
+#ifdef _OPENMP
+		omp_set_num_threads(nt);
+#endif
+
+		for (int r = 0; r < 5; ++r) {
+
+			t = wallTime();
+			if ( !sorter.quantSort(&keys[0], &ids[0], n) ) return false;
+			t = wallTime() - t;
+
+			if (r == 0 || t < best) best = t;
+
+		}
+
+		unsigned descents = 0;
+
+		for (unsigned i = 1; i < n; ++i)
+			if (keys[ ids[i-1] ] > keys[ ids[i] ]) ++descents;
+
+		cout << "Quantized " << nt << " thread(s) : " << best * 1000.0 << " ms , speedup over std::sort "
+		     << tStd / best << " , " << sorter.refined() << " runs refined , "
+		     << descents << " consecutive pairs out of order" << endl;
+
+		if (nt == maxThreads) break;
+
+	}
+
+	return true;
+
+}
+
+/// Visibility benchmark: std::sort on centroid pairs vs the MPVONC
+/// connectivity ordering, checking every face constraint
+/// @arg fn off file name
+/// @return true if it succeed
+static bool benchMpvo(const char* fn) {
+
+	benchVol vol;
+
+	if ( !loadBenchVolume(fn, vol, true) ) return false;
+
+	vector< float > keys;
+
+	centroidDepth(vol, benchViewZ, keys);
+
+	unsigned nT = vol.numTets;
+
+	vector< benchCentroid > pairs( nT );
+	double t, best = 0.0;
+
+	for (int r = 0; r < 5; ++r) {
+
+		for (unsigned i = 0; i < nT; ++i) {
+			pairs[i].id = i;
+			pairs[i].cZ = keys[i];
+		}
+
+		t = wallTime();
+		std::sort( pairs.begin(), pairs.end() );
+		t = wallTime() - t;
+
+		if (r == 0 || t < best) best = t;
+
+	}
+
+	cout << "std::sort : " << best * 1000.0 << " ms" << endl;
+
+	mpvoSort< float, unsigned > sorter;
+	vector< unsigned > order( nT );
+
+	for (int r = 0; r < 5; ++r) {
+
+		t = wallTime();
+		if ( !sorter.sort(vol, benchViewZ, &keys[0], &order[0]) ) return false;
+		t = wallTime() - t;
+
+		if (r == 0 || t < best) best = t;
+
+	}
+
+	cout << "MPVONC : " << best * 1000.0 << " ms , " << sorter.cycleTets() << " tets in cycles" << endl;
+
+	/// A permutation of the tetrahedra where, out of cycles, each one
+	/// is drawn before its neighbors in front
+	vector< unsigned > pos( nT, nT );
+
+	for (unsigned i = 0; i < nT; ++i) {
+		if (order[i] >= nT || pos[ order[i] ] != nT) {
+			cerr << "Order is not a permutation!" << endl;
+			return false;
+		}
+		pos[ order[i] ] = i;
+	}
+
+	unsigned emitted = nT - sorter.cycleTets(), violations = 0, centroidViolations = 0;
+
+	for (unsigned i = 0; i < nT; ++i)
+		for (unsigned f = 0; f < 4; ++f) {
+			unsigned n = vol.conTet[i][f];
+			if (n == i || pos[i] >= emitted || pos[n] >= emitted) continue;
+			if ( sorter.faceSide(vol, i, f, benchViewZ) > 0 && pos[i] > pos[n] ) ++violations;
+			if ( (keys[n] > keys[i]) != (pos[n] > pos[i]) ) ++centroidViolations;
+		}
+
+	cout << "Face pairs out of visibility order : " << violations << endl
+	     << "Face pairs out of centroid order : " << centroidViolations / 2 << endl;
+
+	return violations == 0;
+
+}
+
+/// Audit benchmark: sort time and interior faces drawn in the wrong
+/// order for every CPU ordering of the benchmark view
+/// @arg fn off file name
+/// @return true if it succeed
+static bool benchAudit(const char* fn) {
+
+	benchVol vol;
+
+	if ( !loadBenchVolume(fn, vol, true) ) return false;
+
+	vector< float > keys;
+
+	centroidDepth(vol, benchViewZ, keys);
+
+	unsigned nT = vol.numTets;
+
+	vector< unsigned > order( nT );
+
+	depthSort sorter;
+	clusterSort clSorter;
+	mpvoSort< float, unsigned > visSorter;
+	sortAudit< float, unsigned > auditor;
+
+	const char* names[6] = { "none", "radix", "bucket", "quantized", "cluster", "mpvonc" };
+
+	for (unsigned m = 0; m < 6; ++m) {
+
+		double t = wallTime();
+
+		bool ok = true;
+
+		if (m == 0) for (unsigned i = 0; i < nT; ++i) order[i] = i;
+		else if (m == 1) ok = sorter.sort(&keys[0], &order[0], nT);
+		else if (m == 2) ok = sorter.bucketSort(&keys[0], &order[0], nT);
+		else if (m == 3) ok = sorter.quantSort(&keys[0], &order[0], nT);
+		else if (m == 4) ok = clSorter.sort(&keys[0], &order[0], nT);
+		else ok = visSorter.sort(vol, benchViewZ, &keys[0], &order[0]);
+
+		t = wallTime() - t;
+
+		if (!ok) return false;
+
+		double ta = wallTime();
+		if ( !auditor.audit(vol, benchViewZ, &order[0]) ) return false;
+		ta = wallTime() - ta;
+
+		cout << names[m] << " : " << t * 1000.0 << " ms , " << auditor.violations() << " of "
+		     << auditor.faces() << " faces violated ( " << 100.0 * auditor.violations() / auditor.faces()
+		     << " % ) , audit " << ta * 1000.0 << " ms" << endl;
+
+	}
+
+	return true;
+
+}
+
+/// Render the tetrahedra in a given order into a k-buffer: the
+/// front faces of each one (orthographic view) cover its projection
+/// once, with the front depth per pixel and a constant cell color
+/// @arg vol volume
+/// @arg viewZ eye +z axis in object coordinates
+/// @arg order drawing order
+/// @arg kb k-buffer (cleared, returns the resolved image)
+/// @arg size image size in pixels
+static void renderFrontFaces(const benchVol& vol, const float* viewZ, const vector< unsigned >& order,
+			     kBuffer& kb, unsigned size) {
+
+	/// Eye x and y axes orthogonal to viewZ
+	float up[3] = { 0.0, 1.0, 0.0 }, ex[3], ey[3];
+
+	ex[0] = up[1] * viewZ[2] - up[2] * viewZ[1];
+	ex[1] = up[2] * viewZ[0] - up[0] * viewZ[2];
+	ex[2] = up[0] * viewZ[1] - up[1] * viewZ[0];
+
+	float len = sqrt(ex[0]*ex[0] + ex[1]*ex[1] + ex[2]*ex[2]);
+
+	for (unsigned j = 0; j < 3; ++j) ex[j] /= len;
+
+	ey[0] = viewZ[1] * ex[2] - viewZ[2] * ex[1];
+	ey[1] = viewZ[2] * ex[0] - viewZ[0] * ex[2];
+	ey[2] = viewZ[0] * ex[1] - viewZ[1] * ex[0];
+
+	const float scale = size / 2.4f, alpha = 0.3f;
+
+	kb.clear();
+
+	for (unsigned i = 0; i < order.size(); ++i) {
+
+		unsigned t = order[i];
+		float v[4][3], c[3] = { 0.0, 0.0, 0.0 }, rgba[4];
+
+		for (unsigned k = 0; k < 4; ++k) {
+			const float *p = &vol.vertList[ vol.tetList[t][k] ][0];
+			v[k][0] = ( ex[0]*p[0] + ex[1]*p[1] + ex[2]*p[2] + 1.2f ) * scale;
+			v[k][1] = ( ey[0]*p[0] + ey[1]*p[1] + ey[2]*p[2] + 1.2f ) * scale;
+			v[k][2] = viewZ[0]*p[0] + viewZ[1]*p[1] + viewZ[2]*p[2];
+			for (unsigned j = 0; j < 3; ++j) c[j] += 0.125f * p[j] + 0.125f;
+		}
+
+		for (unsigned j = 0; j < 3; ++j) rgba[j] = alpha * c[j];
+		rgba[3] = alpha;
+
+		/// Front face: the opposite vertex is behind its plane, i.e.
+		///   on the far side of the projected triangle orientation
+		for (unsigned f = 0; f < 4; ++f) {
+
+			const float *a = v[ MOD4(0, f) ], *b = v[ MOD4(1, f) ], *d = v[ MOD4(2, f) ], *o = v[ MOD4(3, f) ];
+
+			float area = (b[0]-a[0])*(d[1]-a[1]) - (b[1]-a[1])*(d[0]-a[0]);
+
+			if (area == 0.0f) continue;
+
+			/// Depth of the face plane at the opposite vertex
+			float wb = ( (o[0]-a[0])*(d[1]-a[1]) - (o[1]-a[1])*(d[0]-a[0]) ) / area;
+			float wd = ( (b[0]-a[0])*(o[1]-a[1]) - (b[1]-a[1])*(o[0]-a[0]) ) / area;
+			float zFace = a[2] + wb * (b[2] - a[2]) + wd * (d[2] - a[2]);
+
+			if (o[2] < zFace) kb.triangle(a, b, d, rgba, rgba, rgba);
+
+		}
+
+	}
+
+	kb.resolve();
+
+}
+
+/// K-buffer benchmark: images of the radix and bucket sort orders
+/// through k-buffers of k = 0 .. KBUFFER_MAX, compared with the image
+/// of the MPVONC visibility order, with time and memory per k
+/// @arg fn off file name
+/// @return true if it succeed
+static bool benchKBuffer(const char* fn) {
+
+	benchVol vol;
+
+	if ( !loadBenchVolume(fn, vol, true) ) return false;
+
+	const unsigned size = 512;
+
+	unsigned nT = vol.numTets;
+
+	vector< float > keys;
+
+	centroidDepth(vol, benchViewZ, keys);
+
+	vector< unsigned > visIds( nT ), ids[3];
+
+	for (unsigned s = 0; s < 3; ++s)
+		ids[s].resize( nT );
+
+	depthSort sorter;
+	mpvoSort< float, unsigned > visSorter;
+
+	if ( !visSorter.sort(vol, benchViewZ, &keys[0], &visIds[0]) ) return false;
+	ids[0] = visIds;
+	if ( !sorter.sort(&keys[0], &ids[1][0], nT) ) return false;
+	if ( !sorter.bucketSort(&keys[0], &ids[2][0], nT) ) return false;
+
+	kBuffer ref, kb;
+
+	if ( !ref.resize(size, size, 0) ) return false;
+
+	double t = wallTime();
+	renderFrontFaces(vol, benchViewZ, visIds, ref, size);
+	t = wallTime() - t;
+
+	cout << "MPVONC order , k = 0 : " << t * 1000.0 << " ms (reference, "
+	     << visSorter.cycleTets() << " tets in cycles)" << endl;
+
+	const char* names[3] = { "MPVONC", "Radix", "Bucket" };
+
+	for (unsigned s = 0; s < 3; ++s)
+		for (unsigned k = 0; k <= KBUFFER_MAX; k = (k == 0) ? 1 : 2 * k) {
+
+			if ( !kb.resize(size, size, k) ) return false;
+
+			t = wallTime();
+			renderFrontFaces(vol, benchViewZ, ids[s], kb, size);
+			t = wallTime() - t;
+
+			double err = 0.0;
+			unsigned wrong = 0;
+
+			for (unsigned p = 0; p < size * size; ++p) {
+				double d = 0.0;
+				for (unsigned j = 0; j < 4; ++j)
+					d = std::max( d, (double)fabs( kb.image()[p*4 + j] - ref.image()[p*4 + j] ) );
+				err += d;
+				if (d > 1.0 / 255.0) ++wrong;
+			}
+
+			cout << names[s] << " order , k = " << k << " : " << t * 1000.0 << " ms , " << kb.sizeOf() / 1000000.0
+			     << " MB , " << kb.reordered() << " fragments reordered , " << wrong
+			     << " pixels off by > 1/255 , mean error " << 255.0 * err / (size * size) << " / 255" << endl;
+
+		}
+
+	return true;
+
+}
+
+/// First step of one tetrahedron, written as firstStep.frag (per
+/// tetrahedron projection and branches), as a reference for ptCPU
+/// @arg vol volume
+/// @arg mv modelview matrix (column-major)
+/// @arg mvp modelview projection matrix (column-major)
+/// @arg t tetrahedron id
+/// @arg o0, o1 returns the two output pixels of the tetrahedron
+static void firstStepShader(const benchVol& vol, const float* mv, const float* mvp, unsigned t, float* o0, float* o1) {
+
+	float vp[4][3], vo[4][3], so[4], sc[4], cZ = 0.0;
+
+	/// dataRetrieval
+	for (unsigned i = 0; i < 4; ++i) {
+		const float *v = &vol.vertList[ vol.tetList[t][i] ][0];
+		sc[i] = v[3];
+		vp[i][0] = mvp[0] * v[0] + mvp[4] * v[1] + mvp[8] * v[2] + mvp[12];
+		vp[i][1] = mvp[1] * v[0] + mvp[5] * v[1] + mvp[9] * v[2] + mvp[13];
+		vp[i][2] = mv[2] * v[0] + mv[6] * v[1] + mv[10] * v[2] + mv[14];
+		cZ += vp[i][2];
+	}
+
+	cZ *= 0.25;
+
+	/// ptClassification
+	float cr[4];
+	cr[0] = (vp[1][0]-vp[0][0]) * (vp[2][1]-vp[0][1]) - (vp[1][1]-vp[0][1]) * (vp[2][0]-vp[0][0]);
+	cr[1] = (vp[1][0]-vp[0][0]) * (vp[3][1]-vp[0][1]) - (vp[1][1]-vp[0][1]) * (vp[3][0]-vp[0][0]);
+	cr[2] = (vp[2][0]-vp[0][0]) * (vp[3][1]-vp[0][1]) - (vp[2][1]-vp[0][1]) * (vp[3][0]-vp[0][0]);
+	cr[3] = (vp[1][0]-vp[2][0]) * (vp[1][1]-vp[3][1]) - (vp[1][1]-vp[2][1]) * (vp[1][0]-vp[3][0]);
+
+	int tests[4], cnt = 5;
+
+	for (unsigned i = 0; i < 4; ++i) {
+		tests[i] = ( (cr[i] > 0.0) ? 1 : (cr[i] < 0.0) ? -1 : 0 ) + 1;
+		if (tests[i] == 1) --cnt;
+	}
+
+	int idTTT = tests[0] * 27 + tests[1] * 9 + tests[2] * 3 + tests[3];
+
+	o0[0] = o0[1] = o1[0] = o1[1] = o1[2] = 0.0;
+	o0[2] = cZ; o0[3] = idTTT; o1[3] = cnt;
+
+	if (cnt < 3) return; ///< discard
+
+	/// orderVertices
+	for (unsigned i = 0; i < 4; ++i) {
+		unsigned r = order_table[idTTT][i];
+		for (unsigned j = 0; j < 3; ++j) vo[i][j] = vp[r][j];
+		so[i] = sc[r];
+	}
+
+	/// computeParams
+	float u1 = 1.0, u2 = 1.0, den = ( (vo[3][1] - vo[1][1]) * (vo[2][0] - vo[0][0]) ) -
+		( (vo[3][0] - vo[1][0]) * (vo[2][1] - vo[0][1]) );
+
+	if (cnt >= 4)
+		u2 = ( ( (vo[2][0] - vo[0][0]) * (vo[0][1] - vo[1][1]) ) -
+		       ( (vo[2][1] - vo[0][1]) * (vo[0][0] - vo[1][0]) ) ) / den;
+	if (cnt == 5)
+		u1 = ( ( (vo[3][0] - vo[1][0]) * (vo[0][1] - vo[1][1]) ) -
+		       ( (vo[3][1] - vo[1][1]) * (vo[0][0] - vo[1][0]) ) ) / den;
+
+	/// computeIntersection
+	float ip[3] = { 0.0, 0.0, 0.0 }, thickness;
+
+	if (cnt == 3) thickness = vo[0][2] - vo[1][2];
+	else if (cnt == 4) thickness = vo[2][2] - ( vo[1][2] + u2 * (vo[3][2] - vo[1][2]) );
+	else {
+		for (unsigned j = 0; j < 3; ++j) ip[j] = vo[0][j] + u1 * (vo[2][j] - vo[0][j]);
+		thickness = ip[2] - ( vo[1][2] + u2 * (vo[3][2] - vo[1][2]) );
+	}
+
+	if (cnt == 5) {
+		if (u1 > 1.0) { thickness /= u1; u1 = 1.0 / u1; }
+		else cnt = 6;
+	}
+
+	/// computeScalars
+	float sf, sb;
+
+	if (cnt == 6) { sf = so[0] + u1 * (so[2] - so[0]); sb = so[1] + u2 * (so[3] - so[1]); }
+	else if (cnt == 5) { sf = so[2]; sb = so[0] + ( so[1] + u2 * (so[3] - so[1]) - so[0] ) * u1; }
+	else if (cnt == 4) { sf = so[2]; sb = so[1] + u2 * (so[3] - so[1]); }
+	else { sf = so[0]; sb = so[1]; }
+
+	o0[0] = ip[0]; o0[1] = ip[1];
+	o1[0] = sf; o1[1] = sb; o1[2] = fabs(thickness); o1[3] = cnt;
+
+}
+
+/// First step benchmark: firstStep.frag per tetrahedron (as iptint's
+/// CPU path) vs ptCPU (vertices projected once, blocks of branch-free
+/// loops), by number of threads, with their output differences
+/// @arg fn off file name
+/// @return true if it succeed
+static bool benchFirst(const char* fn) {
+
+	benchVol vol;
+
+	if ( !loadBenchVolume(fn, vol) ) return false;
+
+	unsigned nT = vol.numTets;
+
+	/// Benchmark view: glRotatef 30 degrees around x then y, and
+	///   glOrtho(-1.2, 1.2) projection (column-major)
+	const float ca = 0.8660254f, sa = 0.5f;
+	float mv[16] = { ca, sa*sa, -ca*sa, 0.0,  0.0, ca, sa, 0.0,  sa, -sa*ca, ca*ca, 0.0,  0.0, 0.0, 0.0, 1.0 };
+	float pj[16] = { 1/1.2f, 0.0, 0.0, 0.0,  0.0, 1/1.2f, 0.0, 0.0,  0.0, 0.0, -1/1.2f, 0.0,  0.0, 0.0, 0.0, 1.0 }, mvp[16];
+
+	glMatrix::modelviewProjection(mv, pj, mvp);
+
+	ptCPU first;
+
+	double t = wallTime();
+	first.build(vol);
+	t = wallTime() - t;
+
+	cout << "Build : " << t * 1000.0 << " ms , " << first.sizeOf() / 1000000.0 << " MB" << endl;
+
+	vector< float > ref0( nT * 4 ), ref1( nT * 4 );
+	vector< unsigned short > out0( nT * 4 ), out1( nT * 3 );
+
+	int maxThreads = 1;
+#ifdef _OPENMP
+	maxThreads = omp_get_max_threads();
+#endif
+
+	for (int nt = 1; ; nt = (2*nt < maxThreads) ? 2*nt : maxThreads) {
+
+#ifdef _OPENMP
+		omp_set_num_threads(nt);
+#endif
+
+		double tRef = 0.0, tCPU = 0.0;
+
+		for (int r = 0; r < 5; ++r) {
+
+			t = wallTime();
+
+#pragma omp parallel for
+			for (long i = 0; i < (long)nT; ++i)
+				firstStepShader(vol, mv, mvp, i, &ref0[i*4], &ref1[i*4]);
+
+			t = wallTime() - t;
+			if (r == 0 || t < tRef) tRef = t;
+
+			t = wallTime();
+			first.firstStep(mv, pj, &out0[0], &out1[0]);
+			t = wallTime() - t;
+			if (r == 0 || t < tCPU) tCPU = t;
+
+		}
+
+		cout << "First step " << nt << " thread(s) : per tetrahedron " << tRef * 1000.0 << " ms , ptCPU "
+		     << tCPU * 1000.0 << " ms , speedup " << tRef / tCPU << endl;
+
+		if (nt == maxThreads) break;
+
+	}
+
+	/// Output differences and projection classes: the reference packed
+	///   in halves as ptCPU and the first step shader output
+	unsigned classes[7] = { 0 }, classDiff = 0, exact = 0;
+	float maxDiff = 0.0, maxError = 0.0;
+
+	for (unsigned i = 0; i < nT; ++i) {
+
+		unsigned code = (unsigned)halfFloat::unpack( out0[i*4 + 3] );
+
+		++classes[ std::min( code >> 7, 6u ) ];
+
+		if (code != ref0[i*4 + 3] + ref1[i*4 + 3] * 128) { ++classDiff; continue; }
+
+		float ref[6] = { ref0[i*4 + 0], ref0[i*4 + 1], ref0[i*4 + 2], ref1[i*4 + 0], ref1[i*4 + 1], ref1[i*4 + 2] };
+		unsigned short out[6] = { out0[i*4 + 0], out0[i*4 + 1], out0[i*4 + 2], out1[i*3 + 0], out1[i*3 + 1], out1[i*3 + 2] };
+
+		bool same = true;
+
+		for (unsigned j = 0; j < 6; ++j) {
+			float o = halfFloat::unpack( out[j] );
+			maxDiff = std::max( maxDiff, (float)fabs(o - halfFloat::unpack( halfFloat::pack(ref[j]) )) );
+			maxError = std::max( maxError, (float)fabs(o - ref[j]) );
+			same = same && out[j] == halfFloat::pack(ref[j]);
+		}
+
+		if (same) ++exact;
+
+	}
+
+	cout << "Count 3 / 4 / 5 / 6 / discarded : " << classes[3] << " / " << classes[4] << " / " << classes[5] << " / "
+	     << classes[6] << " / " << classes[0] + classes[1] + classes[2] << endl;
+
+	cout << "Bit-identical halves : " << exact << " of " << nT << " , class mismatches " << classDiff
+	     << " , max difference " << maxDiff << " , max half rounding error " << maxError << endl;
+
+	cout << "Output : " << ( out0.size() + out1.size() ) * sizeof(unsigned short) / (double)nT << " Bytes per tetrahedron ( "
+	     << ( ref0.size() + ref1.size() ) * sizeof(float) / (double)nT << " as floats )" << endl;
+
+	return (classDiff == 0);
+
+}
+
+/// Cull benchmark: cluster frustum cull time, tetrahedra in view and
+/// the CPU first step on all vs the active tetrahedra, zooming in 1,
+/// 2, 4 and 8 times (checking that no tetrahedron with a vertex in
+/// the view volume is culled)
+/// @arg fn off file name
+/// @return true if it succeed
+static bool benchCull(const char* fn) {
+
+	benchVol vol;
+
+	if ( !loadBenchVolume(fn, vol) ) return false;
+
+	unsigned nT = vol.numTets;
+
+	frustumCull culler;
+	ptCPU first;
+
+	double t = wallTime();
+	culler.build(vol);
+	t = wallTime() - t;
+
+	cout << "Build : " << t * 1000.0 << " ms , " << culler.clusters() << " clusters , "
+	     << culler.sizeOf() / 1000000.0 << " MB" << endl;
+
+	first.build(vol);
+
+	vector< unsigned short > out0( nT * 4 ), out1( nT * 3 );
+
+	unsigned missed = 0;
+
+	for (float zoom = 1.0; zoom <= 8.0; zoom *= 2.0) {
+
+		/// Benchmark view (as the first step one) scaled by zoom
+		const float ca = 0.8660254f, sa = 0.5f;
+		float mv[16] = { ca, sa*sa, -ca*sa, 0.0,  0.0, ca, sa, 0.0,  sa, -sa*ca, ca*ca, 0.0,  0.0, 0.0, 0.0, 1.0 };
+		float pj[16] = { 1/1.2f, 0.0, 0.0, 0.0,  0.0, 1/1.2f, 0.0, 0.0,  0.0, 0.0, -1/1.2f, 0.0,  0.0, 0.0, 0.0, 1.0 }, mvp[16];
+
+		for (unsigned i = 0; i < 12; ++i)
+			mv[i] *= zoom;
+
+		glMatrix::modelviewProjection(mv, pj, mvp);
+
+		double tCull = 0.0, tFull = 0.0, tActive = 0.0;
+		unsigned numActive = 0;
+
+		for (int r = 0; r < 5; ++r) {
+
+			t = wallTime();
+			numActive = culler.cull(mv, pj);
+			t = wallTime() - t;
+			if (r == 0 || t < tCull) tCull = t;
+
+			t = wallTime();
+			first.firstStep(mv, pj, &out0[0], &out1[0]);
+			t = wallTime() - t;
+			if (r == 0 || t < tFull) tFull = t;
+
+			t = wallTime();
+			if (numActive) first.firstStep(mv, pj, &out0[0], &out1[0], culler.activeRanges(), culler.rangeCount());
+			t = wallTime() - t;
+			if (r == 0 || t < tActive) tActive = t;
+
+		}
+
+		/// Conservative cull: a tetrahedron with a vertex in the view
+		///   volume must be active
+		for (unsigned i = 0; i < nT; ++i) {
+
+			if ( culler.isActive(i) ) continue;
+
+			for (unsigned k = 0; k < 4; ++k) {
+
+				const float *v = &vol.vertList[ vol.tetList[i][k] ][0];
+				float c[4];
+
+				for (unsigned j = 0; j < 4; ++j)
+					c[j] = mvp[0*4 + j] * v[0] + mvp[1*4 + j] * v[1] + mvp[2*4 + j] * v[2] + mvp[3*4 + j];
+
+				if ( fabs(c[0]) <= c[3] && fabs(c[1]) <= c[3] && fabs(c[2]) <= c[3] ) { ++missed; break; }
+
+			}
+
+		}
+
+		cout << "Zoom " << zoom << " : " << numActive << " of " << nT << " tets in view ( "
+		     << 100.0 * numActive / nT << " % ) in " << culler.rangeCount() << " ranges , cull "
+		     << tCull * 1000.0 << " ms , first step all " << tFull * 1000.0 << " ms , active "
+		     << tActive * 1000.0 << " ms" << endl;
+
+	}
+
+	cout << "Culled tets with a vertex in view : " << missed << endl;
+
+	return (missed == 0);
+
+}
+
+/// Resort benchmark: frame-to-frame incremental resort vs full
+/// radix sort along rotations around y of 0, 0.01, 0.1 and 1 degree
+/// per frame (0 is the case of zoom and transfer function changes)
+/// @arg fn off file name
+/// @return true if it succeed
+static bool benchResort(const char* fn) {
+
+	benchVol vol;
+
+	if ( !vol.readOff(fn) ) return false;
+
+	vol.normalizeVertices();
+
+	const unsigned numFrames = 30;
+	const float steps[4] = { 0.0f, 0.01f, 0.1f, 1.0f };
+
+	unsigned nT = vol.numTets;
+
+	vector< float > keys;
+	vector< unsigned > fullIds( nT ), ids( nT );
+
+	depthSort fullSorter, incSorter;
+
+	for (unsigned s = 0; s < 4; ++s) {
+
+		unsigned numFull = 0;
+		unsigned long swaps = 0;
+		double tFull = 0.0, tInc = 0.0, t;
+
+		for (unsigned frame = 0; frame <= numFrames; ++frame) {
+
+			/// Z row of a 30 degrees rotation around x then around y
+			float a = M_PI / 6.0, b = ( 30.0 + frame * steps[s] ) * M_PI / 180.0;
+			float viewZ[3] = { -cosf(a) * sinf(b), sinf(a), cosf(a) * cosf(b) };
+
+			centroidDepth(vol, viewZ, keys);
+
+			t = wallTime();
+			if ( !fullSorter.sort(&keys[0], &fullIds[0], nT) ) return false;
+			t = wallTime() - t;
+
+			if (frame == 0) { ids = fullIds; continue; }
+
+			tFull += t;
+
+			t = wallTime();
+			if ( !incSorter.resort(&keys[0], &ids[0], nT) ) return false;
+			tInc += wallTime() - t;
+
+			swaps += incSorter.swaps();
+			if (incSorter.fullSort()) ++numFull;
+
+			for (unsigned i = 0; i < nT; ++i)
+				if (keys[ ids[i] ] != keys[ fullIds[i] ]) {
+					cerr << "Resort order mismatch at frame " << frame << "!" << endl;
+					return false;
+				}
+
+		}
+
+		cout << steps[s] << " degree / frame : radix " << tFull * 1000.0 / numFrames
+		     << " ms , incremental " << tInc * 1000.0 / numFrames << " ms ( "
+		     << swaps / numFrames << " swaps , " << numFull << " / " << numFrames
+		     << " full sorts )" << endl;
+
+	}
+
+	return true;
+
+}
+
+/// Cluster benchmark: full radix sort vs two-level cluster sort
+/// along rotations around y of 0.1 and 1 degree per frame, with the
+/// mesh in Morton order, counting the pairs left out of order
+/// @arg fn off file name
+/// @return true if it succeed
+static bool benchCluster(const char* fn) {
+
+	benchVol vol;
+
+	if ( !loadBenchVolume(fn, vol) ) return false;
+
+	const unsigned numFrames = 30;
+	const float steps[2] = { 0.1f, 1.0f };
+
+	unsigned nT = vol.numTets;
+
+	vector< float > keys;
+	vector< unsigned > fullIds( nT ), ids( nT );
+	vector< bool > seen( nT );
+
+	depthSort fullSorter;
+	clusterSort clSorter;
+
+	for (unsigned s = 0; s < 2; ++s) {
+
+		unsigned long resorted = 0, descents = 0;
+		double tFull = 0.0, tCluster = 0.0, t;
+
+		for (unsigned frame = 0; frame <= numFrames; ++frame) {
+
+			/// Z row of a 30 degrees rotation around x then around y
+			float a = M_PI / 6.0, b = ( 30.0 + frame * steps[s] ) * M_PI / 180.0;
+			float viewZ[3] = { -cosf(a) * sinf(b), sinf(a), cosf(a) * cosf(b) };
+
+			centroidDepth(vol, viewZ, keys);
+
+			t = wallTime();
+			if ( !fullSorter.sort(&keys[0], &fullIds[0], nT) ) return false;
+			t = wallTime() - t;
+
+			double tc = wallTime();
+			if ( !clSorter.sort(&keys[0], &ids[0], nT) ) return false;
+			tc = wallTime() - tc;
+
+			if (frame == 0) continue; /// First frame builds the local orders
+
+			tFull += t;
+			tCluster += tc;
+
+			resorted += clSorter.resorted();
+
+			seen.assign(nT, false);
+
+			for (unsigned i = 0; i < nT; ++i) {
+				if (ids[i] >= nT || seen[ ids[i] ]) {
+					cerr << "Cluster order is not a permutation at frame " << frame << "!" << endl;
+					return false;
+				}
+				seen[ ids[i] ] = true;
+				if (i > 0 && keys[ ids[i-1] ] > keys[ ids[i] ]) ++descents;
+			}
+
+		}
+
+		cout << steps[s] << " degree / frame : radix " << tFull * 1000.0 / numFrames
+		     << " ms , cluster " << tCluster * 1000.0 / numFrames << " ms ( "
+		     << clSorter.clusters() << " clusters , " << resorted / numFrames << " re-sorted , "
+		     << descents / numFrames << " consecutive pairs out of order )" << endl;
+
+	}
+
+	return true;
+
+}
+
+/// View order benchmark: build, write and read the view order cache,
+/// then radix sort vs cached order plus bounded repair on views near
+/// the cached directions (0.5 degree away) and on arbitrary views
+/// @arg fn off file name
+/// @return true if it succeed
+static bool benchViewOrder(const char* fn) {
+
+	benchVol vol;
+
+	if ( !vol.readOff(fn) ) return false;
+
+	vol.normalizeVertices();
+
+	unsigned nT = vol.numTets;
+	unsigned long long meshHash = vol.hashMesh();
+
+	viewOrder< float, unsigned > voc, vocRead;
+
+	double t = wallTime();
+	if ( !voc.build(vol) ) { cerr << "Over the memory budget!" << endl; return false; }
+	t = wallTime() - t;
+
+	cout << "Build : " << t << " s , " << voc.directions() << " directions , "
+	     << voc.sizeOf() / 1000000.0 << " MB" << endl;
+
+	std::string fnVoc = std::string(fn) + ".voc";
+
+	t = wallTime();
+	bool ok = voc.write(fnVoc.c_str(), meshHash) && vocRead.read(fnVoc.c_str(), meshHash, nT);
+	t = wallTime() - t;
+
+	remove(fnVoc.c_str());
+
+	vector< unsigned > fullIds( nT ), ids( nT );
+
+	if (ok) {
+		voc.order(-1, &ids[0]);
+		vocRead.order(-1, &fullIds[0]);
+		ok = ( vocRead.directions() == voc.directions() && ids == fullIds );
+	}
+
+	if (!ok) { cerr << "Write / read failed!" << endl; return false; }
+
+	cout << "Write and read : " << t << " s" << endl;
+
+	vector< float > keys;
+	depthSort fullSorter, repairSorter;
+
+	for (unsigned near = 1; ; near = 0) {
+
+		const unsigned numViews = 32;
+		unsigned long swaps = 0, descents = 0;
+		double tFull = 0.0, tCached = 0.0;
+
+		for (unsigned v = 0; v < numViews; ++v) {
+
+			float viewZ[3];
+
+			if (near) { /// A cached direction tilted by 0.5 degree
+				float d[3] = { 0.0, 0.0, 1.0 };
+				vector< float > all;
+				viewOrder< float, unsigned >::geodesic(0, all);
+				for (unsigned j = 0; j < 3; ++j) d[j] = all[ ( v % 12 ) * 3 + j ];
+				float c = cos(M_PI / 360.0), s = sin(M_PI / 360.0);
+				float p[3] = { -d[1], d[0], 0.0 }, len = sqrt(p[0]*p[0] + p[1]*p[1]);
+				if (len < 1e-3) { p[0] = 1.0; p[1] = 0.0; len = 1.0; }
+				for (unsigned j = 0; j < 3; ++j) viewZ[j] = c * d[j] + s * p[j] / len;
+			} else { /// Spiral over the sphere
+				float z = 1.0 - ( 2.0 * v + 1.0 ) / numViews, r = sqrt(1.0 - z*z), phi = v * 2.39996;
+				viewZ[0] = r * cos(phi); viewZ[1] = r * sin(phi); viewZ[2] = z;
+			}
+
+			centroidDepth(vol, viewZ, keys);
+
+			t = wallTime();
+			if ( !fullSorter.sort(&keys[0], &fullIds[0], nT) ) return false;
+			tFull += wallTime() - t;
+
+			t = wallTime();
+			if ( !voc.order(voc.nearest(viewZ), &ids[0]) ) return false;
+			if ( !repairSorter.repair(&keys[0], &ids[0], nT, VOC_REPAIR_WINDOW) ) return false;
+			tCached += wallTime() - t;
+
+			swaps += repairSorter.swaps();
+
+			for (unsigned i = 1; i < nT; ++i)
+				if (keys[ ids[i-1] ] > keys[ ids[i] ]) ++descents;
+
+		}
+
+		cout << ( (near) ? "Near cached views" : "Arbitrary views" ) << " : radix "
+		     << tFull * 1000.0 / numViews << " ms , cached " << tCached * 1000.0 / numViews << " ms ( "
+		     << swaps / numViews << " swaps , " << descents / numViews
+		     << " consecutive pairs out of order )" << endl;
+
+		if (!near) break;
+
+	}
+
+	return true;
+
+}
+
+/// Main
+
+int main(int argc, char** argv) {
+
+	if (argc < 3) {
+
+		cerr << "Usage: " << argv[0] << " 'benchmark' 'file'" << endl << endl
+		     << "  Benchmarks:" << endl
+		     << "  |_ parse 'file'.off : ASCII OFF throughput (MB/s) of the stream reader and the parallel parser" << endl
+		     << "  |_ incid 'file'.off : CSR incidence and connectivity builds from one thread up to all threads" << endl
+		     << "  |_ reorder 'file'.off : vertex fetch stride and gather time before and after the Morton reordering" << endl
+		     << "  |_ limits 'file'.off : fused bounds and edge pass by number of threads vs the scalar loops" << endl
+		     << "  |_ keys 'file'.off : centroid Z gathered from the vertices vs precomputed centroid arrays" << endl
+		     << "  |_ sort 'file'.z|.off : std::sort vs parallel radix, bucket and quantized sorts on dumped (key 'd') or computed centroid Z" << endl
+		     << "  |_ mpvo 'file'.off : std::sort vs connectivity visibility ordering (MPVONC)" << endl
+		     << "  |_ audit 'file'.off : sort time and faces drawn out of visibility order for each sort method" << endl
+		     << "  |_ first 'file'.off : first step per tetrahedron (as the shader) vs the blocked CPU first step (ptCPU)" << endl
+		     << "  |_ cull 'file'.off : tets in view, cluster cull time and first step on all vs active tets zooming in" << endl
+		     << "  |_ kbuffer 'file'.off : radix and bucket order images through k-buffers vs the MPVONC order image" << endl
+		     << "  |_ resort 'file'.off : full radix sort vs incremental resort along rotations" << endl
+		     << "  |_ cluster 'file'.off : full radix sort vs two-level cluster sort along rotations" << endl
+		     << "  |_ voc 'file'.off : view order cache size and radix sort vs cached order plus bounded repair" << endl
+		     << endl;
+
+		return 1;
+
+	}
+
+	bool ok = false;
+
+	if (strcmp(argv[1], "parse") == 0) ok = benchParse(argv[2]);
+	else if (strcmp(argv[1], "incid") == 0) ok = benchIncid(argv[2]);
+	else if (strcmp(argv[1], "reorder") == 0) ok = benchReorder(argv[2]);
+	else if (strcmp(argv[1], "limits") == 0) ok = benchLimits(argv[2]);
+	else if (strcmp(argv[1], "sort") == 0) ok = benchSort(argv[2]);
+	else if (strcmp(argv[1], "mpvo") == 0) ok = benchMpvo(argv[2]);
+	else if (strcmp(argv[1], "keys") == 0) ok = benchKeys(argv[2]);
+	else if (strcmp(argv[1], "audit") == 0) ok = benchAudit(argv[2]);
+	else if (strcmp(argv[1], "first") == 0) ok = benchFirst(argv[2]);
+	else if (strcmp(argv[1], "cull") == 0) ok = benchCull(argv[2]);
+	else if (strcmp(argv[1], "kbuffer") == 0) ok = benchKBuffer(argv[2]);
+	else if (strcmp(argv[1], "resort") == 0) ok = benchResort(argv[2]);
+	else if (strcmp(argv[1], "cluster") == 0) ok = benchCluster(argv[2]);
+	else if (strcmp(argv[1], "voc") == 0) ok = benchViewOrder(argv[2]);
+	else cerr << "Unknown benchmark: " << argv[1] << endl;
+
+	return (ok) ? 0 : 1;
+
+}
@@ -0,0 +1,374 @@
+/**
+ *   PT CPU
+ *
+ */
+
+/**
+ *   ptCPU : defines a class to run the first step (projection and
+ *           classification of the tetrahedra) in CPU
+ *
+ * C++ header (with implementation).
+ *
+ */
+
+/// --------------------------------   Definitions   ------------------------------------
+
+#ifndef _PTCPU_H_
+#define _PTCPU_H_
+
+#include <GL/gl.h>
+
+#include <cmath>
+
+#include <algorithm>
+#include <vector>
+
+#include "offVol.h"
+
+#include "tables.h"
+
+#include "halfFloat.h"
+
+#include "glMatrix.h"
+
+#define PTCPU_BLOCK 64 ///< Tetrahedra classified together by each thread
+
+/// ----------------------------------   ptCPU   -------------------------------------
+
+/// PT CPU Class
+///   Same computation as firstStep.frag, with the same operations in
+///   the same order, writing the same packed half float output
+///   buffers (outputBuffer0,1).
+///   The vertices are projected once (not once per tetrahedron as in
+///   the shader) into separate x, y and z arrays.  Then each thread
+///   takes blocks of PTCPU_BLOCK tetrahedra: gathers their projected
+///   vertices, and classifies, intersects and interpolates the whole
+///   block in branch-free loops (selects instead of ifs) that the
+///   compiler vectorizes.  Only the vertex gathers, the ternary truth
+///   table lookup and the interleaved write back are scalar.
+///   Tetrahedra the shader discards (count < 3, degenerate projection)
+///   are written with their centroid Z and count, the rest zero.
+///   With incremental, the class (idTTT | count << 7) of each
+///   tetrahedron is kept between first steps: the four cross tests
+///   detect a class change, and only the reclassified tetrahedra
+///   (listed for the setup of their triangle fans) write the class
+///   channel.  The others keep their known vertex order and update
+///   the view dependent outputs: intersection, centroid Z, scalars
+///   and thickness
+class ptCPU {
+
+public:
+
+	/// Constructor
+	ptCPU() : numTets(0), numChanged(0), incremental(false) { }
+
+	/// Size of the CPU arrays
+	/// @return size in Bytes
+	size_t sizeOf(void) const {
+		return ( vx.size() + vy.size() + vz.size() + vs.size() + px.size() + py.size() + pz.size() ) * sizeof(float) +
+			( tets.size() + blocks.size() + changed.size() + blockChanged.size() ) * sizeof(unsigned) +
+			codes.size() * sizeof(unsigned short);
+	}
+
+	/// Number of tetrahedra (0 if not built)
+	unsigned size(void) const { return numTets; }
+
+	/// Keep the class of each tetrahedron between first steps
+	///   (enabling forgets the known classes: all are reclassified)
+	/// @arg _i incremental first step
+	void setIncremental(bool _i) {
+		if (_i) std::fill(codes.begin(), codes.end(), (unsigned short)0xffff);
+		incremental = _i;
+	}
+	bool getIncremental(void) const { return incremental; }
+
+	/// Tetrahedra reclassified by the last incremental first step
+	///   (class changed, or computed for the first time)
+	const unsigned* reclassified(void) const { return (numChanged) ? &changed[0] : NULL; }
+	unsigned numReclassified(void) const { return numChanged; }
+
+	/// Build the vertex and tetrahedra arrays
+	/// @arg vol volume
+	template< class real, class natural >
+	void build(const offVol< real, natural >& vol) {
+
+		natural nV = vol.numVerts, nT = vol.numTets;
+
+		vx.resize(nV); vy.resize(nV); vz.resize(nV); vs.resize(nV);
+		px.resize(nV); py.resize(nV); pz.resize(nV);
+
+		tets.resize(nT * 4);
+
+		codes.assign(nT, 0xffff); ///< No known class
+		changed.resize(nT);
+
+		numTets = nT;
+		numChanged = 0;
+
+		long i;
+
+#pragma omp parallel for
+		for (i = 0; i < (long)nV; ++i) {
+			vx[i] = vol.vertList[i][0];
+			vy[i] = vol.vertList[i][1];
+			vz[i] = vol.vertList[i][2];
+			vs[i] = vol.vertList[i][3];
+		}
+
+#pragma omp parallel for
+		for (i = 0; i < (long)nT; ++i)
+			for (unsigned k = 0; k < 4; ++k)
+				tets[i*4 + k] = vol.tetList[i][k];
+
+	}
+
+	/// Run the first step
+	/// @arg mv modelview matrix (OpenGL column-major)
+	/// @arg pj projection matrix (OpenGL column-major)
+	/// @arg out0 returns ( intersection x, y, centroid Z, idTTT | count << 7 ) of each tetrahedron
+	/// @arg out1 returns ( scalar front, back, thickness ) of each tetrahedron
+	/// @arg ranges [ begin, end ) pairs of the tetrahedra to compute (NULL all)
+	/// @arg numRanges number of ranges
+	void firstStep(const float* mv, const float* pj, unsigned short* out0, unsigned short* out1,
+		       const unsigned* ranges = NULL, unsigned numRanges = 0) {
+
+		if (numTets == 0) return;
+
+		float mvp[16];
+
+		glMatrix::modelviewProjection(mv, pj, mvp);
+
+		project(mv, mvp);
+
+		/// Blocks of each range ( [ first, end ) pairs )
+		const unsigned all[2] = { 0, numTets };
+
+		if (!ranges) { ranges = all; numRanges = 1; }
+
+		blocks.clear();
+
+		for (unsigned r = 0; r < numRanges; ++r)
+			for (unsigned first = ranges[r*2]; first < ranges[r*2 + 1]; first += PTCPU_BLOCK) {
+				blocks.push_back(first);
+				blocks.push_back( std::min(first + PTCPU_BLOCK, ranges[r*2 + 1]) );
+			}
+
+		long b, numBlocks = blocks.size() / 2;
+
+		blockChanged.resize(numBlocks);
+
+#pragma omp parallel for schedule(static)
+		for (b = 0; b < numBlocks; ++b)
+			blockChanged[b] = classifyBlock(blocks[b*2], blocks[b*2 + 1], out0, out1);
+
+		/// Reclassified tetrahedra: each block listed its own at
+		///   changed[ first, ... ), compacted in block order
+		numChanged = 0;
+
+		if (!incremental) return;
+
+		for (b = 0; b < numBlocks; ++b) {
+			std::copy(&changed[ blocks[b*2] ], &changed[ blocks[b*2] ] + blockChanged[b], &changed[numChanged]);
+			numChanged += blockChanged[b];
+		}
+
+	}
+
+private:
+
+	/// Project all vertices: screen x, y (modelview projection) and eye Z
+	/// @arg mv modelview matrix
+	/// @arg mvp modelview projection matrix
+	void project(const float* mv, const float* mvp) {
+
+		const float a0 = mvp[0], a1 = mvp[4], a2 = mvp[8], a3 = mvp[12];
+		const float b0 = mvp[1], b1 = mvp[5], b2 = mvp[9], b3 = mvp[13];
+		const float c0 = mv[2], c1 = mv[6], c2 = mv[10], c3 = mv[14];
+		const float *x = &vx[0], *y = &vy[0], *z = &vz[0];
+		float *ox = &px[0], *oy = &py[0], *oz = &pz[0];
+
+		long i, n = vx.size();
+
+		/// One output array per loop (unit stride, vectorized)
+#pragma omp parallel
+		{
+#pragma omp for nowait
+			for (i = 0; i < n; ++i)
+				ox[i] = a0 * x[i] + a1 * y[i] + a2 * z[i] + a3;
+#pragma omp for nowait
+			for (i = 0; i < n; ++i)
+				oy[i] = b0 * x[i] + b1 * y[i] + b2 * z[i] + b3;
+#pragma omp for nowait
+			for (i = 0; i < n; ++i)
+				oz[i] = c0 * x[i] + c1 * y[i] + c2 * z[i] + c3;
+		}
+
+	}
+
+	/// Classify a block of tetrahedra (firstStep.frag main)
+	/// @arg first first tetrahedron of the block
+	/// @arg end last tetrahedron of the block + 1 (at most PTCPU_BLOCK after first)
+	/// @arg out0, out1 output buffers (4 and 3 halves per tetrahedron)
+	/// @return number of reclassified tetrahedra (incremental), listed at changed[first, ... )
+	unsigned classifyBlock(unsigned first, unsigned end, unsigned short* out0, unsigned short* out1) {
+
+		unsigned n = end - first;
+
+		/// Block arrays: vertex k of tetrahedron j at [k][j]
+		float x[4][PTCPU_BLOCK], y[4][PTCPU_BLOCK], z[4][PTCPU_BLOCK], s[4][PTCPU_BLOCK];
+		float ox[4][PTCPU_BLOCK], oy[4][PTCPU_BLOCK], oz[4][PTCPU_BLOCK], os[4][PTCPU_BLOCK];
+		float cZ[PTCPU_BLOCK], pX[PTCPU_BLOCK], pY[PTCPU_BLOCK], sF[PTCPU_BLOCK], sB[PTCPU_BLOCK], th[PTCPU_BLOCK], ct[PTCPU_BLOCK];
+		int idTTT[PTCPU_BLOCK], cnt[PTCPU_BLOCK];
+		bool write[PTCPU_BLOCK]; ///< Write the class channel
+
+		unsigned j, k, m = 0;
+
+		/// [1] Data retrieval (gather the projected vertices)
+		for (j = 0; j < n; ++j)
+			for (k = 0; k < 4; ++k) {
+				unsigned v = tets[ (first + j)*4 + k ];
+				x[k][j] = px[v]; y[k][j] = py[v]; z[k][j] = pz[v]; s[k][j] = vs[v];
+			}
+
+		/// [2] Centroid and projection classification (four cross tests)
+		for (j = 0; j < n; ++j) {
+
+			cZ[j] = ( z[0][j] + z[1][j] + z[2][j] + z[3][j] ) * 0.25f;
+
+			float c0 = (x[1][j] - x[0][j]) * (y[2][j] - y[0][j]) - (y[1][j] - y[0][j]) * (x[2][j] - x[0][j]);
+			float c1 = (x[1][j] - x[0][j]) * (y[3][j] - y[0][j]) - (y[1][j] - y[0][j]) * (x[3][j] - x[0][j]);
+			float c2 = (x[2][j] - x[0][j]) * (y[3][j] - y[0][j]) - (y[2][j] - y[0][j]) * (x[3][j] - x[0][j]);
+			float c3 = (x[1][j] - x[2][j]) * (y[1][j] - y[3][j]) - (y[1][j] - y[2][j]) * (x[1][j] - x[3][j]);
+
+			/// Tests: sign(cross) + 1
+			int t0 = (c0 > 0.0f) ? 2 : (c0 < 0.0f) ? 0 : 1;
+			int t1 = (c1 > 0.0f) ? 2 : (c1 < 0.0f) ? 0 : 1;
+			int t2 = (c2 > 0.0f) ? 2 : (c2 < 0.0f) ? 0 : 1;
+			int t3 = (c3 > 0.0f) ? 2 : (c3 < 0.0f) ? 0 : 1;
+
+			cnt[j] = 5 - (t0 == 1) - (t1 == 1) - (t2 == 1) - (t3 == 1);
+
+			idTTT[j] = t0 * 27 + t1 * 9 + t2 * 3 + t3;
+
+		}
+
+		/// [3] Order vertices (ternary truth table lookup; with
+		///   incremental, tests as the known class give its known order)
+		for (j = 0; j < n; ++j)
+			for (k = 0; k < 4; ++k) {
+				unsigned v = order_table[ idTTT[j] ][k];
+				ox[k][j] = x[v][j]; oy[k][j] = y[v][j]; oz[k][j] = z[v][j]; os[k][j] = s[v][j];
+			}
+
+		/// [4] Line intersection, thick vertex, thickness and scalars
+		///   (every case computed, then selected by the count)
+		for (j = 0; j < n; ++j) {
+
+			float den = ( (oy[3][j] - oy[1][j]) * (ox[2][j] - ox[0][j]) ) -
+				( (ox[3][j] - ox[1][j]) * (oy[2][j] - oy[0][j]) );
+			float numU1 = ( (ox[3][j] - ox[1][j]) * (oy[0][j] - oy[1][j]) ) -
+				( (oy[3][j] - oy[1][j]) * (ox[0][j] - ox[1][j]) );
+			float numU2 = ( (ox[2][j] - ox[0][j]) * (oy[0][j] - oy[1][j]) ) -
+				( (oy[2][j] - oy[0][j]) * (ox[0][j] - ox[1][j]) );
+
+			float c = cnt[j];
+
+			float u1 = (c < 4.5f) ? 1.0f : numU1 / den;
+			float u2 = (c < 3.5f) ? 1.0f : numU2 / den;
+
+			float zBack = oz[1][j] + u2 * (oz[3][j] - oz[1][j]);
+
+			float ix = ox[0][j] + u1 * (ox[2][j] - ox[0][j]);
+			float iy = oy[0][j] + u1 * (oy[2][j] - oy[0][j]);
+			float iz = oz[0][j] + u1 * (oz[2][j] - oz[0][j]);
+
+			float thickness = (c < 3.5f) ? oz[0][j] - oz[1][j] :
+				(c < 4.5f) ? oz[2][j] - zBack : iz - zBack;
+
+			/// Class 2 (count 6) when the intersection is inside v0->v2
+			float uc = (c > 4.5f) ? u1 : 0.0f;
+
+			float tOut = thickness / u1, uOut = 1.0f / u1;
+
+			thickness = (uc > 1.0f) ? tOut : thickness;
+			u1 = (uc > 1.0f) ? uOut : u1;
+			c = (c < 4.5f) ? c : (uc > 1.0f) ? 5.0f : 6.0f;
+
+			float sBack = os[1][j] + u2 * (os[3][j] - os[1][j]);
+			float sInt = os[0][j] + u1 * (os[2][j] - os[0][j]);
+			float sMix = os[0][j] + (sBack - os[0][j]) * u1;
+
+			/// Count below 3 is discarded by the shader
+			pX[j] = (c > 4.5f) ? ix : 0.0f;
+			pY[j] = (c > 4.5f) ? iy : 0.0f;
+			sF[j] = (c < 2.5f) ? 0.0f : (c > 5.5f) ? sInt : (c < 3.5f) ? os[0][j] : os[2][j];
+			sB[j] = (c < 2.5f) ? 0.0f : (c > 5.5f) ? sBack : (c > 4.5f) ? sMix : (c > 3.5f) ? sBack : os[1][j];
+			th[j] = (c < 2.5f) ? 0.0f : fabsf(thickness);
+			ct[j] = c;
+
+		}
+
+		/// [5] Pack in half floats (vectorized), TTT index and count in
+		///   one channel: idTTT | count << 7
+		for (j = 0; j < n; ++j)
+			ct[j] = idTTT[j] + ct[j] * 128.0f;
+
+		/// With incremental, a tetrahedron is reclassified when its
+		///   class differs from the known one: a changed test, or
+		///   the intersection leaving (entering) v0->v2 (count 5 or 6)
+		for (j = 0; j < n; ++j) {
+
+			unsigned t = first + j;
+			unsigned short code = (unsigned short)ct[j];
+
+			write[j] = !incremental || code != codes[t];
+
+			if (incremental && write[j]) {
+				codes[t] = code;
+				changed[first + m++] = t;
+			}
+
+		}
+
+		unsigned short h[7][PTCPU_BLOCK];
+		const float *f[7] = { pX, pY, cZ, ct, sF, sB, th };
+
+		for (k = 0; k < 7; ++k)
+			halfFloat::pack(f[k], h[k], n);
+
+		/// [6] Write back the two outputs
+		for (j = 0; j < n; ++j) {
+
+			unsigned t = first + j;
+
+			for (k = 0; k < 3; ++k)
+				out0[t*4 + k] = h[k][j];
+
+			if (write[j]) out0[t*4 + 3] = h[3][j];
+
+			for (k = 0; k < 3; ++k)
+				out1[t*3 + k] = h[4 + k][j];
+
+		}
+
+		return m;
+
+	}
+
+	unsigned numTets; ///< Number of tetrahedra
+
+	std::vector< float > vx, vy, vz, vs; ///< Vertex coordinates and scalars
+	std::vector< float > px, py, pz; ///< Projected vertices (screen x, y and eye Z)
+	std::vector< unsigned > tets; ///< Tetrahedra vertex ids (4 per tetrahedron)
+	std::vector< unsigned > blocks; ///< Blocks of the last first step ( [ first, end ) pairs )
+
+	std::vector< unsigned short > codes; ///< Known class of each tetrahedron: idTTT | count << 7 (0xffff none)
+	std::vector< unsigned > changed; ///< Reclassified tetrahedra of the last first step
+	std::vector< unsigned > blockChanged; ///< Reclassified tetrahedra of each block
+	unsigned numChanged; ///< Number of reclassified tetrahedra
+
+	bool incremental; ///< Keep the classes between first steps
+
+};
+
+#endif
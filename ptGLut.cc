@@ -44,6 +44,13 @@ static GLdouble zoom = 1.0;
 
 static frameType volumeFrame = firstStill; ///< Volume frame status
 static bool fullSorting = true; ///< Do full sorting always
+static bool cpuDepthKeys = false; ///< Sort on CPU depth keys, overlapping the first step
+static bool cpuFirstStep = false; ///< Run the first step in CPU
+static GLuint readbackRing = 0; ///< First step readback ring (0 is synchronous)
+static bool incrementalSetup = false; ///< Rebuild only the fans of reclassified tetrahedra
+static bool cullVolume = false; ///< Cull the clusters outside the view volume
+static bool auditSort = false; ///< Count the visibility errors of each sort
+static sortType fullSortMethod = centroid; ///< Full sorting method
 
 static bool alwaysRotating = false; ///< Always rotating state
 
@@ -51,7 +58,7 @@ static bool whiteBG = true; ///< Back ground color
 static bool drawWire = false; ///< Draw volume wireframe
 
 static GLdouble firstStepTime = 0.0, sortTime = 0.0, setupArraysTime = 0.0,
-	secondStepTime = 0.0, totalTime = 0.0; ///< Time spent in each step
+	secondStepTime = 0.0, totalTime = 0.0, auditTime = 0.0, cullTime = 0.0; ///< Time spent in each step
 
 static bool showHelp = false; ///< show help flag
 static bool showInfo = true; ///< show information flag
@@ -75,13 +82,37 @@ void glPTShowInfo(void) {
 
 		char str[256];
 
-		sprintf(str, "First Step: %.5lf s ( %.2lf %% )", firstStepTime, 100*firstStepTime / totalTime );
+		sprintf(str, "First Step%s: %.5lf s ( %.2lf %% )", (cpuFirstStep) ? " (cpu)" : (cpuDepthKeys) ? " (cpu keys)" : "",
+			firstStepTime, 100*firstStepTime / totalTime );
 		glWrite(-1.1, 0.9, str);
 
-		sprintf(str, "Sort: %.5lf s ( %.5lf %% )", sortTime, 100*sortTime / totalTime );
+		if (app.getSortMethod() == mpvonc)
+			sprintf(str, "Sort (%s, %d in cycles): %.5lf s ( %.5lf %% )", sortTypeName[ app.getSortMethod() ],
+				app.getCycleTets(), sortTime, 100*sortTime / totalTime );
+		else if (app.getSortMethod() == bucket)
+			sprintf(str, "Sort (%s, %d buckets): %.5lf s ( %.5lf %% )", sortTypeName[ app.getSortMethod() ],
+				app.getSortBuckets(), sortTime, 100*sortTime / totalTime );
+		else if (app.getSortMethod() == quantized)
+			sprintf(str, "Sort (%s, %d runs refined): %.5lf s ( %.5lf %% )", sortTypeName[ app.getSortMethod() ],
+				app.getSortRefined(), sortTime, 100*sortTime / totalTime );
+		else if (app.getSortMethod() == cluster)
+			sprintf(str, "Sort (%s, %d clusters, %d re-sorted): %.5lf s ( %.5lf %% )", sortTypeName[ app.getSortMethod() ],
+				app.getSortClusters(), app.getSortResorted(), sortTime, 100*sortTime / totalTime );
+		else if (app.getSortMethod() == incremental && app.getSortFull())
+			sprintf(str, "Sort (%s, full): %.5lf s ( %.5lf %% )", sortTypeName[ app.getSortMethod() ],
+				sortTime, 100*sortTime / totalTime );
+		else if (app.getSortMethod() == incremental || app.getSortMethod() == cached)
+			sprintf(str, "Sort (%s, %lu swaps): %.5lf s ( %.5lf %% )", sortTypeName[ app.getSortMethod() ],
+				app.getSortSwaps(), sortTime, 100*sortTime / totalTime );
+		else
+			sprintf(str, "Sort (%s): %.5lf s ( %.5lf %% )", sortTypeName[ app.getSortMethod() ], sortTime, 100*sortTime / totalTime );
 		glWrite(-1.1, 0.8, str);
 
-		sprintf(str, "Setup Arrays: %.5lf s ( %.2lf %% )", setupArraysTime, 100*setupArraysTime / totalTime );
+		if (incrementalSetup)
+			sprintf(str, "Setup Arrays (%d fans rebuilt): %.5lf s ( %.2lf %% )", app.getReclassified(),
+				setupArraysTime, 100*setupArraysTime / totalTime );
+		else
+			sprintf(str, "Setup Arrays: %.5lf s ( %.2lf %% )", setupArraysTime, 100*setupArraysTime / totalTime );
 		glWrite(-1.1, 0.7, str);
 
 		sprintf(str, "Second Step: %.5lf s ( %.2lf %% )", secondStepTime, 100*secondStepTime / totalTime );
@@ -90,7 +121,32 @@ void glPTShowInfo(void) {
 		sprintf(str, "# Tets / sec: %.5lf MTet/s ( %.2lf fps )", (app.volume.numTets / totalTime) / 1000000.0, 1.0 / totalTime );
 		glWrite(-1.1, 0.5, str);
 
-		sprintf(str, "# Tets: %d", app.volume.numTets );
+		if (!cpuFirstStep) {
+			if (readbackRing > 1)
+				sprintf(str, "Readback (ring of %d, %d frames behind): %.5lf s stall", readbackRing,
+					readbackRing - 1, app.getReadbackStall() );
+			else
+				sprintf(str, "Readback (sync): %.5lf s stall", app.getReadbackStall() );
+			glWrite(-1.1, 0.3, str);
+		}
+
+		if (cullVolume) {
+			sprintf(str, "Cull: %d of %d tets in view ( %.2lf %% ): %.5lf s", app.getDrawnTets(), app.volume.numTets,
+				100.0 * app.getDrawnTets() / app.volume.numTets, cullTime );
+			glWrite(-1.1, 0.2, str);
+		}
+
+		if (auditSort) {
+			sprintf(str, "Audit: %lu of %lu faces violated ( %.4lf %% ) in %.5lf s", app.getAuditViolations(),
+				app.getAuditFaces(), 100.0 * app.getAuditViolations() / ( (app.getAuditFaces()) ? app.getAuditFaces() : 1 ),
+				auditTime );
+			glWrite(-1.1, 0.4, str);
+		}
+
+		if (cullVolume)
+			sprintf(str, "# Tets: %d ( %d in view )", app.volume.numTets, app.getDrawnTets() );
+		else
+			sprintf(str, "# Tets: %d", app.volume.numTets );
 		glWrite(-1.1, -0.5, str);
 
 		sprintf(str, "# Verts: %d", app.volume.numVerts );
@@ -117,12 +173,51 @@ void glPTShowInfo(void) {
 		glWrite(-0.52, -0.1, "(r) always rotating mode");
 		glWrite(-0.52, -0.2, "(s) show/close timing information");
 		glWrite(-0.52, -0.3, "(t) open transfer function window");
-		glWrite(-0.52, -0.4, "(q|esc) close application");
+		glWrite(-0.52, -0.4, "(o) cycle full sorting method");
+		glWrite(-0.52, -0.5, "(d) dump centroid depth keys");
+		glWrite(-0.52, -0.6, "(c) sort on CPU depth keys");
+		glWrite(-0.52, -0.7, "(a) audit sort visibility errors");
+		glWrite(-0.52, -0.8, "(p) run first step on CPU");
+		glWrite(-0.52, -0.9, "(g) cycle readback ring 0 / 2 / 3");
+		glWrite(-0.52, -1.0, "(i) rebuild only reclassified fans");
+		glWrite(-0.52, -1.1, "(v) cull clusters outside the view");
+		glWrite( 0.48, -1.1, "(q|esc) close application");
 
 	}
 
 }
 
+/// glPT First Step and Sort
+///   The cull gives the active tetrahedra of the view for all the
+///   next steps.  With CPU depth keys the sort runs between issuing
+///   the first step and reading it back, while the GPU works.  The
+///   audit (if on) is timed apart from the sort
+
+void glPTFirstStepAndSort(sortType sT) {
+
+	app.cull(cullTime);
+
+	if (cpuDepthKeys) {
+
+		GLdouble readTime;
+
+		app.firstStepDraw(firstStepTime);
+		app.sort(sortTime, sT);
+		app.firstStepRead(readTime);
+
+		firstStepTime += readTime;
+
+	} else {
+
+		app.firstStep(firstStepTime);
+		app.sort(sortTime, sT);
+
+	}
+
+	if (auditSort) app.audit(auditTime);
+
+}
+
 /// glPT Display
 
 void glPTDisplay(void) {
@@ -143,7 +238,7 @@ void glPTDisplay(void) {
 	}
 
 	/// Clear time
-	firstStepTime = 0.0; sortTime = 0.0;
+	firstStepTime = 0.0; sortTime = 0.0; cullTime = 0.0;
 	setupArraysTime = 0.0; secondStepTime = 0.0;
 
 	gettimeofday(&starttime, 0);
@@ -158,15 +253,15 @@ void glPTDisplay(void) {
 
 	if (volumeFrame == rotating) {
 
-		app.firstStep(firstStepTime);
-		if( fullSorting ) app.sort(sortTime, centroid);
-		else app.sort(sortTime, bucket);
+		glPTFirstStepAndSort( (fullSorting) ? fullSortMethod : bucket );
 		app.setupAndReorderArrays(setupArraysTime);
 
 	} else if (volumeFrame == firstStill) {
 
-		app.firstStep(firstStepTime);
-		app.sort(sortTime, centroid);
+		/// The still frame is read back without lag
+		app.restartReadback();
+
+		glPTFirstStepAndSort(fullSortMethod);
 		app.setupAndReorderArrays(setupArraysTime);
 
 		volumeFrame = still;
@@ -184,7 +279,7 @@ void glPTDisplay(void) {
 	gettimeofday(&endtime, 0);
 	totalTime = (endtime.tv_sec - starttime.tv_sec) + (endtime.tv_usec - starttime.tv_usec)/1000000.0;
 
-	secondStepTime = totalTime - (firstStepTime + sortTime + setupArraysTime);
+	secondStepTime = totalTime - (cullTime + firstStepTime + sortTime + setupArraysTime);
 
 }
 
@@ -216,6 +311,50 @@ void glPTKeyboard( unsigned char key, int x, int y ) {
 	case 'f': case 'F': // full sorting
 		fullSorting = !fullSorting;
 		break;
+	case 'o': case 'O': // cycle full sorting method
+		fullSortMethod = (fullSortMethod == centroid) ? radix :
+			(fullSortMethod == radix) ? quantized :
+			(fullSortMethod == quantized) ? cluster :
+			(fullSortMethod == cluster) ? mpvonc :
+			(fullSortMethod == mpvonc) ? incremental :
+			(fullSortMethod == incremental && app.viewOrders.directions() > 0) ? cached : centroid;
+		volumeFrame = (alwaysRotating) ? rotating : firstStill;
+		break;
+	case 'a': case 'A': // audit sort
+		auditSort = !auditSort;
+		volumeFrame = (alwaysRotating) ? rotating : firstStill;
+		break;
+	case 'c': case 'C': // CPU depth keys
+		cpuDepthKeys = !cpuDepthKeys;
+		app.setCpuDepthKeys(cpuDepthKeys);
+		volumeFrame = (alwaysRotating) ? rotating : firstStill;
+		break;
+	case 'p': case 'P': // CPU first step
+		cpuFirstStep = !cpuFirstStep;
+		app.setCpuFirstStep(cpuFirstStep);
+		volumeFrame = (alwaysRotating) ? rotating : firstStill;
+		break;
+	case 'g': case 'G': // readback ring
+		readbackRing = (readbackRing == 0) ? 2 : (readbackRing < READBACK_RING_MAX) ? readbackRing + 1 : 0;
+		app.setReadbackRing(readbackRing);
+		volumeFrame = (alwaysRotating) ? rotating : firstStill;
+		break;
+	case 'i': case 'I': // incremental setup
+		incrementalSetup = !incrementalSetup;
+		app.setIncrementalSetup(incrementalSetup);
+		volumeFrame = (alwaysRotating) ? rotating : firstStill;
+		break;
+	case 'v': case 'V': // frustum culling
+		cullVolume = !cullVolume;
+		app.setCullVolume(cullVolume);
+		volumeFrame = (alwaysRotating) ? rotating : firstStill;
+		break;
+	case 'd': case 'D': // dump depth keys
+		if (app.dumpDepthKeys( (app.volName + ".z").c_str() ))
+			cerr << "Depth keys written to " << app.volName << ".z" << endl;
+		else
+			cerr << "Cannot write depth keys to " << app.volName << ".z" << endl;
+		return;
 	case 'w': case 'W': // wireframe
 		drawWire = !drawWire;
 		break;
@@ -366,6 +505,14 @@ void glPTSetup(void) {
 	glutAddMenuEntry("[r] Rotate always", 'r');
 	glutAddMenuEntry("[s] Show/close timing information", 's');
 	glutAddMenuEntry("[t] Open TF window", 't');
+	glutAddMenuEntry("[o] Cycle full sorting method", 'o');
+	glutAddMenuEntry("[d] Dump depth keys", 'd');
+	glutAddMenuEntry("[c] Sort on CPU depth keys", 'c');
+	glutAddMenuEntry("[a] Audit sort visibility errors", 'a');
+	glutAddMenuEntry("[p] Run first step on CPU", 'p');
+	glutAddMenuEntry("[g] Cycle readback ring", 'g');
+	glutAddMenuEntry("[i] Rebuild only reclassified fans", 'i');
+	glutAddMenuEntry("[v] Cull clusters outside the view", 'v');
 	glutAddMenuEntry("[q] Quit", 'q');
 	glutAttachMenu(GLUT_RIGHT_BUTTON);
 
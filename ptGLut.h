@@ -32,6 +32,10 @@ void glWrite(GLdouble x, GLdouble y, const char *str);
 /// glPT Show Information boxes
 void glPTShowInfo(void);
 
+/// glPT First Step and Sort
+/// @arg sT sort method
+void glPTFirstStepAndSort(sortType sT);
+
 /// glPT Display
 void glPTDisplay(void);
 
@@ -0,0 +1,218 @@
+/**
+ *
+ *    PTINT -- Projected Tetrahedra with Partial Pre-Integration
+ *
+ **/
+
+/**
+ *   Ring Check : compare the first step readback ring with the
+ *                synchronous readback, offscreen through EGL (runs
+ *                under Mesa's software renderer, llvmpipe)
+ *
+ * C++ code.
+ *
+ */
+
+/// ----------------------------------   Definitions   ------------------------------------
+
+#include <cstring>
+
+#include <vector>
+
+#include "ptVol.h"
+
+#include <EGL/egl.h>
+
+#define CHECK_FRAMES 40 ///< Frames of the view sequence
+#define CHECK_SIZE 512 ///< Pixel buffer width and height
+
+using std::vector;
+using std::cerr;
+
+typedef vector< GLhalfARB > frameRecords; ///< Records of one frame (output buffers 0 and 1)
+
+/// -----------------------------------   Functions   -------------------------------------
+
+/// EGL Setup
+///   Make current an OpenGL context on a pixel buffer surface (no
+///   window system needed, e.g. EGL_PLATFORM=surfaceless)
+/// @return true if it succeed
+static bool eglSetup(void) {
+
+	EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+	EGLint major, minor;
+
+	if ( display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor) ) return false;
+
+	if ( !eglBindAPI(EGL_OPENGL_API) ) return false;
+
+	EGLint configAttribs[] = { EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+				   EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+
+	EGLConfig config;
+	EGLint numConfigs;
+
+	if ( !eglChooseConfig(display, configAttribs, &config, 1, &numConfigs) || numConfigs < 1 ) return false;
+
+	EGLint surfaceAttribs[] = { EGL_WIDTH, CHECK_SIZE, EGL_HEIGHT, CHECK_SIZE, EGL_NONE };
+
+	EGLSurface surface = eglCreatePbufferSurface(display, config, surfaceAttribs);
+
+	EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, NULL);
+
+	if ( surface == EGL_NO_SURFACE || context == EGL_NO_CONTEXT ) return false;
+
+	return eglMakeCurrent(display, surface, surface, context);
+
+}
+
+/// Set View
+///   Zoom in towards the center for the first half of the frames,
+///   then pan across the volume (the active set shrinks, then new
+///   clusters enter the view)
+/// @arg f frame
+static void setView(GLuint f) {
+
+	GLuint half = CHECK_FRAMES / 2;
+
+	GLfloat zoom = (f < half) ? 8.0 - 7.0 * f / (half - 1) : 1.0 + 3.0 * (f - half) / (half - 1);
+	GLfloat pan = (f < half) ? 0.0 : 0.08 * (f - half) - 0.8;
+
+	glMatrixMode(GL_PROJECTION);
+	glLoadIdentity();
+	glOrtho(-1.2, 1.2, -1.2, 1.2, -1.2, 1.2);
+
+	glMatrixMode(GL_MODELVIEW);
+	glLoadIdentity();
+	glTranslatef(pan, 0.0, 0.0);
+	glRotatef(30.0 + 0.5 * f, 1.0, 0.0, 0.0);
+	glRotatef(30.0 + 1.0 * f, 0.0, 1.0, 0.0);
+	glScalef(zoom, zoom, zoom);
+
+}
+
+/// Stale Records
+///   Compare the records of the drawn tetrahedra with the ones of
+///   the same frame read synchronously
+/// @arg vol volume read through the ring
+/// @arg ref synchronous records of the frame vol has loaded
+/// @return number of tetrahedra whose records differ
+static GLuint staleRecords(const ptVol& vol, const frameRecords& ref) {
+
+	const GLhalfARB *out0 = vol.getOutputBuffer0(), *out1 = vol.getOutputBuffer1();
+	const GLhalfARB *ref0 = &ref[0], *ref1 = &ref[vol.volume.numTets * 4];
+
+	GLuint stale = 0;
+
+	for (GLuint t = 0; t < vol.volume.numTets; ++t) {
+
+		if ( !vol.isDrawn(t) ) continue;
+
+		if ( memcmp(out0 + t*4, ref0 + t*4, 4 * sizeof(GLhalfARB)) != 0 ||
+		     memcmp(out1 + t*3, ref1 + t*3, 3 * sizeof(GLhalfARB)) != 0 ) ++stale;
+
+	}
+
+	return stale;
+
+}
+
+/// Main
+
+int main(int argc, char** argv) {
+
+	if ( !eglSetup() ) {
+
+		cerr << "Unable to create an EGL pixel buffer context" << endl;
+		return 1;
+
+	}
+
+	/// One volume read synchronously (reference) and one per ring size
+	ptVol ref(false), ring2(false), ring3(false);
+	ptVol* rings[2] = { &ring2, &ring3 };
+
+	int argcRef = argc, argc2 = argc, argc3 = argc;
+
+	if ( !ref.setup(argcRef, argv) || !ring2.setup(argc2, argv) || !ring3.setup(argc3, argv) )
+		return 1;
+
+	/// Same projection as the view (see setView)
+	ref.setOrtho(-1.2, 1.2);
+	ring2.setOrtho(-1.2, 1.2);
+	ring3.setOrtho(-1.2, 1.2);
+
+	if ( !ref.glSetup() || !ring2.glSetup() || !ring3.glSetup() )
+		return 1;
+
+	for (GLuint r = 0; r < 2; ++r) {
+
+		rings[r]->setReadbackRing(r + 2);
+		rings[r]->setCullVolume(true);
+
+	}
+
+	GLuint numTets = ref.volume.numTets;
+
+	vector< frameRecords > records;
+
+	GLuint totalStale[2] = { 0, 0 }, restarts[2] = { 0, 0 };
+
+	cout << "Ring check : " << numTets << " tetrahedra, " << CHECK_FRAMES << " frames" << endl << endl;
+
+	for (GLuint f = 0; f < CHECK_FRAMES; ++f) {
+
+		setView(f);
+
+		ref.cull();
+		ref.firstStep();
+
+		records.push_back( frameRecords(ref.getOutputBuffer0(), ref.getOutputBuffer0() + numTets * 4) );
+		records.back().insert( records.back().end(), ref.getOutputBuffer1(), ref.getOutputBuffer1() + numTets * 3 );
+
+		for (GLuint r = 0; r < 2; ++r) {
+
+			rings[r]->cull();
+			rings[r]->firstStep();
+
+			/// The ring falls back to the synchronous readback without PBOs
+			if (rings[r]->getReadbackRing() != r + 2) {
+
+				cerr << "No pixel buffer objects: the ring can not be checked" << endl;
+				return 1;
+
+			}
+
+			GLuint lag = rings[r]->getReadbackLag();
+
+			if (lag == 0 && f > 0) ++restarts[r];
+
+			GLuint stale = staleRecords(*rings[r], records[f - lag]);
+
+			totalStale[r] += stale;
+
+			if (stale)
+				cout << "  ring " << r + 2 << " frame " << f << " (lag " << lag << ") : "
+				     << stale << " of " << rings[r]->getDrawnTets() << " drawn tets stale" << endl;
+
+		}
+
+	}
+
+	bool ok = true;
+
+	for (GLuint r = 0; r < 2; ++r) {
+
+		cout << "  ring " << r + 2 << " : " << totalStale[r] << " stale records, "
+		     << restarts[r] << " restarts" << endl;
+
+		if (totalStale[r]) ok = false;
+
+	}
+
+	cout << endl << ( (ok) ? "Ring check passed" : "Ring check FAILED" ) << endl;
+
+	return (ok) ? 0 : 1;
+
+}
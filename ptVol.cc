@@ -19,6 +19,8 @@
 
 /// --------------------------------   Definitions   ------------------------------------
 
+#include <cstdio>
+#include <cstring>
 #include <iomanip>
 #include <iostream>
 
@@ -31,14 +33,14 @@ using std::cerr;
 
 #include "tables.h"
 
+#include "halfFloat.h"
+
 #include "psiGammaTable512.h"
 
 #define TEX_FORMAT GL_TEXTURE_2D
 #define TEX_TYPE_32 GL_RGBA32F_ARB
 #define TEX_TYPE_16 GL_RGBA16F_ARB
 
-#define NUM_LAYERS 100 ///< Layers for bucket sorting
-
 /// ----------------------------------   ptVol   ------------------------------------
 
 /// Constructor
@@ -46,8 +48,10 @@ ptVol::ptVol( bool _d ) :
 	appVol(_d),
 	firstStepShader(NULL), secondStepShader(NULL),
 	vertexArray(NULL), colorArray(NULL),
-	indices(NULL), count(NULL), ids(NULL),
-	centroidSorted(NULL), centroidBucket(NULL),
+	indices(NULL), count(NULL), fanCount(NULL),
+	fanCode(NULL), ids(NULL),
+	centroidSorted(NULL),
+	depthKeys(NULL), sortedIds(NULL),
 	outputBuffer0(NULL), outputBuffer1(NULL),
 	frameBuffer(0),
 	tetOutputTex0(0), tetOutputTex1(0),
@@ -55,10 +59,20 @@ ptVol::ptVol( bool _d ) :
 	orderTableTex(0), tfTex(0),
 	psiGammaTableTex(0),
 	vertTexSize(0), tetTexSize(0),
+	readbackRing(0), readbackFrame(0), readbackNext(0), readbackStall(0.0),
 	backGround(WHITE),
 	minOrthoSize(-1.0), maxOrthoSize(1.0),
 	winWidth(512), winHeight(512),
-	sortMethod(none) {
+	sortMethod(none), cachedDir(-1), cpuDepthKeys(false), cpuFirstStep(false),
+	incrementalSetup(false), numReclassified(0),
+	cullVolume(false), culled(false), numDrawn(0) {
+
+	for (GLuint i = 0; i < READBACK_RING_MAX; ++i) {
+
+		readbackPBO[i][0] = readbackPBO[i][1] = 0;
+		readbackFence[i] = 0;
+
+	}
 
 }
 
@@ -76,16 +90,15 @@ ptVol::~ptVol() {
 			if (indices[i]) delete [] indices[i];
 
 	if (count) delete [] count;
+	if (fanCount) delete [] fanCount;
+	if (fanCode) delete [] fanCode;
 
 	if (ids) delete [] ids;
 
 	if (centroidSorted) delete [] centroidSorted;
 
-	if (centroidBucket) {
-		for (GLuint i = 0; i < NUM_LAYERS; ++i)
-			centroidBucket[i].clear();
-		delete [] centroidBucket;
-	}
+	if (depthKeys) delete [] depthKeys;
+	if (sortedIds) delete [] sortedIds;
 
 	if (outputBuffer0) delete [] outputBuffer0;
 	if (outputBuffer1) delete [] outputBuffer1;
@@ -99,6 +112,10 @@ ptVol::~ptVol() {
 	glDeleteTextures(1, &tfTex);
 	glDeleteTextures(1, &psiGammaTableTex);
 
+	restartReadback();
+
+	if (readbackPBO[0][0]) glDeleteBuffersARB(READBACK_RING_MAX * 2, &readbackPBO[0][0]);
+
 }
 
 /// OpenGL Setup
@@ -115,6 +132,9 @@ bool ptVol::glSetup() {
 		/// Background color
 		glClearColor(backGround.r(), backGround.g(), backGround.b(), 0.0f);
 
+		/// Output buffer 1 rows (3 halves per texel) are 2-byte aligned
+		glPixelStorei(GL_PACK_ALIGNMENT, 2);
+
 		/// Vertices and Tetrahedra textures size
 		vertTexSize = (GLuint)ceil(sqrt(volume.numVerts));
 		tetTexSize = (GLuint)ceil(sqrt(volume.numTets));
@@ -128,6 +148,8 @@ bool ptVol::glSetup() {
 
 		if (!createBuffers()) throw errHandle(memoryErr);
 
+		numDrawn = volume.numTets;
+
 		createTextures();
 
 		if (!createShaders()) throw errHandle(genericErr, "GLSL Error!");
@@ -160,11 +182,22 @@ int ptVol::sizeOf(void) {
 		 ( (colorArray) ? volume.numTets * 3 * 5 * sizeof(GLfloat) : 0 ) + ///< Color Array
 		 ( (indices) ? volume.numTets * 6 * sizeof(GLuint) : 0 ) + ///< Indices
 		 ( (count) ? volume.numTets * sizeof(GLint) : 0 ) + ///< Count
+		 ( (fanCount) ? volume.numTets * sizeof(GLint) : 0 ) + ///< Fan count
+		 ( (fanCode) ? volume.numTets * sizeof(GLhalfARB) : 0 ) + ///< Fan class
 		 ( (ids) ? volume.numTets * sizeof(int) : 0 ) + ///< Ids (pointers)
 		 ( (centroidSorted) ? volume.numTets * sizeof(tetCentroid) : 0 ) + ///< Tet Centroids
-		 ( (centroidBucket) ? volume.numTets * sizeof(GLuint) : 0 ) + ///< Tet ids per bucket
-		 ( (outputBuffer0) ? tetTexSize * tetTexSize * 4 * sizeof(GLfloat) : 0 ) + ///< Output Buffer 0
-		 ( (outputBuffer1) ? tetTexSize * tetTexSize * 4 * sizeof(GLfloat) : 0 ) + ///< Output Buffer 1
+		 ( (depthKeys) ? volume.numTets * sizeof(GLfloat) : 0 ) + ///< Depth keys
+		 ( (sortedIds) ? volume.numTets * sizeof(GLuint) : 0 ) + ///< Sorted ids
+		 radixSorter.sizeOf() + ///< Radix, bucket and quantized buffers
+		 visSorter.sizeOf() + ///< Visibility sort buffers
+		 clusterSorter.sizeOf() + ///< Cluster sort buffers
+		 cpuKeys.sizeOf() + ///< CPU depth key centroids
+		 cpuFirst.sizeOf() + ///< CPU first step arrays
+		 culler.sizeOf() + ( culledIds.size() + activeKeys.size() ) * sizeof(GLuint) + ///< Culling arrays
+		 ( READBACK_RING_MAX + 1 ) * culler.clusters() + ///< Clusters drawn by the readbacks
+		 auditor.sizeOf() + auditOrder.size() * sizeof(GLuint) + ///< Sort audit buffers
+		 ( (outputBuffer0) ? tetTexSize * tetTexSize * 4 * sizeof(GLhalfARB) : 0 ) + ///< Output Buffer 0
+		 ( (outputBuffer1) ? tetTexSize * tetTexSize * 3 * sizeof(GLhalfARB) : 0 ) + ///< Output Buffer 1
 		 ( 10 * sizeof(GLuint) ) + ///< All GLuints
 		 ( 12 * sizeof(int) ) + ///< pointers
 		 ( PSI_GAMMA_SIZE_BACK * PSI_GAMMA_SIZE_FRONT * sizeof(float) ) ///< Psi Gamma Table
@@ -233,6 +266,14 @@ bool ptVol::createArrays(void) {
 	count = new GLint[nT];
 	if (!count) return false;
 
+	if (fanCount) delete [] fanCount;
+	fanCount = new GLint[nT];
+	if (!fanCount) return false;
+
+	if (fanCode) delete [] fanCode;
+	fanCode = new GLhalfARB[nT];
+	if (!fanCode) return false;
+
 	if (ids) delete [] ids;
 	ids = new GLvoid*[nT];
 	if (!ids) return false;
@@ -240,7 +281,8 @@ bool ptVol::createArrays(void) {
 	for (i = 0; i < nT; ++i) {
 
 		ids[i] = (GLvoid*)indices[i];
-		count[i] = 6; ///< Init with maximum value
+		count[i] = fanCount[i] = 6; ///< Init with maximum value
+		fanCode[i] = 0xffff; ///< No fan built yet
 
 	}
 
@@ -269,13 +311,19 @@ bool ptVol::createCentroidSorts(void) {
 
 	}
 
-	if (centroidBucket) {
-		for (GLuint i = 0; i < NUM_LAYERS; ++i)
-			centroidBucket[i].clear();
-		delete [] centroidBucket;
-	}
-	centroidBucket = new vector< GLuint >[ NUM_LAYERS ];
-	if (!centroidBucket) return false;
+	if (depthKeys) delete [] depthKeys;
+	depthKeys = new GLfloat[nT];
+	if (!depthKeys) return false;
+
+	if (sortedIds) delete [] sortedIds;
+	sortedIds = new GLuint[nT];
+	if (!sortedIds) return false;
+
+	for (i = 0; i < nT; ++i)
+		sortedIds[i] = i;
+
+	/// Centroids of the CPU depth keys
+	cpuKeys.build(volume);
 
 	return true;
 
@@ -285,13 +333,43 @@ bool ptVol::createCentroidSorts(void) {
 bool ptVol::createBuffers(void) {
 
 	if (outputBuffer0) delete [] outputBuffer0;
-	outputBuffer0 = new GLfloat[tetTexSize * tetTexSize * 4];
+	outputBuffer0 = new GLhalfARB[tetTexSize * tetTexSize * 4];
 	if (!outputBuffer0) return false;
 
 	if (outputBuffer1) delete [] outputBuffer1;
-	outputBuffer1 = new GLfloat[tetTexSize * tetTexSize * 4];
+	outputBuffer1 = new GLhalfARB[tetTexSize * tetTexSize * 3];
 	if (!outputBuffer1) return false;
 
+	/// Vertices and tetrahedra of the CPU first step
+	cpuFirst.build(volume);
+
+	/// Cluster bounding boxes of the culling
+	culler.build(volume);
+
+	return true;
+
+}
+
+/// Create Readback Buffers
+bool ptVol::createReadbackBuffers(void) {
+
+	GLsizeiptrARB texels = tetTexSize * tetTexSize, half = sizeof(GLhalfARB);
+	GLsizeiptrARB size[2] = { texels * 4 * half, texels * 3 * half };
+
+	glGenBuffersARB(READBACK_RING_MAX * 2, &readbackPBO[0][0]);
+
+	for (GLuint i = 0; i < READBACK_RING_MAX; ++i)
+		for (GLuint j = 0; j < 2; ++j) {
+
+			if (!readbackPBO[i][j]) return false;
+
+			glBindBufferARB(GL_PIXEL_PACK_BUFFER_ARB, readbackPBO[i][j]);
+			glBufferDataARB(GL_PIXEL_PACK_BUFFER_ARB, size[j], NULL, GL_STREAM_READ_ARB);
+
+		}
+
+	glBindBufferARB(GL_PIXEL_PACK_BUFFER_ARB, 0);
+
 	return true;
 
 }
@@ -457,13 +535,33 @@ void ptVol::drawQuad() {
 
 	glBegin(GL_QUADS);
 
-	glTexCoord2d(0.0, 0.0); glVertex2d(minOrthoSize, minOrthoSize);
+	if (culled) {
 
-	glTexCoord2d(1.0, 0.0); glVertex2d(maxOrthoSize, minOrthoSize);
-    
-	glTexCoord2d(1.0, 1.0); glVertex2d(maxOrthoSize, maxOrthoSize);
+		/// Each active range [ begin, end ) of tetrahedra ids covers
+		///   the end of one row, full rows and the start of another
+		const GLuint *ranges = culler.activeRanges();
+
+		for (GLuint r = 0; r < culler.rangeCount(); ++r) {
+
+			GLuint begin = ranges[r*2], last = ranges[r*2 + 1] - 1;
+			GLuint r0 = begin / tetTexSize, c0 = begin % tetTexSize;
+			GLuint r1 = last / tetTexSize, c1 = last % tetTexSize + 1;
 
-	glTexCoord2d(0.0, 1.0); glVertex2d(minOrthoSize, maxOrthoSize);
+			if (r0 == r1) drawRect(c0, r0, c1, r0 + 1);
+			else {
+
+				drawRect(c0, r0, tetTexSize, r0 + 1);
+
+				if (r1 > r0 + 1) drawRect(0, r0 + 1, tetTexSize, r1);
+
+				drawRect(0, r1, c1, r1 + 1);
+
+			}
+
+		}
+
+	} else
+		drawRect(0, 0, tetTexSize, tetTexSize);
 
 	glEnd();
 
@@ -471,10 +569,54 @@ void ptVol::drawQuad() {
 
 }
 
+/// Draw Rect
+void ptVol::drawRect(GLuint x0, GLuint y0, GLuint x1, GLuint y1) {
+
+	GLdouble s0 = x0 / (GLdouble)tetTexSize, t0 = y0 / (GLdouble)tetTexSize;
+	GLdouble s1 = x1 / (GLdouble)tetTexSize, t1 = y1 / (GLdouble)tetTexSize;
+	GLdouble size = maxOrthoSize - minOrthoSize;
+
+	glTexCoord2d(s0, t0); glVertex2d(minOrthoSize + s0 * size, minOrthoSize + t0 * size);
+
+	glTexCoord2d(s1, t0); glVertex2d(minOrthoSize + s1 * size, minOrthoSize + t0 * size);
+
+	glTexCoord2d(s1, t1); glVertex2d(minOrthoSize + s1 * size, minOrthoSize + t1 * size);
+
+	glTexCoord2d(s0, t1); glVertex2d(minOrthoSize + s0 * size, minOrthoSize + t1 * size);
+
+}
+
+/// Cull
+void ptVol::cull() {
+
+	culled = cullVolume && culler.clusters() > 0;
+
+	if (!culled) { numDrawn = volume.numTets; return; }
+
+	GLfloat mv[16], pj[16];
+
+	glGetFloatv(GL_MODELVIEW_MATRIX, mv);
+	glGetFloatv(GL_PROJECTION_MATRIX, pj);
+
+	numDrawn = culler.cull(mv, pj);
+
+}
+
 /// Run First Step
 void ptVol::firstStep() {
 
-	if (!firstStepShader) return;
+	firstStepDraw();
+
+	firstStepRead();
+
+}
+
+/// Draw First Step
+void ptVol::firstStepDraw() {
+
+	if (cpuFirstStep) { firstStepCPU(); return; }
+
+	if (!firstStepShader || (culled && numDrawn == 0)) return;
 
 	/// Create 2 output FBOs to return data from the first fragment shader
 	GLenum colorBuffers[2] = { GL_COLOR_ATTACHMENT0_EXT, GL_COLOR_ATTACHMENT1_EXT };
@@ -488,16 +630,203 @@ void ptVol::firstStep() {
 
 	firstStepShader->use(0);
 
-	/// Read back output FBOs data
+	/// Start the GPU without waiting for it
+	glFlush();
+
+	/// Bind back the framebuffer
+	glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
+
+}
+
+/// Read First Step
+void ptVol::firstStepRead() {
+
+	if (cpuFirstStep || !firstStepShader) return;
+
+	if (readbackRing > 1) { readRing(); return; }
+
+	static struct timeval starttime, endtime;
+	gettimeofday(&starttime, 0);
+
+	glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, frameBuffer);
+
+	/// Read back output FBOs data (half floats, without the unused
+	///   fourth channel of FBO 1)
 	glReadBuffer(GL_COLOR_ATTACHMENT0_EXT);
-	glReadPixels(0, 0, tetTexSize, tetTexSize, GL_RGBA, GL_FLOAT, outputBuffer0);
+	glReadPixels(0, 0, tetTexSize, tetTexSize, GL_RGBA, GL_HALF_FLOAT_ARB, outputBuffer0);
 
 	glReadBuffer(GL_COLOR_ATTACHMENT1_EXT);
-	glReadPixels(0, 0, tetTexSize, tetTexSize, GL_RGBA, GL_FLOAT, outputBuffer1);
+	glReadPixels(0, 0, tetTexSize, tetTexSize, GL_RGB, GL_HALF_FLOAT_ARB, outputBuffer1);
 
 	/// Bind back the framebuffer
 	glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
 
+	gettimeofday(&endtime, 0);
+	readbackStall = (endtime.tv_sec - starttime.tv_sec) + (endtime.tv_usec - starttime.tv_usec)/1000000.0;
+
+}
+
+/// Read First Step through the PBO ring
+void ptVol::readRing() {
+
+	if (!readbackPBO[0][0] && !createReadbackBuffers()) {
+
+		/// No PBOs: back to the synchronous readback
+		readbackRing = 0;
+		firstStepRead();
+		return;
+
+	}
+
+	/// Records of the frame read or kept below must cover the
+	///   tetrahedra active now
+	if (readbackFrame > 0) {
+
+		GLuint lag = readbackRing - 1;
+
+		const std::vector< GLubyte >& used = (readbackFrame < readbackNext + lag) ? loadedDrawn :
+			readbackDrawn[ (readbackFrame - lag) % readbackRing ];
+
+		if ( !coverActive(used) ) restartReadback();
+
+	}
+
+	/// Issue the copy of this frame to its PBOs (returns at once)
+	GLuint slot = readbackFrame % readbackRing;
+
+	drawnClusters(readbackDrawn[slot]);
+
+	glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, frameBuffer);
+
+	glBindBufferARB(GL_PIXEL_PACK_BUFFER_ARB, readbackPBO[slot][0]);
+	glReadBuffer(GL_COLOR_ATTACHMENT0_EXT);
+	glReadPixels(0, 0, tetTexSize, tetTexSize, GL_RGBA, GL_HALF_FLOAT_ARB, 0);
+
+	glBindBufferARB(GL_PIXEL_PACK_BUFFER_ARB, readbackPBO[slot][1]);
+	glReadBuffer(GL_COLOR_ATTACHMENT1_EXT);
+	glReadPixels(0, 0, tetTexSize, tetTexSize, GL_RGB, GL_HALF_FLOAT_ARB, 0);
+
+	if (readbackFence[slot]) glDeleteSync(readbackFence[slot]);
+	readbackFence[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
+
+	/// Frame to read: readbackRing - 1 frames behind, except the first
+	///   frame after a restart, read at once (the frames until the lag
+	///   is reached keep the output buffers of that first frame)
+	GLuint frame = readbackFrame++, lag = readbackRing - 1;
+
+	readbackStall = 0.0;
+
+	if (frame > 0) {
+
+		if (frame < readbackNext + lag) {
+
+			glBindBufferARB(GL_PIXEL_PACK_BUFFER_ARB, 0);
+			return;
+
+		}
+
+		frame -= lag;
+
+	}
+
+	slot = frame % readbackRing;
+
+	static struct timeval starttime, endtime;
+	gettimeofday(&starttime, 0);
+
+	/// Wait for the frame (already done unless the GPU is behind)
+	while (glClientWaitSync(readbackFence[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED) ;
+
+	glDeleteSync(readbackFence[slot]);
+	readbackFence[slot] = 0;
+
+	GLhalfARB *outputBuffer[2] = { outputBuffer0, outputBuffer1 };
+
+	for (GLuint j = 0; j < 2; ++j) {
+
+		glBindBufferARB(GL_PIXEL_PACK_BUFFER_ARB, readbackPBO[slot][j]);
+
+		GLvoid *data = glMapBufferARB(GL_PIXEL_PACK_BUFFER_ARB, GL_READ_ONLY_ARB);
+
+		if (data) {
+			memcpy(outputBuffer[j], data, tetTexSize * tetTexSize * (4 - j) * sizeof(GLhalfARB));
+			glUnmapBufferARB(GL_PIXEL_PACK_BUFFER_ARB);
+		}
+
+	}
+
+	glBindBufferARB(GL_PIXEL_PACK_BUFFER_ARB, 0);
+
+	loadedDrawn = readbackDrawn[slot];
+
+	readbackNext = frame + 1;
+
+	gettimeofday(&endtime, 0);
+	readbackStall = (endtime.tv_sec - starttime.tv_sec) + (endtime.tv_usec - starttime.tv_usec)/1000000.0;
+
+}
+
+/// Drawn Clusters
+void ptVol::drawnClusters(std::vector< GLubyte >& d) const {
+
+	d.resize( culler.clusters() );
+
+	for (GLuint c = 0; c < d.size(); ++c)
+		d[c] = (!culled || culler.isInside(c)) ? 1 : 0;
+
+}
+
+/// Cover Active
+bool ptVol::coverActive(const std::vector< GLubyte >& d) const {
+
+	if (d.size() != culler.clusters()) return false;
+
+	for (GLuint c = 0; c < d.size(); ++c)
+		if ( !d[c] && (!culled || culler.isInside(c)) ) return false;
+
+	return true;
+
+}
+
+/// Set Readback Ring
+void ptVol::setReadbackRing(GLuint _n) {
+
+	restartReadback();
+
+	readbackRing = (_n < 2) ? 0 : (_n > READBACK_RING_MAX) ? READBACK_RING_MAX : _n;
+
+}
+
+/// Restart Readback
+void ptVol::restartReadback() {
+
+	for (GLuint i = 0; i < READBACK_RING_MAX; ++i)
+		if (readbackFence[i]) {
+
+			glDeleteSync(readbackFence[i]);
+			readbackFence[i] = 0;
+
+		}
+
+	readbackFrame = readbackNext = 0;
+
+}
+
+/// Run First Step in CPU
+void ptVol::firstStepCPU() {
+
+	GLfloat mv[16], pj[16];
+
+	glGetFloatv(GL_MODELVIEW_MATRIX, mv);
+	glGetFloatv(GL_PROJECTION_MATRIX, pj);
+
+	if (!culled)
+		cpuFirst.firstStep(mv, pj, outputBuffer0, outputBuffer1);
+	else if (culler.rangeCount() > 0)
+		cpuFirst.firstStep(mv, pj, outputBuffer0, outputBuffer1, culler.activeRanges(), culler.rangeCount());
+
 }
 
 /// Sort
@@ -505,139 +834,373 @@ void ptVol::sort() {
 
 	GLuint nT = volume.numTets;
 
+	if (sortMethod == none) {
+
+		if (culled) culledIds.assign(culler.activeTets(), culler.activeTets() + numDrawn);
+
+		return;
+
+	}
+
+	loadDepthKeys();
+
+	/// Culled: the sorts on the depth keys only run over the active
+	///   tetrahedra
+	if (culled && (sortMethod == centroid || sortMethod == radix ||
+		       sortMethod == quantized || sortMethod == bucket)) {
+
+		sortActive();
+
+		return;
+
+	}
+
 	/// Switch to the selected sort method
 	if (sortMethod == centroid) {
 
-		/// Fill the centroid sorted array using the centroid Z computed
-		///   in the first step shader
+		/// Fill the centroid sorted array using the centroid Z keys
 		for (GLuint i = 0; i < nT; ++i) {
 
 			centroidSorted[i].id = i;
-			centroidSorted[i].cZ = outputBuffer0[i*4 + 2];
+			centroidSorted[i].cZ = depthKeys[i];
 
 		}
 
 		/// STL stable sort
 		std::sort( centroidSorted, centroidSorted + nT, less<tetCentroid>() );
 
+	} else if (sortMethod == radix) {
+
+		/// Parallel LSD radix sort on the same centroid Z keys, with
+		///   keys and ids in separate arrays
+		radixSorter.sort( depthKeys, sortedIds, nT );
+
+	} else if (sortMethod == quantized) {
+
+		/// One counting pass on 16-bit keys quantized in the depth range
+		///   of the frame, refining only the long runs of equal keys
+		radixSorter.quantSort( depthKeys, sortedIds, nT );
+
+	} else if (sortMethod == incremental) {
+
+		/// Repair the previous frame order (sortedIds) with the new keys,
+		///   falling back to the radix sort when it is too disordered
+		radixSorter.resort( depthKeys, sortedIds, nT );
+
+	} else if (sortMethod == cached) {
+
+		/// Start from the precomputed order of the nearest view direction
+		///   (or from the last frame order while it is the same direction)
+		///   and repair it with the new keys, moving each tetrahedron at
+		///   most VOC_REPAIR_WINDOW positions (approximate, bounded cost)
+		if (viewOrders.directions() > 0) {
+
+			GLfloat mv[16];
+			glGetFloatv(GL_MODELVIEW_MATRIX, mv);
+
+			GLfloat viewZ[3] = { mv[2], mv[6], mv[10] };
+
+			int d = viewOrders.nearest(viewZ);
+
+			if (d != cachedDir && viewOrders.order(d, sortedIds))
+				cachedDir = d;
+
+		}
+
+		radixSorter.repair( depthKeys, sortedIds, nT, VOC_REPAIR_WINDOW );
+
+	} else if (sortMethod == cluster) {
+
+		/// Two-level sort: clusters of consecutive (Morton ordered)
+		///   tetrahedra by mean centroid depth, then the tetrahedra of
+		///   each cluster from its last frame order, written in place
+		///   in the cluster output range
+		clusterSorter.sort( depthKeys, sortedIds, nT );
+
+	} else if (sortMethod == mpvonc) {
+
+		/// Meshed polyhedra visibility ordering (non-convex): topological
+		///   sort of the face adjacency graph, with the face directions
+		///   taken from the view axis of the current modelview
+		GLfloat mv[16];
+		glGetFloatv(GL_MODELVIEW_MATRIX, mv);
+
+		GLfloat viewZ[3] = { mv[2], mv[6], mv[10] };
+
+		if ( !visSorter.sort( volume, viewZ, depthKeys, sortedIds ) )
+			radixSorter.sort( depthKeys, sortedIds, nT );
+
 	} else if (sortMethod == bucket) {
 
-		/// Simple bucket sorting algorithm:
-		///   Divide the normalized volume in a fixed number of bucket layers,
-		///   put each tetrahedron in a layer that matches its centroid Z and
-		///   render the buckets in back-to-front order.
+		/// Bucket sorting algorithm:
+		///   Divide the centroid depth range in a number of buckets chosen
+		///   from the number of tetrahedra, and count sort them into
+		///   sortedIds in back-to-front order (one parallel pass).
 		/// Note: Inside the buckets the tetrahedra remain unsorted
+		radixSorter.bucketSort( depthKeys, sortedIds, nT );
 
-		GLuint bucket;
+	}
 
-		for (GLuint i = 0; i < NUM_LAYERS; ++i)
-			centroidBucket[i].clear();
+	/// Culled: the orders kept from frame to frame (or from the
+	///   connectivity) are of all tetrahedra, the active ones are
+	///   taken in that order
+	if (culled) {
 
-		for (GLuint i = 0; i < nT; ++i) {
+		culledIds.clear();
 
-			bucket = (GLuint)(outputBuffer0[i*4 + 2] + 1.0) * (GLuint)((NUM_LAYERS-1) * 0.5);
+		for (GLuint i = 0; i < nT; ++i)
+			if (culler.isActive( sortedIds[i] ))
+				culledIds.push_back( sortedIds[i] );
 
-			if (bucket < 0) bucket = 0;
-			if (bucket > NUM_LAYERS-1) bucket = NUM_LAYERS-1;
+	}
+
+}
+
+/// Sort Active
+void ptVol::sortActive() {
+
+	const GLuint *active = culler.activeTets();
+	long k, n = numDrawn;
 
-			centroidBucket[bucket].push_back(i);
+	activeKeys.resize(n);
+	culledIds.resize(n);
+
+	if (n == 0) return;
+
+#pragma omp parallel for
+	for (k = 0; k < n; ++k)
+		activeKeys[k] = depthKeys[ active[k] ];
+
+	if (sortMethod == centroid) {
+
+		for (k = 0; k < n; ++k) {
+
+			centroidSorted[k].id = active[k];
+			centroidSorted[k].cZ = activeKeys[k];
 
 		}
 
+		std::sort( centroidSorted, centroidSorted + n, less<tetCentroid>() );
+
+		for (k = 0; k < n; ++k)
+			culledIds[k] = centroidSorted[k].id;
+
+		return;
+
 	}
 
+	if (sortMethod == radix) radixSorter.sort( &activeKeys[0], &culledIds[0], n );
+	else if (sortMethod == quantized) radixSorter.quantSort( &activeKeys[0], &culledIds[0], n );
+	else radixSorter.bucketSort( &activeKeys[0], &culledIds[0], n );
+
+	/// Positions in the active list to tetrahedra ids
+#pragma omp parallel for
+	for (k = 0; k < n; ++k)
+		culledIds[k] = active[ culledIds[k] ];
+
 }
 
-/// Setup and Reorder Arrays
-void ptVol::setupAndReorderArrays() {
+/// Load Depth Keys
+void ptVol::loadDepthKeys() {
 
-	GLuint tetId = 0, currBucket = 0, idBucket = 0, idTTT, arrayId, indicesId, cnt;
+	GLuint nT = volume.numTets;
 
-	for(GLuint i = 0; i < volume.numTets; ++i) {
+	if (cpuDepthKeys && cpuKeys.size() == nT) {
 
-		/// Switch to the selected sort method
-		if (sortMethod == centroid) {
+		GLfloat mv[16];
+		glGetFloatv(GL_MODELVIEW_MATRIX, mv);
 
-			tetId = centroidSorted[i].id;
+		cpuKeys.compute(mv, depthKeys);
 
-		} else if (sortMethod == bucket) {
+	} else if (culled) {
 
-			if (currBucket >= NUM_LAYERS) return;
+		const GLuint *active = culler.activeTets();
+		long k;
 
-			while( centroidBucket[currBucket].size() <= idBucket ) {
+#pragma omp parallel for
+		for (k = 0; k < (long)numDrawn; ++k)
+			depthKeys[ active[k] ] = halfFloat::unpack( outputBuffer0[ active[k]*4 + 2 ] );
 
-				++currBucket;
-				idBucket = 0;
+	} else {
 
-			}
+		long i;
 
-			tetId = centroidBucket[currBucket][idBucket];
-			++idBucket;
+#pragma omp parallel for
+		for (i = 0; i < (long)nT; ++i)
+			depthKeys[i] = halfFloat::unpack( outputBuffer0[i*4 + 2] );
 
+	}
 
-		} else if (sortMethod == none) {
+}
 
-			tetId = i;
+/// Audit Sort
+bool ptVol::audit() {
 
-		}
+	GLuint nT = numDrawn;
 
-		/// indices array index: each tetrahedron have 5 associated vertices
-		indicesId = tetId * 5;
-	
-		/// Vertex and Color array index: each vertex/color have 4 components
-		arrayId = indicesId * 4;
+	if (nT == 0) return false;
 
-		/// Retrieve classification id (case 0 to 80) of the Ternary Truth Table
-		///   and count triangle fan from the FBOs
-		idTTT = (GLuint)outputBuffer0[tetId*4 + 3];
-		cnt = (GLuint)outputBuffer1[tetId*4 + 3];
+	auditOrder.resize(nT);
 
-		if( cnt > 6 ) cnt = 6;
-		if( idTTT > 80 ) idTTT = 80;
- 
-		/// If the projection is class 2 (count = 6) the thick vertex (first) must be
-		///   updated to the intersection coordinates computed in the first step
-		if (cnt == 6) {
+	for (GLuint i = 0; i < nT; ++i)
+		auditOrder[i] = sortedTet(i);
 
-			vertexArray[arrayId + 0] = outputBuffer0[tetId*4];
-			vertexArray[arrayId + 1] = outputBuffer0[tetId*4 + 1];
-			vertexArray[arrayId + 2] = 0.0;
-			vertexArray[arrayId + 3] = 0.0; /// w = 0: computed in the first step
+	GLfloat mv[16];
+	glGetFloatv(GL_MODELVIEW_MATRIX, mv);
 
-		} else { /// Else the thick vertex is one of the other vertices
+	GLfloat viewZ[3] = { mv[2], mv[6], mv[10] };
 
-			/// Use the Triangle Fan Order Table to determine which vertex
-			///   must be copied to the thick vertex position
-			for(GLuint j = 0; j < 3; ++j) {
+	return auditor.audit( volume, viewZ, &auditOrder[0], nT );
 
-				vertexArray[arrayId + j] =
-					vertexArray[arrayId + (1+triangle_fan_order_table[idTTT][0])*4 + j];
+}
 
-			}
+/// Dump Depth Keys
+bool ptVol::dumpDepthKeys(const char* fn) const {
+
+	GLuint nT = volume.numTets;
+
+	if (!outputBuffer0) return false;
+
+	FILE *f = fopen(fn, "wb");
+	if (!f) return false;
+
+	bool ok = true;
+
+	for (GLuint i = 0; i < nT && ok; ++i) {
+		GLfloat cZ = halfFloat::unpack( outputBuffer0[i*4 + 2] );
+		ok = ( fwrite(&cZ, sizeof(GLfloat), 1, f) == 1 );
+	}
+
+	fclose(f);
+
+	return ok;
+
+}
+
+/// Setup and Reorder Arrays
+void ptVol::setupAndReorderArrays() {
+
+	long k, i, nA = (culled) ? numDrawn : volume.numTets, reclassified = 0;
+	const GLuint *active = culler.activeTets();
+
+	/// The incremental CPU first step lists the reclassified tetrahedra
+	bool listed = incrementalSetup && cpuFirstStep;
+
+	if (listed) {
+
+		const unsigned *changed = cpuFirst.reclassified();
+
+		reclassified = cpuFirst.numReclassified();
+
+#pragma omp parallel for
+		for (k = 0; k < reclassified; ++k)
+			buildFan( changed[k] );
+
+	}
+
+	/// Fan, thick vertex and thick vertex color of each (active) tetrahedron
+#pragma omp parallel for reduction(+:reclassified)
+	for (k = 0; k < nA; ++k) {
 
-			vertexArray[arrayId + 3] = 1.0; /// w = 1: original tetrahedron vertex
+		GLuint t = (culled) ? active[k] : k;
+
+		/// Vertex array index: each tetrahedron have 5 associated
+		///   vertices, each vertex have 4 components
+		GLuint arrayId = t * 5 * 4;
+
+		/// The fan only changes with the projection class
+		if (!listed && (!incrementalSetup || outputBuffer0[t*4 + 3] != fanCode[t])) {
+
+			buildFan(t);
+
+			++reclassified;
+
+		}
+
+		/// If the projection is class 2 (count = 6) the thick vertex (first) must be
+		///   updated to the intersection coordinates computed in the first step
+		if (fanCount[t] == 6) {
+
+			vertexArray[arrayId + 0] = halfFloat::unpack( outputBuffer0[t*4] );
+			vertexArray[arrayId + 1] = halfFloat::unpack( outputBuffer0[t*4 + 1] );
 
 		}
 
 		/// Updates the thick vertex color: ( sf, sb, thickness )
 		for(GLuint j = 0; j < 3; ++j)
-			colorArray[tetId*5*3 + j] = outputBuffer1[tetId*4 + j];
+			colorArray[t*5*3 + j] = halfFloat::unpack( outputBuffer1[t*3 + j] );
+
+	} // k
+
+	/// Drawing order: the fans of the tetrahedra as sorted
+#pragma omp parallel for
+	for (i = 0; i < (long)numDrawn; ++i) {
+
+		/// Tetrahedron drawn at i by the selected sort method
+		GLuint tetId = sortedTet(i);
+
+		ids[i] = (GLvoid*)indices[tetId];
+		count[i] = fanCount[tetId];
 
-		/// First vertex of the triangle fan is always the thick
-		///   vertex of the tetrahedron
-		indices[i][0] = indicesId;
+	} // i
+
+	numReclassified = reclassified;
+
+}
 
-		/// Number of vertices in the triangle fan
-		count[i] = cnt;
+/// Build the triangle fan of a tetrahedron
+void ptVol::buildFan(GLuint t) {
 
-		/// Reorder vertices
-		for (GLuint j = 1; j < cnt; ++j) {
+	/// indices array index: each tetrahedron have 5 associated vertices
+	GLuint indicesId = t * 5;
 
-			indices[i][j] = (indicesId + 1) + triangle_fan_order_table[idTTT][j];
+	/// Vertex and Color array index: each vertex/color have 4 components
+	GLuint arrayId = indicesId * 4;
+
+	/// Retrieve classification id (case 0 to 80) of the Ternary Truth Table
+	///   and count triangle fan, packed in the same FBO channel
+	GLhalfARB packed = outputBuffer0[t*4 + 3];
+	GLuint code = (GLuint)halfFloat::unpack( packed );
+	GLuint idTTT = code & 127, cnt = code >> 7;
+
+	if( cnt > 6 ) cnt = 6;
+	if( idTTT > 80 ) idTTT = 80;
+
+	if (cnt == 6) {
+
+		vertexArray[arrayId + 2] = 0.0;
+		vertexArray[arrayId + 3] = 0.0; /// w = 0: computed in the first step
+
+	} else { /// Else the thick vertex is one of the other vertices
+
+		/// Use the Triangle Fan Order Table to determine which vertex
+		///   must be copied to the thick vertex position
+		for(GLuint j = 0; j < 3; ++j) {
+
+			vertexArray[arrayId + j] =
+				vertexArray[arrayId + (1+triangle_fan_order_table[idTTT][0])*4 + j];
 
 		}
 
-	} // i
+		vertexArray[arrayId + 3] = 1.0; /// w = 1: original tetrahedron vertex
+
+	}
+
+	/// First vertex of the triangle fan is always the thick
+	///   vertex of the tetrahedron
+	indices[t][0] = indicesId;
+
+	/// Reorder vertices
+	for (GLuint j = 1; j < cnt; ++j) {
+
+		indices[t][j] = (indicesId + 1) + triangle_fan_order_table[idTTT][j];
+
+	}
+
+	/// Number of vertices in the triangle fan
+	fanCount[t] = cnt;
+
+	fanCode[t] = packed;
 
 }
 
@@ -649,7 +1212,7 @@ void ptVol::secondStep() {
 	secondStepShader->use();
 
 	glMultiDrawElements(GL_TRIANGLE_FAN, count, GL_UNSIGNED_INT,
-			    (const GLvoid**)ids, volume.numTets);
+			    (const GLvoid**)ids, numDrawn);
 
 	secondStepShader->use(0);
 
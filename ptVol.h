@@ -28,12 +28,31 @@
 
 #include "appVol.h"
 
+#include "depthSort.h"
+
+#include "mpvoSort.h"
+
+#include "clusterSort.h"
+
+#include "centroidKeys.h"
+
+#include "sortAudit.h"
+
+#include "ptCPU.h"
+
+#include "frustumCull.h"
+
+#define READBACK_RING_MAX 3 ///< Most first step readbacks in flight
+
 /// Pre-defined colors
 #define WHITE 1.0f, 1.0f, 1.0f
 #define BLACK 0.0f, 0.0f, 0.0f
 #define BLUE  0.0f, 0.0f, 1.0f
 
-enum sortType { none, centroid, bucket }; ///< Three types of sort methods
+enum sortType { none, centroid, bucket, radix, mpvonc, incremental, cached, cluster, quantized }; ///< Types of sort methods
+
+/// Sort method names (indexed by sortType)
+static const char* const sortTypeName[] = { "none", "centroid", "bucket", "radix", "mpvonc", "incremental", "cached", "cluster", "quantized" };
 
 typedef struct _tetCentroid {
 	GLuint id; ///< Tetrahedron index
@@ -75,14 +94,68 @@ public:
 		winHeight = _winH;
 	}
 	void setSortMethod(sortType _sT) {
+		if (_sT != sortMethod) cachedDir = -1;
 		sortMethod = _sT;
 	}
+	void setCpuDepthKeys(bool _c) { cpuDepthKeys = _c; }
+	void setCpuFirstStep(bool _c) {
+		cpuFirstStep = _c;
+		cpuFirst.setIncremental(cpuFirstStep && incrementalSetup);
+	}
+	void setIncrementalSetup(bool _i) {
+		incrementalSetup = _i;
+		cpuFirst.setIncremental(cpuFirstStep && incrementalSetup);
+	}
+	void setCullVolume(bool _c) {
+		cullVolume = _c;
+		if (!_c) { culled = false; numDrawn = volume.numTets; }
+	}
+	void setReadbackRing(GLuint _n);
+
+	/// Get functions
+	sortType getSortMethod(void) const { return sortMethod; }
+	bool getCpuDepthKeys(void) const { return cpuDepthKeys; }
+	bool getCpuFirstStep(void) const { return cpuFirstStep; }
+	bool getIncrementalSetup(void) const { return incrementalSetup; }
+	GLuint getReclassified(void) const { return numReclassified; }
+	bool getCullVolume(void) const { return cullVolume; }
+	GLuint getDrawnTets(void) const { return numDrawn; }
+	GLuint getReadbackRing(void) const { return readbackRing; }
+	GLdouble getReadbackStall(void) const { return readbackStall; }
+	GLuint getReadbackLag(void) const { return readbackFrame - readbackNext; } ///< Frames the output buffers lag behind
+	const GLhalfARB* getOutputBuffer0(void) const { return outputBuffer0; }
+	const GLhalfARB* getOutputBuffer1(void) const { return outputBuffer1; }
+	bool isDrawn(GLuint t) const { return !culled || culler.isActive(t); }
+	GLuint getCycleTets(void) const { return visSorter.cycleTets(); }
+	unsigned long getSortSwaps(void) const { return radixSorter.swaps(); }
+	bool getSortFull(void) const { return radixSorter.fullSort(); }
+	GLuint getSortBuckets(void) const { return radixSorter.buckets(); }
+	GLuint getSortRefined(void) const { return radixSorter.refined(); }
+	GLuint getSortClusters(void) const { return clusterSorter.clusters(); }
+	GLuint getSortResorted(void) const { return clusterSorter.resorted(); }
+	unsigned long getAuditFaces(void) const { return auditor.faces(); }
+	unsigned long getAuditViolations(void) const { return auditor.violations(); }
 
 	/// OpenGL Setup
 	/// Compute texture sizes, create buffers, arrays and textures
 	/// @return true if it succeed
 	bool glSetup(void);
 
+	/// Cull
+	///   Find the active tetrahedra for the current view: the clusters
+	///   whose bounding box is inside the view volume (with cullVolume,
+	///   else all).  The next stages, from the first step to the
+	///   second step, run only over them
+	/// @arg totalTime returns total time spent in culling
+	void cull(GLdouble& totalTime) {
+		static struct timeval starttime, endtime;
+		gettimeofday(&starttime, 0);
+		cull();
+		gettimeofday(&endtime, 0);
+		totalTime = (endtime.tv_sec - starttime.tv_sec) + (endtime.tv_usec - starttime.tv_usec)/1000000.0;
+	}
+	void cull(void);
+
 	/// Run First Step
 	///   The first step shader computes each tetrahedron
 	///    projection and classify it
@@ -97,6 +170,54 @@ public:
 	}
 	void firstStep(void);
 
+	/// Draw First Step
+	///   Issue the first step shader without reading it back, so the
+	///   sort can run with CPU depth keys while the GPU works (with
+	///   cpuFirstStep the whole first step runs here, in CPU)
+	/// @arg totalTime returns total time spent issuing the first step
+	void firstStepDraw(GLdouble& totalTime) {
+		static struct timeval starttime, endtime;
+		gettimeofday(&starttime, 0);
+		firstStepDraw();
+		gettimeofday(&endtime, 0);
+		totalTime = (endtime.tv_sec - starttime.tv_sec) + (endtime.tv_usec - starttime.tv_usec)/1000000.0;
+	}
+	void firstStepDraw(void);
+
+	/// Read First Step
+	///   Read back the first step output FBOs (waits for the GPU;
+	///   nothing to read with cpuFirstStep).  With a readback ring
+	///   the FBOs are copied to a pixel buffer object (PBO) of the
+	///   ring and the output buffers get the oldest frame in flight,
+	///   readbackRing - 1 frames behind (see restartReadback)
+	/// @arg totalTime returns total time spent reading the FBOs
+	void firstStepRead(GLdouble& totalTime) {
+		static struct timeval starttime, endtime;
+		gettimeofday(&starttime, 0);
+		firstStepRead();
+		gettimeofday(&endtime, 0);
+		totalTime = (endtime.tv_sec - starttime.tv_sec) + (endtime.tv_usec - starttime.tv_usec)/1000000.0;
+	}
+	void firstStepRead(void);
+
+	/// Run First Step in CPU
+	///   Same output buffers as the first step shader, computed by
+	///   ptCPU from the current modelview and projection matrices
+	/// @arg totalTime returns total time spent in the CPU first step
+	void firstStepCPU(GLdouble& totalTime) {
+		static struct timeval starttime, endtime;
+		gettimeofday(&starttime, 0);
+		firstStepCPU();
+		gettimeofday(&endtime, 0);
+		totalTime = (endtime.tv_sec - starttime.tv_sec) + (endtime.tv_usec - starttime.tv_usec)/1000000.0;
+	}
+	void firstStepCPU(void);
+
+	/// Restart Readback
+	///   Drop the frames in flight, so the next read waits for its
+	///   own frame (still frames must not lag behind the view)
+	void restartReadback(void);
+
 	/// Sort
 	///   Sort the tetrahedra using the selected sort method
 	/// @arg totalTime returns total time spent in sorting
@@ -113,10 +234,25 @@ public:
 	}
 	void sort(void);
 
+	/// Dump Depth Keys
+	///   Write the centroid Z of each tetrahedron, as computed by the
+	///   last first step (outputBuffer0, in half float), to a raw
+	///   float file
+	/// @arg fn file name
+	/// @return true if it succeed
+	bool dumpDepthKeys(const char* fn) const;
+
 	/// Setup and Reorder Arrays
 	///   Between the first and second step, the vertex, color,
 	///   indices and count arrays must be reorganized acoording to
-	///   the first step output buffers
+	///   the first step output buffers (decoding the packed halves).
+	///   With incrementalSetup the triangle fan of a tetrahedron is
+	///   rebuilt only when its projection class (idTTT and count)
+	///   changed since the last setup; the thick vertex geometry and
+	///   colors are updated for all.  With cpuFirstStep the CPU first
+	///   step detects the class changes and lists the reclassified
+	///   tetrahedra; with the shader the packed classes are compared
+	///   with the ones of the fans (fanCode)
 	/// @arg totalTime returns total time spent in the setup step
 	void setupAndReorderArrays(GLdouble& totalTime) {
 		static struct timeval starttime, endtime;
@@ -127,6 +263,19 @@ public:
 	}
 	void setupAndReorderArrays(void);
 
+	/// Audit Sort
+	///   Count the interior faces whose tetrahedra are in the wrong
+	///   order for the current view (sort quality instrumentation)
+	/// @arg totalTime returns total time spent in the audit
+	void audit(GLdouble& totalTime) {
+		static struct timeval starttime, endtime;
+		gettimeofday(&starttime, 0);
+		audit();
+		gettimeofday(&endtime, 0);
+		totalTime = (endtime.tv_sec - starttime.tv_sec) + (endtime.tv_usec - starttime.tv_usec)/1000000.0;
+	}
+	bool audit(void);
+
 	/// Run Second Step
 	///   Draw Arrays using one OpenGL function: glMultiDrawElement
 	///   to draw all vertices stored into vertexArray and colorArray
@@ -153,18 +302,31 @@ private:
 	/// vertexArray: store vertices [_tet0_(vThick, v0, v1, v2, v3) ; ...]
 	/// colorArray: store colors [_tet0_(cThick, c0, c1, c2, c3) ; ...]
 	///   where vi = (x, y, z, 1|0) and ci  = (r, g, b)
-	/// indices, ids, count: data structure for glMultiDrawElements
+	/// indices, fanCount, fanCode: triangle fan of each tetrahedron,
+	///   its count and its packed class (idTTT | count << 7)
+	/// ids, count: data structure for glMultiDrawElements (the fans
+	///   in drawing order)
 	/// @return true if it succeed
 	bool createArrays(void);
 
+	/// Build the triangle fan of a tetrahedron (indices, fanCount,
+	///   fanCode and thick vertex) from its packed class in outputBuffer0
+	/// @arg t tetrahedron id
+	void buildFan(GLuint t);
+
 	/// Create Buffers
-	/// outputBuffer0,1: gives output from the 1st fragment shader
+	/// outputBuffer0,1: gives output from the 1st fragment shader, in half floats:
+	///   outputBuffer0: { Intersection(x, y), centroidZ, idTTT | count << 7 }
+	///   outputBuffer1: { scalar front, scalar back, thickness }
+	/// cpuFirst: vertices and tetrahedra of the CPU first step
+	/// culler: cluster bounding boxes
 	/// @return true if it succeed
 	bool createBuffers(void);
 
 	/// Create Centroid Sorts
 	/// centroidSorted: {  (tetId, centroidZ), ... }
-	/// centroidBucket: {  _bucket0_(tetId_0, tetId_1, ...), ... }
+	/// depthKeys, sortedIds: { centroidZ, ... }, { tetId, ... }
+	/// cpuKeys: { centroid (x, y, z), ... }
 	/// @return true if it succeed
 	bool createCentroidSorts(void);
 
@@ -184,23 +346,83 @@ private:
 	/// @return true if it succeed
 	bool createShaders(void);
 
+	/// Create Readback Buffers
+	/// readbackPBO: two PBOs (outputBuffer0,1) per frame of the ring
+	/// @return true if it succeed
+	bool createReadbackBuffers(void);
+
+	/// Read First Step through the PBO ring
+	///   The frame read (or kept) must have drawn the rows of all the
+	///   tetrahedra active now, else the ring restarts and this frame
+	///   is read at once (the active set grew while culling)
+	void readRing(void);
+
+	/// Drawn Clusters
+	/// @arg d returns the clusters whose rows the first step drew
+	///   this frame (all if not culled)
+	void drawnClusters(std::vector< GLubyte >& d) const;
+
+	/// Cover Active
+	/// @arg d clusters drawn by a frame (see drawnClusters)
+	/// @return true if all active tetrahedra of the last cull are in d
+	bool coverActive(const std::vector< GLubyte >& d) const;
+
 	/// Draw Quad
 	/// Draw a quadrilateral matching the size of the
 	///   tetrahedral texture to run first step GPGPU shader
+	///   (when culled, the rows of texels of the active ranges)
 	void drawQuad(void);
 
+	/// Draw Rect
+	/// Draw the quadrilateral of a rectangle of the tetrahedral texture
+	/// @arg x0, y0, x1, y1 rectangle [ x0, x1 ) x [ y0, y1 ) in texels
+	void drawRect(GLuint x0, GLuint y0, GLuint x1, GLuint y1);
+
+	/// Sort Active
+	///   Sort only the active tetrahedra of the last cull (sort methods
+	///   using only the depth keys) into culledIds
+	void sortActive(void);
+
+	/// Load Depth Keys
+	/// Fill depthKeys with the centroid eye Z of each tetrahedron, from
+	///   the CPU centroids and the current modelview (cpuDepthKeys) or
+	///   from the first step output (outputBuffer0)
+	void loadDepthKeys(void);
+
+	/// Sorted Tetrahedron
+	/// @arg i drawing position
+	/// @return id of the tetrahedron drawn at i by the last sort
+	GLuint sortedTet(GLuint i) const {
+		if (culled) return culledIds[i];
+		if (sortMethod == centroid) return centroidSorted[i].id;
+		if (sortMethod == none) return i;
+		return sortedIds[i];
+	}
+
 	/// PT Volume Properties
 	glslKernel *firstStepShader, *secondStepShader;
 
 	GLfloat *vertexArray, *colorArray;
 	GLuint **indices;
-	GLint *count;
+	GLint *count, *fanCount;
+	GLhalfARB *fanCode; ///< Packed class of each fan, as outputBuffer0 (0xffff none)
 	GLvoid **ids;
 
 	tetCentroid *centroidSorted; ///< Stable sorting
-	vector< GLuint >* centroidBucket; ///< Bucket sorting
-
-	GLfloat *outputBuffer0, *outputBuffer1; ///< Output Buffers
+	GLfloat *depthKeys; ///< Depth sorting keys
+	GLuint *sortedIds; ///< Bucket, radix, quantized, visibility, incremental or cluster sorted ids
+	depthSort radixSorter; ///< Radix, bucket, quantized and incremental sorter
+	mpvoSort< GLfloat, GLuint > visSorter; ///< Connectivity visibility sorter
+	clusterSort clusterSorter; ///< Two-level cluster sorter
+	centroidKeys cpuKeys; ///< Centroids for the CPU depth keys
+	sortAudit< GLfloat, GLuint > auditor; ///< Sort quality auditor
+	std::vector< GLuint > auditOrder; ///< Drawing order given to the auditor
+	ptCPU cpuFirst; ///< CPU first step
+	frustumCull culler; ///< Cluster frustum culler
+	std::vector< GLuint > culledIds; ///< Active tetrahedra in drawing order (when culled)
+	std::vector< GLfloat > activeKeys; ///< Depth keys of the active tetrahedra
+
+	GLhalfARB *outputBuffer0, *outputBuffer1; ///< Output Buffers (4 and 3 halves per tetrahedron)
 
 	GLuint frameBuffer, tetOutputTex0, tetOutputTex1; ///< FBO
 	GLuint vertListTex, tetListTex, orderTableTex; ///< Frag 1
@@ -208,12 +430,36 @@ private:
 
 	GLuint vertTexSize, tetTexSize; ///< Texture sizes
 
+	GLuint readbackPBO[READBACK_RING_MAX][2]; ///< Ring of PBO pairs (0 if not created)
+	GLsync readbackFence[READBACK_RING_MAX]; ///< Fence of each frame in flight
+	GLuint readbackRing; ///< Frames in the ring (0 is synchronous readback)
+	GLuint readbackFrame, readbackNext; ///< Frames issued and next frame to read since the restart
+	std::vector< GLubyte > readbackDrawn[READBACK_RING_MAX]; ///< Clusters drawn by each frame in flight
+	std::vector< GLubyte > loadedDrawn; ///< Clusters drawn by the frame in the output buffers
+	GLdouble readbackStall; ///< Time the last read waited for the GPU (and copied)
+
 	vec3 backGround; ///< Background color
 	GLdouble minOrthoSize, maxOrthoSize; /// Minimum and maximum ortho size
 	GLsizei winWidth, winHeight; ///< Width x Height pixel resolution
 
 	sortType sortMethod; ///< Selected sort method
 
+	int cachedDir; ///< View order direction of the last cached sort (-1 none)
+
+	bool cpuDepthKeys; ///< Sort on CPU depth keys instead of the first step ones
+
+	bool cpuFirstStep; ///< Run the first step in CPU instead of the shader
+
+	bool incrementalSetup; ///< Rebuild only the fans of reclassified tetrahedra
+
+	GLuint numReclassified; ///< Fans rebuilt by the last setup
+
+	bool cullVolume; ///< Cull the clusters outside the view volume
+
+	bool culled; ///< The last cull left only the active tetrahedra
+
+	GLuint numDrawn; ///< Tetrahedra of the last cull (all if not culled)
+
 };
 
 #endif
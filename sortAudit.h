@@ -0,0 +1,120 @@
+/**
+ *   Sort Audit
+ *
+ */
+
+/**
+ *   sortAudit : defines a class to measure the visibility errors of
+ *               a tetrahedra order from the face connectivity
+ *
+ * C++ header (with implementation).
+ *
+ */
+
+/// --------------------------------   Definitions   ------------------------------------
+
+#ifndef _SORTAUDIT_H_
+#define _SORTAUDIT_H_
+
+#include <algorithm>
+#include <vector>
+
+#include "offVol.h"
+
+#include "mpvoSort.h"
+
+/// ---------------------------------   sortAudit   ------------------------------------
+
+/// Sort Audit Class
+///   Each interior face shared by tetrahedra t and n orders them for
+///   the view (mpvoSort::faceSide): the one behind must be drawn first.
+///   A violation is an interior face whose two tetrahedra are drawn
+///   in the wrong order.  Faces parallel to the view direction, or
+///   with a tetrahedron not drawn (culled), do not constrain the order
+///   and are not counted
+template< class real, class natural >
+class sortAudit {
+
+public:
+
+	typedef offVol< real, natural > volType;
+
+	/// Constructor
+	sortAudit() : numFaces(0), numViolations(0) { }
+
+	/// Size of the audit buffers
+	/// @return size in Bytes
+	size_t sizeOf(void) const { return rank.size() * sizeof(natural); }
+
+	/// Audit an order
+	/// @arg vol volume with vertices, tetrahedra and connectivity
+	/// @arg viewZ eye +z axis (towards the viewer) in object coordinates
+	/// @arg order tetrahedra ids in drawing order (back-to-front)
+	/// @arg numDrawn number of tetrahedra drawn (0 all)
+	/// @return true if it succeed
+	bool audit(const volType& vol, const real* viewZ, const natural* order, natural numDrawn = 0) {
+
+		natural nT = vol.numTets, none = (natural)-1;
+
+		numFaces = numViolations = 0;
+
+		if (!vol.conTet || nT == 0) return false;
+
+		if (numDrawn == 0 || numDrawn > nT) numDrawn = nT;
+
+		rank.resize(nT);
+
+		long i, faces = 0, violations = 0;
+
+		if (numDrawn < nT) std::fill(rank.begin(), rank.end(), none);
+
+#pragma omp parallel for
+		for (i = 0; i < (long)numDrawn; ++i)
+			rank[ order[i] ] = i;
+
+		/// Each interior face once, from its lower id tetrahedron
+#pragma omp parallel for reduction(+:faces,violations)
+		for (i = 0; i < (long)nT; ++i) {
+
+			for (natural f = 0; f < 4; ++f) {
+
+				natural n = vol.conTet[i][f];
+
+				if (n <= (natural)i || rank[i] == none || rank[n] == none) continue;
+
+				int side = mpvoSort< real, natural >::faceSide(vol, i, f, viewZ);
+
+				if (side == 0) continue;
+
+				++faces;
+
+				/// Neighbor in front must come after, behind before
+				if ( (side > 0) != (rank[n] > rank[i]) ) ++violations;
+
+			}
+
+		}
+
+		numFaces = faces;
+		numViolations = violations;
+
+		return true;
+
+	}
+
+	/// Interior faces constraining the order in the last audit
+	unsigned long faces(void) const { return numFaces; }
+
+	/// Faces drawn in the wrong order in the last audit
+	unsigned long violations(void) const { return numViolations; }
+
+private:
+
+	unsigned long numFaces; ///< Constraining faces (last audit)
+	unsigned long numViolations; ///< Violated faces (last audit)
+
+	std::vector< natural > rank; ///< Drawing position of each tetrahedron
+
+};
+
+#endif
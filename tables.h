@@ -26,6 +26,8 @@
  *
  */
 
+#ifndef _TABLES_H_
+#define _TABLES_H_
 
 //--------- ORDER TABLE ----------------
 // Do not use this for triangle fan
@@ -205,3 +207,5 @@ const GLint triangle_fan_order_table[81][6] =
 ,{  2,  3,  0,  1,  9,  9 } // 2 2 2 1 - 79 - 17
 ,{ -1,  0,  1,  2,  3,  0 } // 2 2 2 2 - 80 - 11
 };
+
+#endif
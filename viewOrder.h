@@ -0,0 +1,356 @@
+/**
+ *   View Order
+ *
+ */
+
+/**
+ *   viewOrder : defines a class to precompute, store and fetch the
+ *               centroid visibility order of the tetrahedra for a set
+ *               of view directions (geodesic sphere)
+ *
+ * C++ header (with implementation).
+ *
+ */
+
+/// --------------------------------   Definitions   ------------------------------------
+
+#ifndef _VIEWORDER_H_
+#define _VIEWORDER_H_
+
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+
+#include <map>
+#include <string>
+#include <vector>
+#include <fstream>
+
+#include "offVol.h"
+
+#include "depthSort.h"
+
+#define VOC_MAGIC "PTVO" ///< View order cache magic
+#define VOC_VERSION 1 ///< View order cache version
+#define VOC_BUDGET (64 << 20) ///< Default memory budget in Bytes
+#define VOC_MAX_LEVEL 3 ///< Geodesic levels: 12, 42, 162 and 642 directions
+#define VOC_REPAIR_WINDOW 64 ///< Displacement repaired after fetching an order
+
+/// View order cache file header
+typedef struct _vocHeader {
+	char magic[4]; ///< VOC_MAGIC
+	unsigned int version; ///< VOC_VERSION
+	unsigned int numTets; ///< Number of tetrahedra
+	unsigned int numDirs; ///< Number of stored directions
+	unsigned long long meshHash; ///< Hash of the mesh (offVol::hashMesh)
+} vocHeader;
+
+/// ---------------------------------   viewOrder   ------------------------------------
+
+/// View Order Class
+///   For each direction d of a geodesic sphere the tetrahedra are
+///   sorted by centroid depth along d (d as the eye +z axis) and the
+///   rank of each tetrahedron is stored in 16 bits relative to the
+///   number of tetrahedra ( rank * 2^16 / numTets ), so the memory is
+///   2 Bytes per tetrahedron and direction.  Only one direction of each
+///   antipodal pair is stored, the order of -d being the reverse of the
+///   order of d.  The geodesic level is the largest one fitting the
+///   memory budget.
+template< class real, class natural >
+class viewOrder {
+
+public:
+
+	typedef offVol< real, natural > volType;
+
+	/// Constructor
+	viewOrder() : numTets(0), numDirs(0) { }
+
+	/// Size of the view orders
+	/// @return size in Bytes
+	size_t sizeOf(void) const { return dirs.size() * sizeof(float) + ranks.size() * sizeof(unsigned short); }
+
+	/// Number of covered directions, stored and antipodal (0 if empty)
+	unsigned directions(void) const { return 2 * numDirs; }
+
+	/// Build the view orders
+	/// @arg vol volume
+	/// @arg budget maximum memory in Bytes
+	/// @return true if it succeed (false if not even 12 directions fit)
+	bool build(const volType& vol, size_t budget = VOC_BUDGET) {
+
+		clear();
+
+		if (vol.numTets == 0) return false;
+
+		int level = -1;
+
+		for (int l = 0; l <= VOC_MAX_LEVEL; ++l)
+			if ( (unsigned long long)geodesicSize(l) / 2 * vol.numTets * sizeof(unsigned short) <= budget )
+				level = l;
+
+		if (level < 0) return false;
+
+		/// Keep the directions on the positive side (z, then y, then x)
+		vector< float > all;
+
+		geodesic(level, all);
+
+		for (size_t d = 0; d < all.size(); d += 3) {
+			const float eps = 1e-5;
+			float x = all[d], y = all[d+1], z = all[d+2];
+			if ( z > eps || ( fabs(z) <= eps && ( y > eps || ( fabs(y) <= eps && x > 0 ) ) ) )
+				dirs.insert(dirs.end(), &all[d], &all[d] + 3);
+		}
+
+		numTets = vol.numTets;
+		numDirs = dirs.size() / 3;
+
+		ranks.resize( (size_t)numDirs * numTets );
+
+		vector< float > keys( numTets );
+		vector< unsigned > ids( numTets );
+		depthSort sorter;
+
+		for (unsigned d = 0; d < numDirs; ++d) {
+
+			const float *dir = &dirs[d * 3];
+			long i;
+
+#pragma omp parallel for
+			for (i = 0; i < (long)numTets; ++i) {
+				float z = 0.0;
+				for (unsigned k = 0; k < 4; ++k) {
+					const real *v = &vol.vertList[ vol.tetList[i][k] ][0];
+					z += dir[0] * v[0] + dir[1] * v[1] + dir[2] * v[2];
+				}
+				keys[i] = z;
+			}
+
+			if ( !sorter.sort(&keys[0], &ids[0], numTets) ) { clear(); return false; }
+
+			unsigned short *r = &ranks[ (size_t)d * numTets ];
+
+#pragma omp parallel for
+			for (i = 0; i < (long)numTets; ++i)
+				r[ ids[i] ] = (unsigned short)( ( (unsigned long long)i << 16 ) / numTets );
+
+		}
+
+		return true;
+
+	}
+
+	/// Nearest cached direction
+	/// @arg viewZ eye +z axis in object coordinates
+	/// @return direction code: d for the stored direction d, or
+	///         -(d + 1) for its antipodal direction
+	int nearest(const real* viewZ) const {
+
+		int best = 0;
+		float bestDot = -1.0;
+
+		for (unsigned d = 0; d < numDirs; ++d) {
+			float dot = dirs[d*3] * viewZ[0] + dirs[d*3+1] * viewZ[1] + dirs[d*3+2] * viewZ[2];
+			if (fabs(dot) > bestDot) {
+				bestDot = fabs(dot);
+				best = (dot >= 0) ? (int)d : -(int)d - 1;
+			}
+		}
+
+		return best;
+
+	}
+
+	/// Order of a cached direction (counting sort of the 16-bit ranks)
+	/// @arg code direction code (see nearest)
+	/// @arg ids returns the tetrahedra ids back-to-front along it
+	/// @return true if it succeed
+	bool order(int code, natural* ids) const {
+
+		unsigned d = (code >= 0) ? code : -code - 1;
+
+		if (d >= numDirs) return false;
+
+		const unsigned short *r = &ranks[ (size_t)d * numTets ];
+
+		vector< natural > offset( (1 << 16) + 1, 0 );
+
+		for (natural t = 0; t < numTets; ++t)
+			++offset[ r[t] + 1 ];
+
+		for (unsigned k = 0; k < (1 << 16); ++k)
+			offset[k + 1] += offset[k];
+
+		if (code >= 0)
+			for (natural t = 0; t < numTets; ++t)
+				ids[ offset[ r[t] ]++ ] = t;
+		else /// Antipodal: reverse order
+			for (natural t = 0; t < numTets; ++t)
+				ids[ numTets - 1 - offset[ r[t] ]++ ] = t;
+
+		return true;
+
+	}
+
+	/// Read the view orders
+	/// @arg f view order cache file name
+	/// @arg meshHash hash of the current mesh
+	/// @arg nT number of tetrahedra of the current mesh
+	/// @return true if it succeed (false if missing, stale or corrupted)
+	bool read(const char* f, unsigned long long meshHash, natural nT) {
+
+		clear();
+
+		std::ifstream in(f, std::ios::binary);
+		if (in.fail()) return false;
+
+		vocHeader h;
+
+		in.read((char*)&h, sizeof(vocHeader));
+		if (in.fail()) return false;
+
+		if ( strncmp(h.magic, VOC_MAGIC, 4) != 0 || h.version != VOC_VERSION ||
+		     h.meshHash != meshHash || h.numTets != nT || h.numDirs == 0 ||
+		     h.numDirs > geodesicSize(VOC_MAX_LEVEL) / 2 )
+			return false;
+
+		dirs.resize( 3 * h.numDirs );
+		ranks.resize( (size_t)h.numDirs * h.numTets );
+
+		in.read((char*)&dirs[0], dirs.size() * sizeof(float));
+		in.read((char*)&ranks[0], ranks.size() * sizeof(unsigned short));
+
+		if ( in.fail() || (size_t)in.gcount() != ranks.size() * sizeof(unsigned short) ) { clear(); return false; }
+
+		numTets = h.numTets;
+		numDirs = h.numDirs;
+
+		return true;
+
+	}
+
+	/// Write the view orders (to a temporary file renamed at the end)
+	/// @arg f view order cache file name
+	/// @arg meshHash hash of the current mesh
+	/// @return true if it succeed
+	bool write(const char* f, unsigned long long meshHash) const {
+
+		if (numDirs == 0) return false;
+
+		vocHeader h;
+		memset(&h, 0, sizeof(vocHeader));
+
+		memcpy(h.magic, VOC_MAGIC, 4);
+		h.version = VOC_VERSION;
+		h.numTets = numTets;
+		h.numDirs = numDirs;
+		h.meshHash = meshHash;
+
+		std::string tmp = std::string(f) + ".tmp";
+
+		std::ofstream out(tmp.c_str(), std::ios::binary);
+		if (out.fail()) return false;
+
+		out.write((const char*)&h, sizeof(vocHeader));
+		out.write((const char*)&dirs[0], dirs.size() * sizeof(float));
+		out.write((const char*)&ranks[0], ranks.size() * sizeof(unsigned short));
+
+		out.close();
+
+		if (out.fail()) { remove(tmp.c_str()); return false; }
+
+		if (rename(tmp.c_str(), f) != 0) { remove(tmp.c_str()); return false; }
+
+		return true;
+
+	}
+
+	/// Clear the view orders
+	void clear(void) {
+		dirs.clear();
+		ranks.clear();
+		numTets = numDirs = 0;
+	}
+
+	/// Number of directions of a geodesic level ( 10 * 4^level + 2 )
+	static unsigned geodesicSize(int level) { return 10 * (1u << (2 * level)) + 2; }
+
+	/// Geodesic sphere directions (subdivided icosahedron)
+	/// @arg level subdivision level
+	/// @arg d returns the unit directions ( x, y, z, ... )
+	static void geodesic(int level, vector< float >& d) {
+
+		const float p = (1.0 + sqrt(5.0)) / 2.0;
+
+		const float ico[12][3] = { {-1, p, 0}, {1, p, 0}, {-1, -p, 0}, {1, -p, 0},
+					   {0, -1, p}, {0, 1, p}, {0, -1, -p}, {0, 1, -p},
+					   {p, 0, -1}, {p, 0, 1}, {-p, 0, -1}, {-p, 0, 1} };
+
+		const unsigned icoFaces[20][3] = { {0, 11, 5}, {0, 5, 1}, {0, 1, 7}, {0, 7, 10}, {0, 10, 11},
+						   {1, 5, 9}, {5, 11, 4}, {11, 10, 2}, {10, 7, 6}, {7, 1, 8},
+						   {3, 9, 4}, {3, 4, 2}, {3, 2, 6}, {3, 6, 8}, {3, 8, 9},
+						   {4, 9, 5}, {2, 4, 11}, {6, 2, 10}, {8, 6, 7}, {9, 8, 1} };
+
+		d.clear();
+
+		for (unsigned i = 0; i < 12; ++i)
+			pushUnit(d, ico[i][0], ico[i][1], ico[i][2]);
+
+		vector< unsigned > faces( &icoFaces[0][0], &icoFaces[0][0] + 60 );
+
+		for (int l = 0; l < level; ++l) {
+
+			std::map< std::pair< unsigned, unsigned >, unsigned > mid;
+			vector< unsigned > sub;
+
+			for (size_t f = 0; f < faces.size(); f += 3) {
+
+				unsigned m[3];
+
+				for (unsigned e = 0; e < 3; ++e) {
+
+					unsigned a = faces[f + e], b = faces[f + (e + 1) % 3];
+					std::pair< unsigned, unsigned > key( std::min(a, b), std::max(a, b) );
+
+					if (mid.find(key) == mid.end()) {
+						mid[key] = d.size() / 3;
+						pushUnit(d, d[a*3] + d[b*3], d[a*3+1] + d[b*3+1], d[a*3+2] + d[b*3+2]);
+					}
+
+					m[e] = mid[key];
+
+				}
+
+				unsigned v[3] = { faces[f], faces[f + 1], faces[f + 2] };
+				unsigned s[12] = { v[0], m[0], m[2], v[1], m[1], m[0], v[2], m[2], m[1], m[0], m[1], m[2] };
+
+				sub.insert(sub.end(), s, s + 12);
+
+			}
+
+			faces.swap(sub);
+
+		}
+
+	}
+
+private:
+
+	/// Push a normalized direction
+	static void pushUnit(vector< float >& d, float x, float y, float z) {
+		float len = sqrt(x*x + y*y + z*z);
+		d.push_back(x / len);
+		d.push_back(y / len);
+		d.push_back(z / len);
+	}
+
+	natural numTets; ///< Number of tetrahedra
+	unsigned numDirs; ///< Number of directions
+
+	vector< float > dirs; ///< Directions ( x, y, z, ... )
+	vector< unsigned short > ranks; ///< Relative ranks ( numDirs x numTets )
+
+};
+
+#endif